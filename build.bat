@@ -3,6 +3,7 @@ SETLOCAL
 rem --- Iterate over build script arguments ---
 set buildOptionClean=FALSE
 set buildOptionRelease=FALSE
+set buildOptionBench=FALSE
 if "%~1"=="" goto ARGUMENT_LOOP_END
 rem set argNumber=0
 :ARGUMENT_LOOP_START
@@ -13,6 +14,9 @@ if "%~1"=="release" (
 if "%~1"=="clean" (
 	set buildOptionClean=TRUE
 )
+if "%~1"=="bench" (
+	set buildOptionBench=TRUE
+)
 shift
 rem set /A argNumber+=1
 if not "%~1"=="" goto ARGUMENT_LOOP_START
@@ -71,6 +75,10 @@ rem --- Build the executable ---
 cl %project_root%\code\main.cpp /Fe%exe_name% %CommonCompilerFlagsChosen% ^
 	/link %CommonLinkerFlags%
 :SKIP_BUILD
+rem --- Measure the compile-time cost of each generated header layout ---
+if "%buildOptionBench%"=="TRUE" (
+	%exe_name% --bench %project_root%build\bench
+)
 rem pop from build
 popd
 rem pop from %project_root%
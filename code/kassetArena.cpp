@@ -0,0 +1,267 @@
+// Single-arena asset load plans.  Included by `main.cpp`. //
+/* With `--arena`, assets are grouped into arenas (one per bundle if there are
+ * bundles, otherwise one per directory of the asset tree), & every asset is
+ * given a constant offset within its arena from the size recorded while
+ * scanning (or the size of its processed output), so that a game can load a
+ * whole arena with one allocation & a batch of reads at precomputed offsets
+ * without stat'ing anything.  `gen_kgtAssetArena.h` provides the loader.
+ * Each arena stores the data of identical assets (with `--dedup`) once.  The
+ * loader fails if any file's size no longer matches the plan. */
+static const char* GEN_ASSET_ARENA_RUNTIME_FILE_NAME = "gen_kgtAssetArena.h";
+static const uint64_t KASSET_ARENA_ALIGNMENT = 16;
+struct KAssetArena
+{
+	string name;
+	uint64_t size;
+	/** KgtAssetIndex of each asset whose data is read into the arena, in
+	 * offset order */
+	vector<size_t> loads;
+};
+/** @return the directory of `fileName`, or "." for the root directory */
+static string assetDirectoryName(const string& fileName)
+{
+	const size_t slash = fileName.rfind('/');
+	return slash == string::npos ? string(".") : fileName.substr(0, slash);
+}
+/** @param outputPath processed assets are read relative to this */
+static string generateArenaTables(const vector<KAsset>& assets,
+                                  const vector<KAssetBundle>& bundles,
+                                  const KassetOptions& options,
+                                  const fs::path& outputPath)
+{
+	vector<KAssetArena> arenas;
+	vector<size_t> arenaOf(assets.size(), SIZE_MAX);
+	if(!bundles.empty())
+	{
+		for(const KAssetBundle& bundle : bundles)
+			arenas.push_back({bundle.name, 0, {}});
+		for(size_t a = 0; a < assets.size(); a++)
+			if(!assets[a].tombstone)
+				arenaOf[a] = assets[a].bundle;
+	}
+	else
+	{
+		std::unordered_map<string, size_t> arenaOfDirectory;
+		for(size_t a = 0; a < assets.size(); a++)
+		{
+			if(assets[a].tombstone)
+				continue;
+			const string directory = assetDirectoryName(assets[a].fileName);
+			auto itArena = arenaOfDirectory.emplace(directory, arenas.size());
+			if(itArena.second)
+				arenas.push_back({directory, 0, {}});
+			arenaOf[a] = itArena.first->second;
+		}
+	}
+	// identical assets share their data within an arena //
+	vector<std::unordered_map<size_t, uint64_t>> canonicalOffsets(
+		arenas.size());
+	vector<uint64_t> offsets(assets.size(), 0);
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		if(arenaOf[a] == SIZE_MAX)
+			continue;
+		KAssetArena& arena = arenas[arenaOf[a]];
+		if(options.dedup)
+		{
+			auto itCanonical = canonicalOffsets[arenaOf[a]].find(
+				assets[a].canonicalIndex);
+			if(itCanonical != canonicalOffsets[arenaOf[a]].end())
+			{
+				offsets[a] = itCanonical->second;
+				continue;
+			}
+		}
+		offsets[a] = alignUp(arena.size, KASSET_ARENA_ALIGNMENT);
+		arena.size = offsets[a] + assetPackedSize(assets[a]);
+		if(options.dedup)
+			canonicalOffsets[arenaOf[a]].emplace(assets[a].canonicalIndex,
+			                                     offsets[a]);
+		if(assetPackedSize(assets[a]) > 0)
+			arena.loads.push_back(a);
+	}
+	string result;
+	stringstream ss;
+	ss << "#define KGT_ASSET_ARENA_ALIGNMENT " << KASSET_ARENA_ALIGNMENT
+	   << "u\n";
+	result.append(ss.str());
+	result.append("/* Where each asset's data goes within its arena once loaded "
+	              "(see\n"
+	              "\tkgtAssetArenas); identical assets in the same arena share "
+	              "the same data. */\n");
+	result.append("struct KgtAssetArenaEntry\n");
+	result.append("{\n");
+	result.append("\tunsigned long long offset;\n");
+	result.append("\tunsigned long long size;\n");
+	result.append("\t/* KgtAssetArenaIndex, or ~0u if the asset was removed */\n");
+	result.append("\tunsigned arena;\n");
+	result.append("\t/* relative to the output directory, or nullptr if the "
+	              "asset's own file is read */\n");
+	result.append("\tconst char* processedFileName;\n");
+	result.append("};\n");
+	result.append("static constexpr KgtAssetArenaEntry kgtAssetArenaEntries[] "
+	              "= \n");
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		ss.str("");
+		ss << (a == 0 ? "\t{ {" : "\t, {") << offsets[a] << "ULL, "
+		   << (arenaOf[a] == SIZE_MAX ? 0 : assetPackedSize(assets[a]))
+		   << "ULL, ";
+		if(arenaOf[a] == SIZE_MAX)
+			ss << "~0u, ";
+		else
+			ss << arenaOf[a] << ", ";
+		if(arenaOf[a] == SIZE_MAX || assets[a].processedPath.empty())
+			ss << "nullptr}\n";
+		else
+			ss << "\"" << (char*)assets[a].processedPath.lexically_relative(
+			                  outputPath).generic_u8string().c_str()
+			   << "\"}\n";
+		result.append(ss.str());
+	}
+	if(assets.empty())
+		result.append("{{0, 0, ~0u, nullptr}};\n");
+	else
+		result.append("};\n");
+	result.append("enum class KgtAssetArenaIndex : unsigned\n");
+	for(size_t r = 0; r < arenas.size(); r++)
+	{
+		string identifier;
+		appendAssetEnumEntry(identifier,
+		                     arenas[r].name == "." ? "ROOT" : arenas[r].name,
+		                     r, r == 0);
+		result.append(identifier);
+	}
+	result.append(arenas.empty() ? "\t{ ENUM_SIZE\n};\n" : "\t, ENUM_SIZE\n};\n");
+	result.append("static constexpr unsigned KGT_ASSET_ARENA_COUNT = \n");
+	result.append("\tstatic_cast<unsigned>(KgtAssetArenaIndex::ENUM_SIZE);\n");
+	result.append("/* `size` is a multiple of KGT_ASSET_ARENA_ALIGNMENT.  "
+	              "The assets whose data is read\n"
+	              "\tinto the arena are "
+	              "kgtAssetArenaLoads[firstLoad, firstLoad + loadCount), in "
+	              "offset\n"
+	              "\torder. */\n");
+	result.append("struct KgtAssetArena\n");
+	result.append("{\n");
+	result.append("\tconst char* name;\n");
+	result.append("\tunsigned long long size;\n");
+	result.append("\tunsigned firstLoad;\n");
+	result.append("\tunsigned loadCount;\n");
+	result.append("};\n");
+	result.append("static constexpr KgtAssetArena kgtAssetArenas[] = \n");
+	string loads;
+	size_t loadCount = 0;
+	for(size_t r = 0; r < arenas.size(); r++)
+	{
+		ss.str("");
+		ss << (r == 0 ? "\t{ {\"" : "\t, {\"") << arenas[r].name << "\", "
+		   << alignUp(arenas[r].size, KASSET_ARENA_ALIGNMENT) << "ULL, "
+		   << loadCount << ", " << arenas[r].loads.size() << "}\n";
+		result.append(ss.str());
+		for(size_t a : arenas[r].loads)
+		{
+			stringstream ssLoad;
+			ssLoad << (loadCount++ == 0 ? "\t{ " : "\t, ") << a << "\n";
+			loads.append(ssLoad.str());
+		}
+	}
+	if(arenas.empty())
+		result.append("{{\"\", 0, 0, 0}};\n");
+	else
+		result.append("};\n");
+	result.append("static constexpr unsigned kgtAssetArenaLoads[] = \n");
+	result.append(loadCount == 0 ? "{0};\n" : loads + "};\n");
+	return result;
+}
+static const char GEN_ASSET_ARENA_RUNTIME[] = R"KASSET(#pragma once
+/* Loads whole arenas of assets as planned by kasset; see kgtAssetArenas. */
+#include "gen_kgtAssets.h"
+#include <cstdio>
+#include <cstdlib>
+/** @return `kgtAssetArenas[arena].size` bytes aligned to
+ *          KGT_ASSET_ARENA_ALIGNMENT, which must be freed with
+ *          kgtAssetArenaFree, or nullptr */
+static inline void* kgtAssetArenaAllocate(KgtAssetArenaIndex arena)
+{
+	unsigned long long size = kgtAssetArenas[static_cast<unsigned>(arena)].size;
+	if(size == 0)
+		size = KGT_ASSET_ARENA_ALIGNMENT;
+#if _MSC_VER
+	return _aligned_malloc(static_cast<size_t>(size), KGT_ASSET_ARENA_ALIGNMENT);
+#else
+	return aligned_alloc(KGT_ASSET_ARENA_ALIGNMENT, static_cast<size_t>(size));
+#endif
+}
+static inline void kgtAssetArenaFree(void* memory)
+{
+#if _MSC_VER
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+/** @param arenaMemory the memory `asset`'s arena was read into */
+static constexpr void* kgtAssetArenaData(void* arenaMemory, KgtAssetIndex asset)
+{
+	return static_cast<unsigned char*>(arenaMemory) +
+		kgtAssetArenaEntries[static_cast<unsigned>(asset)].offset;
+}
+/** Read the data of every asset of `arena` into `memory` at its planned
+ * offset.  `memory` must hold `kgtAssetArenas[arena].size` bytes.
+ * @param outputDirectory the directory kasset generated into; only needed if
+ *        the arena holds processed assets
+ * @return false if some asset can't be read, or its size has changed */
+static inline bool kgtAssetArenaRead(KgtAssetArenaIndex arena, void* memory,
+                                     const char* assetDirectory,
+                                     const char* outputDirectory)
+{
+	const KgtAssetArena& plan = kgtAssetArenas[static_cast<unsigned>(arena)];
+	unsigned char*const bytes = static_cast<unsigned char*>(memory);
+	char path[4096];
+	for(unsigned l = plan.firstLoad; l < plan.firstLoad + plan.loadCount; l++)
+	{
+		const unsigned asset = kgtAssetArenaLoads[l];
+		const KgtAssetArenaEntry& entry = kgtAssetArenaEntries[asset];
+		const int pathSize = entry.processedFileName
+			? snprintf(path, sizeof(path), "%s/%s", outputDirectory,
+			           entry.processedFileName)
+			: snprintf(path, sizeof(path), "%s/%s", assetDirectory,
+			           kgtAssetFileName(static_cast<KgtAssetIndex>(asset)));
+		if(pathSize < 0 || pathSize >= static_cast<int>(sizeof(path)))
+			return false;
+		FILE* file = nullptr;
+#if _MSC_VER
+		if(fopen_s(&file, path, "rb") != 0)
+			file = nullptr;
+#else
+		file = fopen(path, "rb");
+#endif
+		if(!file)
+			return false;
+		const size_t size = static_cast<size_t>(entry.size);
+		const bool success =
+			fread(bytes + entry.offset, 1, size, file) == size &&
+			fgetc(file) == EOF;
+		fclose(file);
+		if(!success)
+			return false;
+	}
+	return true;
+}
+/** Allocate `arena` & read all of its assets into it.
+ * @return the arena's memory, which must be freed with kgtAssetArenaFree, or
+ *         nullptr on failure */
+static inline void* kgtAssetArenaLoad(KgtAssetArenaIndex arena,
+                                      const char* assetDirectory,
+                                      const char* outputDirectory)
+{
+	void*const memory = kgtAssetArenaAllocate(arena);
+	if(memory &&
+		!kgtAssetArenaRead(arena, memory, assetDirectory, outputDirectory))
+	{
+		kgtAssetArenaFree(memory);
+		return nullptr;
+	}
+	return memory;
+}
+)KASSET";
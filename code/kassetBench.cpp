@@ -0,0 +1,401 @@
+// Consumer compile-time benchmark of the header layouts.  Included by
+//	`main.cpp`. //
+/* `kasset --bench output_directory` generates the asset index of synthetic
+ * asset trees at several scales in each layout (see kassetLayout.cpp), then
+ * compiles a set of consumer translation units against every one & reports:
+ *	front-end  seconds spent parsing every TU without generating code
+ *	           (`-fsyntax-only`, or `/Zs` for MSVC), including the layout's
+ *	           own source file or module interface
+ *	objects    total size of the objects of every TU
+ *	link       seconds spent linking the objects into a program
+ * The compiler is `--cxx command`, or `cl` on Windows & `c++` elsewhere.  A
+ * layout which the compiler can't build (usually `module`) is reported as
+ * failed instead of stopping the benchmark; the output of every command is
+ * appended to `bench.log` in the layout's directory.  The results are also
+ * written to `bench.csv` in the output directory. */
+static const size_t KASSET_BENCH_DEFAULT_SCALES[] = {1000, 10000, 50000};
+static const size_t KASSET_BENCH_DEFAULT_CONSUMERS = 8;
+static const char* KASSET_BENCH_LOG_FILE_NAME = "bench.log";
+static const char* KASSET_BENCH_RESULTS_FILE_NAME = "bench.csv";
+struct KAssetBenchCompiler
+{
+	string command;
+	/** uses MSVC style arguments */
+	bool msvc;
+	bool clang;
+};
+struct KAssetBenchResult
+{
+	KAssetHeaderLayout layout;
+	size_t scale;
+	bool success;
+	uintmax_t headerBytes;
+	double frontEndSeconds;
+	uintmax_t objectBytes;
+	double linkSeconds;
+};
+/** Run `compiler.command arguments` from `directory`.
+ * @param o_seconds if not nullptr, receives the time taken by the command */
+static bool benchRun(const fs::path& directory,
+                     const KAssetBenchCompiler& compiler,
+                     const string& arguments, double* o_seconds)
+{
+#if _WIN32
+	string command = "cd /d \"";
+#else
+	string command = "cd \"";
+#endif
+	command.append((char*)directory.u8string().c_str());
+	command.append("\" && ");
+	command.append(compiler.command);
+	command.append(" ");
+	command.append(arguments);
+	command.append(" >> ");
+	command.append(KASSET_BENCH_LOG_FILE_NAME);
+	command.append(" 2>&1");
+	if(g_verbose)
+		printf("%s\n", command.c_str());
+	const auto start = std::chrono::steady_clock::now();
+	const int status = std::system(command.c_str());
+	if(o_seconds)
+		*o_seconds += std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+	return status == 0;
+}
+static KAssetBenchCompiler benchFindCompiler(const fs::path& outputPath,
+                                             const char* command)
+{
+	KAssetBenchCompiler compiler = {};
+#if _WIN32
+	compiler.command = command ? command : "cl";
+#else
+	compiler.command = command ? command : "c++";
+#endif
+	const string name = fs::path(compiler.command).stem().string();
+	compiler.msvc = name == "cl" || name == "clang-cl";
+	if(compiler.msvc)
+		return compiler;
+	// `c++` could be either gcc or clang, whose module flags differ //
+	const fs::path versionPath = outputPath / "compiler-version.txt";
+	const string versionCommand = compiler.command + " --version > \"" +
+		(char*)versionPath.u8string().c_str() + "\" 2>&1";
+	vector<uint8_t> version;
+	std::error_code errorCode;
+	if(std::system(versionCommand.c_str()) == 0 &&
+		readFileContents(versionPath, fs::file_size(versionPath, errorCode),
+		                 version))
+	{
+		compiler.clang =
+			string(version.begin(), version.end()).find("clang") != string::npos;
+	}
+	fs::remove(versionPath, errorCode);
+	return compiler;
+}
+/** @return a deterministic asset tree of `count` assets, which resembles a
+ *          game's in the length & variety of its file names */
+static vector<KAsset> benchSynthesizeAssets(size_t count)
+{
+	static const struct
+	{
+		const char* directory;
+		const char* extension;
+	} CATEGORIES[] =
+		{ {"sprites", ".png"}
+		, {"sounds" , ".wav"}
+		, {"music"  , ".ogg"}
+		, {"anims"  , ".fbm"}
+	};
+	vector<KAsset> assets(count);
+	for(size_t a = 0; a < count; a++)
+	{
+		const auto& category = CATEGORIES[a % std::size(CATEGORIES)];
+		char fileName[64];
+		snprintf(fileName, sizeof(fileName), "level_%02zu/%s/asset_%06zu%s",
+		         a / 1000, category.directory, a, category.extension);
+		assets[a].fileName       = fileName;
+		assets[a].type           = assetTypeFromFileName(assets[a].fileName);
+		assets[a].canonicalIndex = a;
+	}
+	return assets;
+}
+/** Write `consumerCount` TUs which each use the asset index, plus a TU with
+ * `main` which calls all of them. */
+static bool benchWriteConsumers(const fs::path& directory,
+                                const vector<KAsset>& assets,
+                                size_t consumerCount)
+{
+	string mainSource;
+	string mainBody;
+	for(size_t c = 0; c < consumerCount; c++)
+	{
+		// each consumer names a different enumerator, like real code would //
+		string enumerator;
+		appendAssetEnumEntry(enumerator,
+		                     assets[c*assets.size()/consumerCount].fileName, 0,
+		                     true);
+		enumerator = enumerator.substr(3, enumerator.find(" = ") - 3);
+		stringstream ss;
+		ss << "#include \"" << GEN_ASSET_HEADER_FILE_NAME << "\"\n"
+		   << "const char* kgtBenchConsumer" << c << "(unsigned i)\n"
+		   << "{\n"
+		   << "\tif(i >= KGT_ASSET_COUNT)\n"
+		   << "\t\treturn nullptr;\n"
+		   << "\treturn kgtAssetFileName(static_cast<KgtAssetIndex>(i));\n"
+		   << "}\n"
+		   << "unsigned kgtBenchConsumerAsset" << c << "()\n"
+		   << "{\n"
+		   << "\treturn static_cast<unsigned>(KgtAssetIndex::" << enumerator
+		   << ");\n"
+		   << "}\n";
+		const fs::path consumerPath =
+			directory / ("consumer" + std::to_string(c) + ".cpp");
+		if(!writeEntireFile(consumerPath.c_str(), ss.str().c_str(), false))
+			return false;
+		ss.str("");
+		ss << "const char* kgtBenchConsumer" << c << "(unsigned i);\n"
+		   << "unsigned kgtBenchConsumerAsset" << c << "();\n";
+		mainSource.append(ss.str());
+		ss.str("");
+		ss << "\tif(kgtBenchConsumer" << c << "(kgtBenchConsumerAsset" << c
+		   << "()))\n"
+		   << "\t\tfound++;\n";
+		mainBody.append(ss.str());
+	}
+	mainSource.append("int main()\n"
+	                  "{\n"
+	                  "\tunsigned found = 0;\n");
+	mainSource.append(mainBody);
+	mainSource.append("\treturn found == 0;\n"
+	                  "}\n");
+	const fs::path mainPath = directory / "main.cpp";
+	return writeEntireFile(mainPath.c_str(), mainSource.c_str(), false);
+}
+/** Generate the asset index of `assets` in `result.layout`, then compile &
+ * link the consumers of it in `directory`. */
+static void benchLayout(const fs::path& directory,
+                        const KAssetBenchCompiler& compiler,
+                        const vector<KAsset>& assets, size_t consumerCount,
+                        KAssetBenchResult& result)
+{
+	std::error_code errorCode;
+	fs::remove_all(directory, errorCode);
+	if(!fs::create_directories(directory, errorCode))
+	{
+		fprintf(stderr, "Failed to create '%s'!\n",
+		        (char*)directory.u8string().c_str());
+		return;
+	}
+	KassetOptions options = {};
+	options.headerLayout = result.layout;
+	string source;
+	const string header =
+		generateKAssetsHeader(assets, options, {}, {}, {}, {}, {}, {}, source);
+	if(!writeKAssetsHeader(directory, result.layout, header, source) ||
+		!benchWriteConsumers(directory, assets, consumerCount))
+		return;
+	result.headerBytes = header.size() + source.size();
+	const bool module = result.layout == KAssetHeaderLayout::MODULE;
+	const char*const objectExtension = compiler.msvc ? ".obj" : ".o";
+	string flags;
+	if(compiler.msvc)
+	{
+		flags = "/nologo /std:c++latest";
+		if(module)
+			flags.append(" /reference kgtAssets=kgtAssets.ifc");
+	}
+	else
+	{
+		flags = "-std=c++20";
+		if(module && compiler.clang)
+			flags.append(" -fmodule-file=kgtAssets=kgtAssets.pcm");
+		else if(module)
+			flags.append(" -fmodules-ts");
+	}
+	vector<string> units;
+	for(size_t c = 0; c < consumerCount; c++)
+		units.push_back("consumer" + std::to_string(c));
+	/* the front-end of the layout's own file (for a module, building its
+		interface) is only paid once, but it still counts */
+	string sourceFrontEnd;
+	string sourceObject;
+	switch(result.layout)
+	{
+		case KAssetHeaderLayout::SPLIT:
+		{
+			units.push_back("gen_kgtAssets");
+		}break;
+		case KAssetHeaderLayout::MODULE:
+		{
+			if(compiler.msvc)
+			{
+				sourceFrontEnd = "/nologo /std:c++latest /interface /ifcOnly "
+					"gen_kgtAssets.cppm /ifcOutput kgtAssets.ifc";
+				sourceObject = "/nologo /std:c++latest /interface /c "
+					"gen_kgtAssets.cppm /ifcOutput kgtAssets.ifc "
+					"/Fogen_kgtAssets.obj";
+			}
+			else if(compiler.clang)
+			{
+				sourceFrontEnd = "-std=c++20 -x c++-module --precompile "
+					"gen_kgtAssets.cppm -o kgtAssets.pcm";
+				sourceObject = "-std=c++20 -c kgtAssets.pcm -o gen_kgtAssets.o";
+			}
+			else
+			{
+				sourceFrontEnd = "-std=c++20 -fmodules-ts -x c++ -fmodule-only "
+					"-c gen_kgtAssets.cppm";
+				sourceObject = "-std=c++20 -fmodules-ts -x c++ -c "
+					"gen_kgtAssets.cppm -o gen_kgtAssets.o";
+			}
+		}break;
+		default:
+			break;
+	}
+	if(!sourceFrontEnd.empty() &&
+		!benchRun(directory, compiler, sourceFrontEnd, &result.frontEndSeconds))
+		return;
+	for(const string& unit : units)
+		if(!benchRun(directory, compiler,
+		             flags + (compiler.msvc ? " /Zs " : " -fsyntax-only ") +
+		             unit + ".cpp", &result.frontEndSeconds))
+			return;
+	// the objects aren't timed; codegen of the tables isn't a layout cost //
+	if(!sourceObject.empty())
+	{
+		if(!benchRun(directory, compiler, sourceObject, nullptr))
+			return;
+		units.push_back("gen_kgtAssets");
+	}
+	units.push_back("main");
+	string objects;
+	for(const string& unit : units)
+	{
+		const string object = unit + objectExtension;
+		if(unit != "gen_kgtAssets" || sourceObject.empty())
+		{
+			const string arguments = compiler.msvc
+				? flags + " /c " + unit + ".cpp /Fo" + object
+				: flags + " -c " + unit + ".cpp -o " + object;
+			if(!benchRun(directory, compiler, arguments, nullptr))
+				return;
+		}
+		result.objectBytes += fs::file_size(directory / object, errorCode);
+		objects.append(" ");
+		objects.append(object);
+	}
+	if(!benchRun(directory, compiler,
+	             compiler.msvc
+	                 ? "/nologo" + objects + " /Fekgt_bench.exe"
+	                 : objects.substr(1) + " -o kgt_bench",
+	             &result.linkSeconds))
+		return;
+	result.success = true;
+}
+/** `kasset --bench output_directory [--verbose] [--scales count,...]
+ *  [--consumers count] [--cxx command]` */
+static bool runLayoutBench(int argc, char** argv)
+{
+	if(argc < 3)
+	{
+		fprintf(stderr, "Incorrect # of arguments!\n");
+		return false;
+	}
+	const fs::path outputPath(argv[2]);
+	vector<size_t> scales(std::begin(KASSET_BENCH_DEFAULT_SCALES),
+	                      std::end(KASSET_BENCH_DEFAULT_SCALES));
+	size_t consumerCount = KASSET_BENCH_DEFAULT_CONSUMERS;
+	const char* compilerCommand = nullptr;
+	for(int a = 3; a < argc; a++)
+	{
+		if(strcmp(argv[a], "--verbose") == 0)
+		{
+			g_verbose = true;
+		}
+		else if(strcmp(argv[a], "--scales") == 0 && a + 1 < argc)
+		{
+			scales.clear();
+			istringstream iss(argv[++a]);
+			string scale;
+			while(std::getline(iss, scale, ','))
+			{
+				scales.push_back(strtoul(scale.c_str(), nullptr, 10));
+				if(scales.back() == 0)
+				{
+					fprintf(stderr, "ERROR: invalid scale '%s'\n", scale.c_str());
+					return false;
+				}
+			}
+		}
+		else if(strcmp(argv[a], "--consumers") == 0 && a + 1 < argc)
+		{
+			consumerCount = strtoul(argv[++a], nullptr, 10);
+			if(consumerCount == 0)
+			{
+				fprintf(stderr, "ERROR: invalid consumer count '%s'\n", argv[a]);
+				return false;
+			}
+		}
+		else if(strcmp(argv[a], "--cxx") == 0 && a + 1 < argc)
+		{
+			compilerCommand = argv[++a];
+		}
+		else
+		{
+			fprintf(stderr, "ERROR: incorrect usage on param[%i]=='%s'\n",
+			        a, argv[a]);
+			return false;
+		}
+	}
+	std::error_code errorCode;
+	fs::create_directories(outputPath, errorCode);
+	const KAssetBenchCompiler compiler =
+		benchFindCompiler(outputPath, compilerCommand);
+	printf("Benchmarking header layouts with `%s`, %zu consumers...\n",
+	       compiler.command.c_str(), consumerCount);
+	printf("%-10s %8s %12s %12s %12s %8s\n", "layout", "assets", "header KiB",
+	       "front-end s", "objects KiB", "link s");
+	vector<KAssetBenchResult> results;
+	for(size_t scale : scales)
+	{
+		const vector<KAsset> assets = benchSynthesizeAssets(scale);
+		for(size_t l = 0; l < std::size(KASSET_HEADER_LAYOUT_NAMES); l++)
+		{
+			KAssetBenchResult result = {};
+			result.layout = static_cast<KAssetHeaderLayout>(l);
+			result.scale  = scale;
+			const fs::path directory = outputPath /
+				(string(KASSET_HEADER_LAYOUT_NAMES[l]) + "_" +
+				 std::to_string(scale));
+			benchLayout(directory, compiler, assets, consumerCount, result);
+			if(result.success)
+				printf("%-10s %8zu %12.1f %12.3f %12.1f %8.3f\n",
+				       KASSET_HEADER_LAYOUT_NAMES[l], scale,
+				       result.headerBytes / 1024.0, result.frontEndSeconds,
+				       result.objectBytes / 1024.0, result.linkSeconds);
+			else
+				printf("%-10s %8zu %12.1f       failed; see '%s'\n",
+				       KASSET_HEADER_LAYOUT_NAMES[l], scale,
+				       result.headerBytes / 1024.0,
+				       (char*)(directory / KASSET_BENCH_LOG_FILE_NAME)
+				           .u8string().c_str());
+			fflush(stdout);
+			results.push_back(result);
+		}
+	}
+	string csv = "layout,assets,header_bytes,front_end_seconds,object_bytes,"
+	             "link_seconds\n";
+	for(const KAssetBenchResult& result : results)
+	{
+		stringstream ss;
+		ss << KASSET_HEADER_LAYOUT_NAMES[static_cast<size_t>(result.layout)]
+		   << "," << result.scale << "," << result.headerBytes << ",";
+		if(result.success)
+			ss << result.frontEndSeconds << "," << result.objectBytes << ","
+			   << result.linkSeconds << "\n";
+		else
+			ss << ",,\n";
+		csv.append(ss.str());
+	}
+	const fs::path resultsPath = outputPath / KASSET_BENCH_RESULTS_FILE_NAME;
+	return writeEntireFile(resultsPath.c_str(), csv.c_str(), false);
+}
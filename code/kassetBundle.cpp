@@ -0,0 +1,244 @@
+// Asset bundles: named groups of assets which can be streamed in & evicted as
+//	a unit.  Included by `main.cpp`. //
+/* If the asset directory contains `assets.bundles`, each line of it is a rule
+ * `bundle_name: regex`.  Assets are assigned to the bundle of the first rule
+ * whose regex matches their file name, in the same way as `assets.ignore`.
+ * Assets which match no rule end up in an implicit bundle named `unbundled`.
+ * Each bundle occupies a contiguous range of KgtAssetIndex values & gets its
+ * own pack file, so the whole bundle can be loaded with one sequential read.
+ * Empty lines & lines beginning with '#' are ignored. */
+static const wchar_t* ASSET_BUNDLES_FILE_NAME = L"assets.bundles";
+static const char* KASSET_UNBUNDLED_NAME = "unbundled";
+struct KAssetBundleRule
+{
+	size_t bundle;
+	regex pattern;
+};
+struct KAssetBundle
+{
+	string name;
+	/** [firstAsset, endAsset) spans every asset in the bundle, but may also
+	 * contain assets of other bundles if the range is not contiguous */
+	size_t firstAsset;
+	size_t endAsset;
+	size_t assetCount;
+	/** # of bytes of asset data following the header of the bundle's pack */
+	uint64_t packDataSize;
+};
+/** @return false if the bundle rules file is malformed */
+static bool readAssetBundles(const fs::path& bundlesPath,
+                             vector<KAssetBundle>& o_bundles,
+                             vector<KAssetBundleRule>& o_rules)
+{
+	o_bundles.clear();
+	o_rules.clear();
+	const uintmax_t fileSize = fs::file_size(bundlesPath);
+	char*const fileAssetBundles = readEntireFile(bundlesPath.c_str(), fileSize);
+	if(!fileAssetBundles)
+		return false;
+	istringstream iss(fileAssetBundles);
+	free(fileAssetBundles);
+	string line;
+	for(size_t lineNumber = 1; std::getline(iss, line); lineNumber++)
+	{
+		ltrim(line);
+		rtrim(line);
+		if(line.empty() || line[0] == '#')
+			continue;
+		const size_t colon = line.find(':');
+		string name = line.substr(0, std::min(colon, line.size()));
+		rtrim(name);
+		bool nameValid = colon != string::npos && !name.empty() &&
+			!isNumeric(name[0]) && name != KASSET_UNBUNDLED_NAME;
+		for(char c : name)
+			if(!isAlpha(c) && !isNumeric(c))
+				nameValid = false;
+		if(!nameValid)
+		{
+			fprintf(g_stderr, "Malformed line %zu in asset bundles file: '%s'\n"
+			        "\texpected `bundle_name: regex`, where bundle_name is a "
+			        "C identifier\n", lineNumber, line.c_str());
+			return false;
+		}
+		string pattern = line.substr(colon + 1);
+		ltrim(pattern);
+		size_t bundle = 0;
+		while(bundle < o_bundles.size() && o_bundles[bundle].name != name)
+			bundle++;
+		if(bundle == o_bundles.size())
+		{
+			o_bundles.emplace_back();
+			o_bundles.back().name = name;
+		}
+		if(g_verbose)
+			fprintf(g_stdout, "Adding bundle rule '%s' => '%s'...\n",
+			        pattern.c_str(), name.c_str());
+		o_rules.push_back({bundle, regex(pattern)});
+	}
+	return true;
+}
+/** Assign each asset to a bundle, & group the assets of each bundle together
+ * without otherwise changing their order.  May append the `unbundled`
+ * bundle to `bundles`. */
+static void assignAssetBundles(const vector<KAssetBundleRule>& rules,
+                               vector<KAssetBundle>& bundles,
+                               vector<KAsset>& assets)
+{
+	const size_t unbundled = bundles.size();
+	bool anyUnbundled = false;
+	for(KAsset& asset : assets)
+	{
+		asset.bundle = unbundled;
+		for(const KAssetBundleRule& rule : rules)
+			if(std::regex_match(asset.fileName, rule.pattern))
+			{
+				asset.bundle = rule.bundle;
+				break;
+			}
+		if(asset.bundle == unbundled)
+			anyUnbundled = true;
+	}
+	if(anyUnbundled)
+	{
+		bundles.emplace_back();
+		bundles.back().name = KASSET_UNBUNDLED_NAME;
+	}
+	std::stable_sort(assets.begin(), assets.end(),
+		[](const KAsset& lhs, const KAsset& rhs)
+		{
+			return lhs.bundle < rhs.bundle;
+		});
+}
+/** Find the range of KgtAssetIndex values spanned by each bundle.
+ * @return true if every bundle's range is contiguous */
+static bool computeAssetBundleRanges(vector<KAssetBundle>& bundles,
+                                     const vector<KAsset>& assets)
+{
+	for(KAssetBundle& bundle : bundles)
+	{
+		bundle.firstAsset = 0;
+		bundle.endAsset   = 0;
+		bundle.assetCount = 0;
+	}
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		if(assets[a].tombstone)
+			continue;
+		KAssetBundle& bundle = bundles[assets[a].bundle];
+		if(bundle.assetCount++ == 0)
+			bundle.firstAsset = a;
+		bundle.endAsset = a + 1;
+	}
+	for(const KAssetBundle& bundle : bundles)
+		if(bundle.endAsset - bundle.firstAsset != bundle.assetCount)
+			return false;
+	return true;
+}
+static string assetBundlePackFileName(const KAssetBundle& bundle)
+{
+	// "gen_kgtAssets.pack" => "gen_kgtAssets.<bundle>.pack" //
+	string result = GEN_ASSET_PACK_FILE_NAME;
+	result.insert(result.rfind('.'), "." + bundle.name);
+	return result;
+}
+/** Write one pack file per bundle.  Assets which are duplicated across
+ * bundles are stored in each of them, so that every bundle is
+ * self-contained. */
+static bool writeAssetBundlePacks(const fs::path& assetPath,
+                                  const fs::path& outputPath,
+                                  const KassetOptions& options,
+                                  KAssetCache& cache,
+                                  vector<KAssetBundle>& bundles,
+                                  vector<KAsset>& assets,
+                                  vector<KAssetPackChunk>& io_chunks)
+{
+	for(size_t b = 0; b < bundles.size(); b++)
+	{
+		vector<size_t> members;
+		for(size_t a = 0; a < assets.size(); a++)
+			if(!assets[a].tombstone && assets[a].bundle == b)
+				members.push_back(a);
+		orderPackMembers(assets, members);
+		const fs::path packPath =
+			outputPath / assetBundlePackFileName(bundles[b]);
+		if(!writeAssetPackVersion(assetPath, packPath, options, cache, assets,
+		                          members, io_chunks, &bundles[b].packDataSize))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+static string generateBundleTables(const vector<KAssetBundle>& bundles,
+                                   bool pack, const vector<KAsset>& assets)
+{
+	bool contiguous = true;
+	for(const KAssetBundle& bundle : bundles)
+		if(bundle.endAsset - bundle.firstAsset != bundle.assetCount)
+			contiguous = false;
+	string result;
+	result.append("enum class KgtAssetBundleIndex : unsigned\n");
+	for(size_t b = 0; b < bundles.size(); b++)
+	{
+		stringstream ss;
+		ss << (b == 0 ? "\t{ " : "\t, ") << bundles[b].name << " = " << b
+		   << "\n";
+		result.append(ss.str());
+	}
+	result.append(bundles.empty() ? "\t{ ENUM_SIZE\n};\n" : "\t, ENUM_SIZE\n};\n");
+	result.append("static const unsigned KGT_ASSET_BUNDLE_COUNT = \n");
+	result.append("\tstatic_cast<unsigned>(KgtAssetBundleIndex::ENUM_SIZE);\n");
+	result.append("/* 0 if a locked KgtAssetIndex prevents some bundle from "
+	              "occupying a contiguous\n"
+	              "\trange of assets; use `kgtAssetBundleOf` to test membership "
+	              "in that case. */\n");
+	result.append(contiguous ? "#define KGT_ASSET_BUNDLES_CONTIGUOUS 1\n"
+	                         : "#define KGT_ASSET_BUNDLES_CONTIGUOUS 0\n");
+	result.append("struct KgtAssetBundle\n");
+	result.append("{\n");
+	result.append("\tconst char* name;\n");
+	result.append("\t/* nullptr unless assets were packed */\n");
+	result.append("\tconst char* packFileName;\n");
+	result.append("\t/* [firstAsset, endAsset) spans the bundle's assets */\n");
+	result.append("\tunsigned firstAsset;\n");
+	result.append("\tunsigned endAsset;\n");
+	result.append("\tunsigned assetCount;\n");
+	result.append("\t/* asset data which directly follows the pack header; "
+	              "read it all at once\n"
+	              "\t\tto load the entire bundle */\n");
+	result.append("\tunsigned long long packDataSize;\n");
+	result.append("};\n");
+	result.append("static const KgtAssetBundle kgtAssetBundles[] = \n");
+	for(size_t b = 0; b < bundles.size(); b++)
+	{
+		const KAssetBundle& bundle = bundles[b];
+		stringstream ss;
+		ss << (b == 0 ? "\t{ {\"" : "\t, {\"") << bundle.name << "\", ";
+		if(pack)
+			ss << "\"" << assetBundlePackFileName(bundle) << "\", ";
+		else
+			ss << "nullptr, ";
+		ss << bundle.firstAsset << ", " << bundle.endAsset << ", "
+		   << bundle.assetCount << ", " << bundle.packDataSize << "ULL}\n";
+		result.append(ss.str());
+	}
+	if(bundles.empty())
+		result.append("{{\"\", nullptr, 0, 0, 0, 0}};\n");
+	else
+		result.append("};\n");
+	result.append("/* KgtAssetBundleIndex of each asset (KGT_ASSET_BUNDLE_COUNT "
+	              "for tombstones) */\n");
+	result.append("static const unsigned kgtAssetBundleOf[] = \n");
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		stringstream ss;
+		ss << (a == 0 ? "\t{ " : "\t, ")
+		   << (assets[a].tombstone ? bundles.size() : assets[a].bundle) << "\n";
+		result.append(ss.str());
+	}
+	if(assets.empty())
+		result.append("{0};\n");
+	else
+		result.append("};\n");
+	return result;
+}
@@ -0,0 +1,246 @@
+// Content-addressed cache of asset processing outputs.  Included by
+//	`main.cpp`. //
+/* Each output of a processor (see kassetProcess.cpp) is stored in its own
+ * file, named by a hash of the processor's input content, id, version & the
+ * options which affect it, so an input is only ever reprocessed when one of
+ * those changes.  Entry files are touched whenever they are used, & once the
+ * cache grows past its size limit the least recently used entries are
+ * evicted.  Entry file layout (little-endian):
+ *	char magic[4] = "KCHE"
+ *	u32  version
+ *	u32  meta[4]      processor-defined values, such as texture dimensions
+ *	u64  dataSize
+ *	u64  dataHash
+ *	u8   data[dataSize] */
+#if _MSC_VER
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+static const char* GEN_ASSET_CACHE_DIRECTORY = "gen_kgtCache";
+static const char* KASSET_CACHE_EXTENSION = ".kce";
+static const size_t KASSET_CACHE_DEFAULT_MAX_MB = 1024;
+static const char KASSET_CACHE_MAGIC[4] = {'K', 'C', 'H', 'E'};
+static const uint32_t KASSET_CACHE_VERSION = 1;
+static const size_t KASSET_CACHE_HEADER_SIZE = 40;
+/** temporary files older than this are assumed to belong to a run which was
+ * interrupted, rather than to a store which is still in progress */
+static const std::chrono::hours KASSET_CACHE_STALE_TEMP_AGE(1);
+struct KAssetProcessOutput
+{
+	vector<uint8_t> data;
+	/** processor-defined values, such as texture dimensions */
+	uint32_t meta[4];
+};
+struct KAssetProcessor
+{
+	/** part of every cache key; never reuse an id for a different transform */
+	const char* id;
+	/** bump whenever a change to the processor changes its output */
+	uint32_t version;
+	KAssetType type;
+	/** id of the processor whose output this one transforms, or nullptr to
+	 * transform the contents of the asset file */
+	const char* input;
+	bool (*enabled)(const KassetOptions& options);
+	/** @return a hash of every option which affects the output */
+	uint64_t (*optionsHash)(const KassetOptions& options);
+	/** @param io_input may be consumed by the processor
+	 * @return an error message, or nullptr on success */
+	const char* (*process)(KAssetProcessOutput& io_input,
+	                       const KassetOptions& options,
+	                       KAssetProcessOutput& o_output);
+	/** if this processor produces an asset's final output, it is written to
+	 * `<output directory>/<outputDirectory>/<asset><outputExtension>` */
+	const char* outputDirectory;
+	const char* outputExtension;
+	/** record the final output's properties in `asset` */
+	void (*apply)(KAsset& asset, const KAssetProcessOutput& output);
+};
+struct KAssetCache
+{
+	/** empty if caching is disabled */
+	fs::path directory;
+	uint64_t maxBytes;
+	std::atomic<size_t> hits;
+	std::atomic<size_t> misses;
+};
+static uint64_t processorCacheKey(const KAssetProcessor& processor,
+                                  const KassetOptions& options,
+                                  uint64_t inputHash)
+{
+	uint64_t key = hashBytes(&inputHash, sizeof(inputHash), 0);
+	key = hashBytes(processor.id, strlen(processor.id), key);
+	key = hashBytes(&processor.version, sizeof(processor.version), key);
+	if(processor.optionsHash)
+	{
+		const uint64_t optionsHash = processor.optionsHash(options);
+		key = hashBytes(&optionsHash, sizeof(optionsHash), key);
+	}
+	return key;
+}
+static fs::path cacheEntryPath(const KAssetCache& cache, uint64_t key)
+{
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "%016llx%s",
+	         static_cast<unsigned long long>(key), KASSET_CACHE_EXTENSION);
+	return cache.directory / fileName;
+}
+static uint32_t cacheRead32(const uint8_t* p)
+{
+	return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 |
+		uint32_t(p[3]) << 24;
+}
+static uint64_t cacheRead64(const uint8_t* p)
+{
+	return uint64_t(cacheRead32(p)) | uint64_t(cacheRead32(p + 4)) << 32;
+}
+/** @return false if there is no valid entry for `key`; corrupt entries are
+ *          removed */
+static bool cacheLoad(KAssetCache& cache, uint64_t key,
+                      KAssetProcessOutput& o_output)
+{
+	if(cache.directory.empty())
+		return false;
+	const fs::path entryPath = cacheEntryPath(cache, key);
+	std::error_code errorCode;
+	const uintmax_t fileSize = fs::file_size(entryPath, errorCode);
+	if(errorCode)
+	{
+		cache.misses++;
+		return false;
+	}
+	vector<uint8_t> contents;
+	bool valid = fileSize >= KASSET_CACHE_HEADER_SIZE &&
+		readFileContents(entryPath, fileSize, contents) &&
+		memcmp(contents.data(), KASSET_CACHE_MAGIC, 4) == 0 &&
+		cacheRead32(contents.data() + 4) == KASSET_CACHE_VERSION &&
+		cacheRead64(contents.data() + 24) ==
+			fileSize - KASSET_CACHE_HEADER_SIZE;
+	if(valid)
+	{
+		o_output.data.assign(contents.begin() + KASSET_CACHE_HEADER_SIZE,
+		                     contents.end());
+		valid = hashContents(o_output.data.data(), o_output.data.size()) ==
+			cacheRead64(contents.data() + 32);
+	}
+	if(!valid)
+	{
+		fprintf(g_stderr, "WARNING: removing corrupt cache entry '%s'.\n",
+		        (char*)entryPath.u8string().c_str());
+		fs::remove(entryPath, errorCode);
+		cache.misses++;
+		return false;
+	}
+	for(int m = 0; m < 4; m++)
+		o_output.meta[m] = cacheRead32(contents.data() + 8 + 4*m);
+	// the modification time is the entry's last use, for LRU eviction //
+	fs::last_write_time(entryPath, fs::file_time_type::clock::now(), errorCode);
+	cache.hits++;
+	return true;
+}
+/** Failing to store an entry is not an error; it is simply recomputed next
+ * time. */
+static void cacheStore(const KAssetCache& cache, uint64_t key,
+                       const KAssetProcessOutput& output)
+{
+	if(cache.directory.empty())
+		return;
+	vector<uint8_t> header;
+	header.insert(header.end(), KASSET_CACHE_MAGIC, KASSET_CACHE_MAGIC + 4);
+	appendLe32(header, KASSET_CACHE_VERSION);
+	for(int m = 0; m < 4; m++)
+		appendLe32(header, output.meta[m]);
+	appendLe64(header, output.data.size());
+	appendLe64(header, hashContents(output.data.data(), output.data.size()));
+	// write a uniquely named temporary file, then rename it into place so that
+	//	concurrent runs never see a partial entry.  The cache directory may be
+	//	shared by several processes, so the name includes the process id //
+	const fs::path entryPath = cacheEntryPath(cache, key);
+	fs::path tempPath = entryPath;
+	{
+		stringstream ss;
+#if _MSC_VER
+		ss << ".tmp" << _getpid() << "_" << std::this_thread::get_id();
+#else
+		ss << ".tmp" << getpid() << "_" << std::this_thread::get_id();
+#endif
+		tempPath += ss.str();
+	}
+	FILE*const file = openFile(tempPath, "wb");
+	if(!file)
+		return;
+	bool written =
+		fwrite(header.data(), 1, header.size(), file) == header.size() &&
+		fwrite(output.data.data(), 1, output.data.size(), file) ==
+			output.data.size();
+	if(fclose(file) != 0)
+		written = false;
+	std::error_code errorCode;
+	if(written)
+		fs::rename(tempPath, entryPath, errorCode);
+	if(!written || errorCode)
+		fs::remove(tempPath, errorCode);
+}
+/** Remove the least recently used entries until the cache fits within its
+ * size limit. */
+static void cacheEvict(const KAssetCache& cache)
+{
+	if(cache.directory.empty())
+		return;
+	struct Entry
+	{
+		fs::path path;
+		fs::file_time_type lastUse;
+		uintmax_t size;
+	};
+	vector<Entry> entries;
+	uintmax_t totalSize = 0;
+	std::error_code errorCode;
+	const fs::file_time_type now = fs::file_time_type::clock::now();
+	for(const fs::directory_entry& entry :
+		fs::directory_iterator(cache.directory, errorCode))
+	{
+		if(!entry.is_regular_file(errorCode))
+			continue;
+		if(entry.path().extension() != KASSET_CACHE_EXTENSION)
+		// a store in progress, possibly by another process sharing the 
+		//	cache, or an interrupted one which will never be renamed into 
+		//	place once it is old enough //
+		{
+			const fs::file_time_type lastWrite = 
+				entry.last_write_time(errorCode);
+			if(!errorCode && 
+				entry.path().extension().string().rfind(".tmp", 0) == 0 &&
+				now - lastWrite > KASSET_CACHE_STALE_TEMP_AGE)
+			{
+				fs::remove(entry.path(), errorCode);
+			}
+			continue;
+		}
+		entries.push_back({entry.path(), entry.last_write_time(errorCode),
+		                   entry.file_size(errorCode)});
+		totalSize += entries.back().size;
+	}
+	if(totalSize <= cache.maxBytes)
+		return;
+	std::sort(entries.begin(), entries.end(),
+		[](const Entry& lhs, const Entry& rhs)
+		{
+			return lhs.lastUse < rhs.lastUse;
+		});
+	size_t evictedCount = 0;
+	for(const Entry& entry : entries)
+	{
+		if(totalSize <= cache.maxBytes)
+			break;
+		if(fs::remove(entry.path, errorCode))
+		{
+			totalSize -= entry.size;
+			evictedCount++;
+		}
+	}
+	if(g_verbose)
+		fprintf(g_stdout, "Evicted %zu cache entries; the cache now holds %ju "
+		        "bytes.\n", evictedCount, totalSize);
+}
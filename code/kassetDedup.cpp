@@ -0,0 +1,286 @@
+// Content hashing & duplicate asset detection.  Included by `main.cpp`. //
+static const size_t KASSET_HASH_BLOCK_SIZE = 64*1024;
+static const uint64_t HASH_PRIME_1 = 11400714785074694791ULL;
+static const uint64_t HASH_PRIME_2 = 14029467366897019727ULL;
+static const uint64_t HASH_PRIME_3 =  1609587929392839161ULL;
+static const uint64_t HASH_PRIME_4 =  9650029242287828579ULL;
+static const uint64_t HASH_PRIME_5 =  2870177450012600261ULL;
+static inline uint64_t hashRotl(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+static inline uint64_t hashRead64(const uint8_t* p)
+{
+	uint64_t result;
+	memcpy(&result, p, sizeof(result));
+	return result;
+}
+static inline uint32_t hashRead32(const uint8_t* p)
+{
+	uint32_t result;
+	memcpy(&result, p, sizeof(result));
+	return result;
+}
+static inline uint64_t hashRound(uint64_t acc, uint64_t input)
+{
+	acc += input * HASH_PRIME_2;
+	acc  = hashRotl(acc, 31);
+	acc *= HASH_PRIME_1;
+	return acc;
+}
+static inline uint64_t hashMergeRound(uint64_t acc, uint64_t val)
+{
+	acc ^= hashRound(0, val);
+	acc  = acc * HASH_PRIME_1 + HASH_PRIME_4;
+	return acc;
+}
+/** XXH64.  Assumes a little-endian host, which is all we build for. */
+static uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	const uint8_t*const pEnd = p + size;
+	uint64_t h;
+	if(size >= 32)
+	{
+		uint64_t v1 = seed + HASH_PRIME_1 + HASH_PRIME_2;
+		uint64_t v2 = seed + HASH_PRIME_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - HASH_PRIME_1;
+		do
+		{
+			v1 = hashRound(v1, hashRead64(p     ));
+			v2 = hashRound(v2, hashRead64(p +  8));
+			v3 = hashRound(v3, hashRead64(p + 16));
+			v4 = hashRound(v4, hashRead64(p + 24));
+			p += 32;
+		} while(pEnd - p >= 32);
+		h = hashRotl(v1, 1) + hashRotl(v2, 7) +
+		    hashRotl(v3, 12) + hashRotl(v4, 18);
+		h = hashMergeRound(h, v1);
+		h = hashMergeRound(h, v2);
+		h = hashMergeRound(h, v3);
+		h = hashMergeRound(h, v4);
+	}
+	else
+		h = seed + HASH_PRIME_5;
+	h += static_cast<uint64_t>(size);
+	for(; pEnd - p >= 8; p += 8)
+	{
+		h ^= hashRound(0, hashRead64(p));
+		h  = hashRotl(h, 27) * HASH_PRIME_1 + HASH_PRIME_4;
+	}
+	if(pEnd - p >= 4)
+	{
+		h ^= static_cast<uint64_t>(hashRead32(p)) * HASH_PRIME_1;
+		h  = hashRotl(h, 23) * HASH_PRIME_2 + HASH_PRIME_3;
+		p += 4;
+	}
+	for(; p < pEnd; p++)
+	{
+		h ^= (*p) * HASH_PRIME_5;
+		h  = hashRotl(h, 11) * HASH_PRIME_1;
+	}
+	h ^= h >> 33;
+	h *= HASH_PRIME_2;
+	h ^= h >> 29;
+	h *= HASH_PRIME_3;
+	h ^= h >> 32;
+	return h;
+}
+/** Content hashes are chained over fixed-size blocks so that a file can be
+ * hashed while streaming it, and still match the hash of the same bytes held
+ * entirely in memory. */
+static uint64_t hashContents(const void* data, size_t size)
+{
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	uint64_t result = 0;
+	do
+	{
+		const size_t blockSize = std::min(size, KASSET_HASH_BLOCK_SIZE);
+		result = hashBytes(p, blockSize, result);
+		p    += blockSize;
+		size -= blockSize;
+	} while(size > 0);
+	return result;
+}
+static bool hashFile(const fs::path& path, uint64_t* o_hash)
+{
+	FILE*const file = openFile(path, "rb");
+	if(!file)
+	{
+		fprintf(g_stderr, "Failed to open '%s'!\n",
+		        (char*)path.u8string().c_str());
+		return false;
+	}
+	vector<uint8_t> block(KASSET_HASH_BLOCK_SIZE);
+	uint64_t result = 0;
+	bool success = true;
+	bool firstBlock = true;
+	for(;;)
+	{
+		const size_t bytesRead =
+			fread(block.data(), 1, KASSET_HASH_BLOCK_SIZE, file);
+		if(bytesRead < KASSET_HASH_BLOCK_SIZE && ferror(file))
+		{
+			fprintf(g_stderr, "Failed to read '%s'!\n",
+			        (char*)path.u8string().c_str());
+			success = false;
+			break;
+		}
+		// an empty file still gets one (empty) block to match hashContents //
+		if(bytesRead > 0 || firstBlock)
+			result = hashBytes(block.data(), bytesRead, result);
+		firstBlock = false;
+		if(bytesRead < KASSET_HASH_BLOCK_SIZE)
+			break;
+	}
+	fclose(file);
+	*o_hash = result;
+	return success;
+}
+static bool filesEqual(const fs::path& pathA, const fs::path& pathB)
+{
+	FILE*const fileA = openFile(pathA, "rb");
+	FILE*const fileB = openFile(pathB, "rb");
+	bool result = fileA && fileB;
+	if(result)
+	{
+		vector<uint8_t> blockA(KASSET_HASH_BLOCK_SIZE);
+		vector<uint8_t> blockB(KASSET_HASH_BLOCK_SIZE);
+		for(;;)
+		{
+			const size_t bytesReadA =
+				fread(blockA.data(), 1, KASSET_HASH_BLOCK_SIZE, fileA);
+			const size_t bytesReadB =
+				fread(blockB.data(), 1, KASSET_HASH_BLOCK_SIZE, fileB);
+			if(bytesReadA != bytesReadB ||
+				memcmp(blockA.data(), blockB.data(), bytesReadA) != 0 ||
+				ferror(fileA) || ferror(fileB))
+			{
+				result = false;
+				break;
+			}
+			if(bytesReadA < KASSET_HASH_BLOCK_SIZE)
+				break;
+		}
+	}
+	if(fileA)
+		fclose(fileA);
+	if(fileB)
+		fclose(fileB);
+	return result;
+}
+/** Find assets of the same type whose contents are byte-identical.  Assets
+ * are first bucketed by file size, then by content hash, and only then
+ * compared byte-for-byte.  Each asset's `canonicalIndex` is set to the lowest
+ * index of the assets it is identical to (which is its own index if it is
+ * unique).  Assets of different types are never identical, since they are
+ * processed differently & duplicates share their canonical's outputs.
+ * @return the # of bytes occupied by redundant copies of asset contents */
+static uintmax_t dedupAssets(const fs::path& assetPath, vector<KAsset>& assets)
+{
+	uintmax_t bytesSaved = 0;
+	vector<size_t> order;
+	order.reserve(assets.size());
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		assets[a].canonicalIndex = a;
+		if(!assets[a].tombstone)
+			order.push_back(a);
+	}
+	std::stable_sort(order.begin(), order.end(),
+		[&assets](size_t lhs, size_t rhs)
+		{
+			return assets[lhs].fileSize < assets[rhs].fileSize;
+		});
+	vector<size_t> bucket;
+	vector<size_t> representatives;
+	for(size_t o = 0; o < order.size();)
+	{
+		size_t oEnd = o + 1;
+		while(oEnd < order.size() &&
+			assets[order[oEnd]].fileSize == assets[order[o]].fileSize)
+		{
+			oEnd++;
+		}
+		if(oEnd - o <= 1)
+		// this file size is unique, so the asset must be unique too //
+		{
+			o = oEnd;
+			continue;
+		}
+		bucket.clear();
+		for(size_t ob = o; ob < oEnd; ob++)
+		{
+			KAsset& asset = assets[order[ob]];
+			if(!asset.contentHashed)
+			{
+				asset.contentHashed =
+					hashFile(assetFilePath(assetPath, asset),
+					         &asset.contentHash);
+			}
+			if(asset.contentHashed)
+				bucket.push_back(order[ob]);
+		}
+		o = oEnd;
+		std::stable_sort(bucket.begin(), bucket.end(),
+			[&assets](size_t lhs, size_t rhs)
+			{
+				return assets[lhs].contentHash < assets[rhs].contentHash;
+			});
+		for(size_t b = 0; b < bucket.size();)
+		{
+			size_t bEnd = b + 1;
+			while(bEnd < bucket.size() &&
+				assets[bucket[bEnd]].contentHash ==
+					assets[bucket[b]].contentHash)
+			{
+				bEnd++;
+			}
+			// Hashes can collide, so the first asset of each distinct set of
+			//	contents within this run represents all of its copies //
+			representatives.clear();
+			for(size_t bb = b; bb < bEnd; bb++)
+			{
+				KAsset& asset = assets[bucket[bb]];
+				bool isDuplicate = false;
+				for(size_t r : representatives)
+				{
+					if(assets[r].type == asset.type &&
+						filesEqual(assetFilePath(assetPath, assets[r]),
+						           assetFilePath(assetPath, asset)))
+					{
+						asset.canonicalIndex = r;
+						bytesSaved += asset.fileSize;
+						isDuplicate = true;
+						if(g_verbose)
+							fprintf(g_stdout, "Asset '%s' is a duplicate of "
+							        "'%s'...\n", asset.fileName.c_str(),
+							        assets[r].fileName.c_str());
+						break;
+					}
+				}
+				if(!isDuplicate)
+					representatives.push_back(bucket[bb]);
+			}
+			b = bEnd;
+		}
+	}
+	return bytesSaved;
+}
+/** Compute the content hash of every asset which doesn't have one yet. */
+static bool hashAssets(const fs::path& assetPath, vector<KAsset>& assets)
+{
+	std::atomic<bool> success(true);
+	parallelFor(assets.size(), [&](size_t a)
+		{
+			KAsset& asset = assets[a];
+			if(asset.contentHashed || asset.tombstone)
+				return;
+			asset.contentHashed = 
+				hashFile(assetFilePath(assetPath, asset), &asset.contentHash);
+			if(!asset.contentHashed)
+				success = false;
+		});
+	return success;
+}
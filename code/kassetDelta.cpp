@@ -0,0 +1,852 @@
+// Deltas between versions of an asset pack.  Included by `main.cpp`. //
+/* With `--delta-from`, each pack is laid out over its previous version (see
+ * `writeAssetPack`) & `<pack>.kdelta` is written next to it, which
+ * `kasset --apply-delta pack_file delta_file` uses to turn the previous
+ * version into the new one in place.
+ * Delta file layout (all integers are little-endian):
+ *	header:
+ *		char magic[4] = "KDLT"
+ *		u32  version
+ *		u64  baseSize         size & index hash (see KAssetPackIndex) of the
+ *		u64  baseHash         version of the pack which the delta applies to,
+ *		u64  targetSize       & of the version which it produces
+ *		u64  targetHash
+ *		u64  baseFileHash     content hash (see `hashFile`) of the entire base
+ *		u64  targetFileHash   & target files, data included
+ *		u32  copyCount
+ *		u32  literalCount
+ *	copies, in the order they must be applied:
+ *		u64  source           offset within the pack to copy from
+ *		u64  destination
+ *		u64  size
+ *	literals, each followed by its data:
+ *		u64  destination
+ *		u64  size
+ *		u32  flags            KASSET_DELTA_LITERAL_ZERO if the bytes are all 0,
+ *		                      in which case no data follows
+ *		u32  reserved
+ * Assets whose stored contents are unchanged (same content hash, stored size
+ * & chunks) keep their offset, so they cost nothing, or are copied whole if
+ * they can't.  The rest of the new pack is diffed against the rest of the
+ * base with rsync's rolling checksum over fixed size blocks of the base.
+ * Copies are ordered so that none of them overwrites data which a later copy
+ * still has to read, and copies which depend on each other in a cycle become
+ * literals instead; all literals are applied after all copies.  Applying a
+ * delta therefore needs a single fixed size buffer, & writes only the bytes
+ * which changed.  The index hashes quickly tell which version a pack is, but
+ * cover none of the asset data, so the whole base is also hashed (streaming
+ * it through the same fixed size buffer) before anything is written, & the
+ * whole result afterwards.  The assets of a previous manifest can't be
+ * diffed, since a manifest holds only their hashes. */
+static const char* KASSET_DELTA_FILE_EXTENSION = ".kdelta";
+static const char KASSET_DELTA_MAGIC[4] = {'K', 'D', 'L', 'T'};
+static const uint32_t KASSET_DELTA_VERSION = 2;
+static const size_t KASSET_DELTA_HEADER_SIZE = 64;
+static const uint32_t KASSET_DELTA_LITERAL_ZERO = 1;
+static const size_t KASSET_DELTA_BLOCK_SIZE = 512;
+/** runs of zeroes, or of bytes which the base already holds in place,
+ * shorter than this are stored as part of a literal's data */
+static const size_t KASSET_DELTA_RUN_MIN = 32;
+/** # of base blocks with the same weak checksum which are compared */
+static const size_t KASSET_DELTA_MAX_CANDIDATES = 16;
+static const size_t KASSET_DELTA_BUFFER_SIZE = 64*1024;
+struct KAssetDeltaRange
+{
+	uint64_t offset;
+	uint64_t size;
+};
+struct KAssetDeltaCopy
+{
+	uint64_t source;
+	uint64_t destination;
+	uint64_t size;
+};
+struct KAssetDeltaLiteral
+{
+	uint64_t destination;
+	uint64_t size;
+	bool zero;
+};
+struct KAssetDelta
+{
+	vector<KAssetDeltaCopy> copies;
+	vector<KAssetDeltaLiteral> literals;
+};
+/** The parts of the base pack which new data can be copied from, held in
+ * memory & indexed by the weak checksum of each block. */
+struct KAssetDeltaBase
+{
+	vector<uint8_t> bytes;
+	/** `bytes` is the concatenation of these ranges of the base */
+	vector<KAssetDeltaRange> ranges;
+	/** start of each range within `bytes` */
+	vector<size_t> rangeStarts;
+	/** position of each block within `bytes`, & the range it belongs to */
+	vector<size_t> blockStarts;
+	vector<size_t> blockRanges;
+	/** whether any block's weak checksum folds to each 16-bit value, which
+	 * rules out most positions without a hash table lookup */
+	vector<bool> blockFilter;
+	/** first block with each weak checksum; the rest are linked by
+	 * `blockNext` */
+	std::unordered_map<uint32_t, size_t> blockFirst;
+	vector<size_t> blockNext;
+};
+/** @return the parts of [0, size) which aren't in `covered` */
+static vector<KAssetDeltaRange> uncoveredRanges(uint64_t size,
+                                                vector<KAssetDeltaRange> covered)
+{
+	std::sort(covered.begin(), covered.end(),
+		[](const KAssetDeltaRange& lhs, const KAssetDeltaRange& rhs)
+		{
+			return lhs.offset < rhs.offset;
+		});
+	vector<KAssetDeltaRange> result;
+	uint64_t cursor = 0;
+	for(const KAssetDeltaRange& range : covered)
+	{
+		if(range.offset > cursor)
+			result.push_back({cursor, std::min(range.offset, size) - cursor});
+		cursor = std::max(cursor, range.offset + range.size);
+		if(cursor >= size)
+			break;
+	}
+	if(cursor < size)
+		result.push_back({cursor, size - cursor});
+	return result;
+}
+/** rsync's weak checksum of a block: the sum of its bytes (low half) & the
+ * sum of those sums (high half), which can be rolled one byte at a time. */
+static uint32_t deltaWeakChecksum(const uint8_t* data, size_t size,
+                                  uint32_t& o_a, uint32_t& o_b)
+{
+	o_a = 0;
+	o_b = 0;
+	for(size_t i = 0; i < size; i++)
+	{
+		o_a += data[i];
+		o_b += o_a;
+	}
+	return (o_a & 0xFFFF) | (o_b << 16);
+}
+static uint32_t deltaWeakChecksumRoll(uint32_t& io_a, uint32_t& io_b,
+                                      uint8_t out, uint8_t in)
+{
+	io_a += in - out;
+	io_b += io_a - static_cast<uint32_t>(KASSET_DELTA_BLOCK_SIZE)*out;
+	return (io_a & 0xFFFF) | (io_b << 16);
+}
+/** Read `ranges` of the base into memory & index their blocks.  Blocks of
+ * zeroes aren't indexed, since zeroes are cheaper to store as literals. */
+static bool loadDeltaBase(FILE* fileBase,
+                          const vector<KAssetDeltaRange>& ranges,
+                          KAssetDeltaBase& o_base)
+{
+	o_base.ranges = ranges;
+	for(const KAssetDeltaRange& range : ranges)
+	{
+		const size_t rangeStart = o_base.bytes.size();
+		o_base.rangeStarts.push_back(rangeStart);
+		o_base.bytes.resize(rangeStart + static_cast<size_t>(range.size));
+		if(!readFileRange(fileBase, range.offset, range.size,
+		                  o_base.bytes.data() + rangeStart))
+			return false;
+	}
+	static const uint8_t ZEROES[KASSET_DELTA_BLOCK_SIZE] = {};
+	o_base.blockFilter.assign(0x10000, false);
+	for(size_t r = 0; r < ranges.size(); r++)
+		for(size_t b = 0;
+			b + KASSET_DELTA_BLOCK_SIZE <= ranges[r].size;
+			b += KASSET_DELTA_BLOCK_SIZE)
+		{
+			const uint8_t*const block =
+				o_base.bytes.data() + o_base.rangeStarts[r] + b;
+			if(memcmp(block, ZEROES, KASSET_DELTA_BLOCK_SIZE) == 0)
+				continue;
+			uint32_t a, s;
+			const uint32_t weak =
+				deltaWeakChecksum(block, KASSET_DELTA_BLOCK_SIZE, a, s);
+			const size_t blockIndex = o_base.blockStarts.size();
+			o_base.blockStarts.push_back(o_base.rangeStarts[r] + b);
+			o_base.blockRanges.push_back(r);
+			o_base.blockFilter[(weak ^ (weak >> 16)) & 0xFFFF] = true;
+			auto itFirst = o_base.blockFirst.find(weak);
+			if(itFirst == o_base.blockFirst.end())
+			{
+				o_base.blockNext.push_back(SIZE_MAX);
+				o_base.blockFirst.emplace(weak, blockIndex);
+			}
+			else
+			{
+				o_base.blockNext.push_back(itFirst->second);
+				itFirst->second = blockIndex;
+			}
+		}
+	return true;
+}
+static void appendDeltaCopy(KAssetDelta& io_delta, uint64_t source,
+                            uint64_t destination, uint64_t size)
+{
+	if(size == 0 || source == destination)
+		return;
+	if(!io_delta.copies.empty())
+	{
+		KAssetDeltaCopy& previous = io_delta.copies.back();
+		if(previous.source + previous.size == source &&
+			previous.destination + previous.size == destination)
+		{
+			previous.size += size;
+			return;
+		}
+	}
+	io_delta.copies.push_back({source, destination, size});
+}
+static void appendDeltaLiteral(KAssetDelta& io_delta, uint64_t destination,
+                               uint64_t size, bool zero)
+{
+	if(size == 0)
+		return;
+	if(!io_delta.literals.empty())
+	{
+		KAssetDeltaLiteral& previous = io_delta.literals.back();
+		if(previous.zero == zero &&
+			previous.destination + previous.size == destination)
+		{
+			previous.size += size;
+			return;
+		}
+	}
+	io_delta.literals.push_back({destination, size, zero});
+}
+/** Split `data` into runs of zeroes & everything else. */
+static void appendDeltaLiterals(KAssetDelta& io_delta, const uint8_t* data,
+                                size_t size, uint64_t destination)
+{
+	size_t literalStart = 0;
+	for(size_t i = 0; i < size;)
+	{
+		if(data[i] != 0)
+		{
+			i++;
+			continue;
+		}
+		size_t zeroEnd = i;
+		while(zeroEnd < size && data[zeroEnd] == 0)
+			zeroEnd++;
+		if(zeroEnd - i >= KASSET_DELTA_RUN_MIN)
+		{
+			appendDeltaLiteral(io_delta, destination + literalStart,
+			                   i - literalStart, false);
+			appendDeltaLiteral(io_delta, destination + i, zeroEnd - i, true);
+			literalStart = zeroEnd;
+		}
+		i = zeroEnd;
+	}
+	appendDeltaLiteral(io_delta, destination + literalStart,
+	                   size - literalStart, false);
+}
+/** @return the position within `base.bytes` of [offset, offset + size) of
+ *          the base, or SIZE_MAX if that isn't within one loaded range;
+ *          `o_range` receives the range */
+static size_t deltaBaseFind(const KAssetDeltaBase& base, uint64_t offset,
+                            uint64_t size, size_t& o_range)
+{
+	auto itRange = std::upper_bound(base.ranges.begin(), base.ranges.end(),
+		offset, [](uint64_t value, const KAssetDeltaRange& range)
+		{
+			return value < range.offset;
+		});
+	if(itRange == base.ranges.begin())
+		return SIZE_MAX;
+	--itRange;
+	if(offset + size > itRange->offset + itRange->size)
+		return SIZE_MAX;
+	o_range = static_cast<size_t>(itRange - base.ranges.begin());
+	return base.rangeStarts[o_range] +
+		static_cast<size_t>(offset - itRange->offset);
+}
+/** Diff `data`, which is to be written at `destination` of the new pack,
+ * against the loaded parts of the base. */
+static void diffDeltaRange(const KAssetDeltaBase& base, const uint8_t* data,
+                           size_t size, uint64_t destination,
+                           KAssetDelta& io_delta)
+{
+	const size_t blockSize = KASSET_DELTA_BLOCK_SIZE;
+	size_t literalStart = 0;
+	size_t position     = 0;
+	// source - destination of the previous match //
+	uint64_t displacement = 0;
+	uint32_t a = 0, b = 0, weak = 0;
+	if(size >= blockSize)
+		weak = deltaWeakChecksum(data, blockSize, a, b);
+	while(position + blockSize <= size)
+	{
+		size_t matchStart = SIZE_MAX;
+		size_t range      = 0;
+		auto itFirst = base.blockFilter[(weak ^ (weak >> 16)) & 0xFFFF]
+			? base.blockFirst.find(weak) : base.blockFirst.end();
+		if(itFirst != base.blockFirst.end())
+		{
+			// repetitive data (such as a table of contents) matches many
+			//	blocks, so first try the data which is already in place, then
+			//	the data which continues the previous match //
+			const uint64_t target = destination + position;
+			for(uint64_t source : {target, target + displacement})
+			{
+				matchStart = deltaBaseFind(base, source, blockSize, range);
+				if(matchStart != SIZE_MAX &&
+					memcmp(base.bytes.data() + matchStart, data + position,
+					       blockSize) == 0)
+					break;
+				matchStart = SIZE_MAX;
+			}
+			size_t candidates = 0;
+			for(size_t block = itFirst->second;
+				matchStart == SIZE_MAX && block != SIZE_MAX &&
+					candidates < KASSET_DELTA_MAX_CANDIDATES;
+				block = base.blockNext[block], candidates++)
+			{
+				if(memcmp(base.bytes.data() + base.blockStarts[block],
+				          data + position, blockSize) == 0)
+				{
+					matchStart = base.blockStarts[block];
+					range      = base.blockRanges[block];
+				}
+			}
+		}
+		if(matchStart == SIZE_MAX)
+		{
+			if(position + blockSize < size)
+				weak = deltaWeakChecksumRoll(a, b, data[position],
+				                             data[position + blockSize]);
+			position++;
+			continue;
+		}
+		// grow the match in both directions, within its range of the base //
+		const size_t rangeStart = base.rangeStarts[range];
+		const size_t rangeEnd   =
+			rangeStart + static_cast<size_t>(base.ranges[range].size);
+		size_t matchSize = blockSize;
+		while(position + matchSize < size && matchStart + matchSize < rangeEnd &&
+			data[position + matchSize] == base.bytes[matchStart + matchSize])
+		{
+			matchSize++;
+		}
+		while(position > literalStart && matchStart > rangeStart &&
+			data[position - 1] == base.bytes[matchStart - 1])
+		{
+			position--;
+			matchStart--;
+			matchSize++;
+		}
+		const uint64_t source =
+			base.ranges[range].offset + (matchStart - rangeStart);
+		appendDeltaLiterals(io_delta, data + literalStart,
+		                    position - literalStart, destination + literalStart);
+		appendDeltaCopy(io_delta, source, destination + position, matchSize);
+		displacement = source - (destination + position);
+		position    += matchSize;
+		literalStart = position;
+		if(position + blockSize <= size)
+			weak = deltaWeakChecksum(data + position, blockSize, a, b);
+	}
+	appendDeltaLiterals(io_delta, data + literalStart, size - literalStart,
+	                    destination + literalStart);
+}
+/** Drop the parts of each literal which the base already holds at the same
+ * offset, such as padding & the unchanged parts of the pack's header &
+ * table of contents, so that they aren't rewritten. */
+static bool trimDeltaLiterals(FILE* fileBase, uint64_t baseSize,
+                              FILE* filePack, KAssetDelta& io_delta)
+{
+	const vector<KAssetDeltaLiteral> literals = std::move(io_delta.literals);
+	io_delta.literals.clear();
+	vector<uint8_t> baseData;
+	vector<uint8_t> packData;
+	for(const KAssetDeltaLiteral& literal : literals)
+	{
+		if(literal.destination >= baseSize)
+		{
+			io_delta.literals.push_back(literal);
+			continue;
+		}
+		const uint64_t comparedSize =
+			std::min(literal.size, baseSize - literal.destination);
+		uint64_t literalStart = 0;
+		for(uint64_t compared = 0; compared < comparedSize;)
+		{
+			const size_t step = static_cast<size_t>(std::min<uint64_t>(
+				comparedSize - compared, KASSET_DELTA_BUFFER_SIZE));
+			baseData.resize(step);
+			packData.resize(step);
+			if(!readFileRange(fileBase, literal.destination + compared, step,
+			                  baseData.data()) ||
+				(!literal.zero &&
+				 !readFileRange(filePack, literal.destination + compared,
+				                step, packData.data())))
+				return false;
+			if(literal.zero)
+				std::fill(packData.begin(), packData.end(), uint8_t(0));
+			for(size_t i = 0; i < step;)
+			{
+				if(baseData[i] != packData[i])
+				{
+					i++;
+					continue;
+				}
+				size_t sameEnd = i;
+				while(sameEnd < step && baseData[sameEnd] == packData[sameEnd])
+					sameEnd++;
+				const uint64_t sameStart = compared + i;
+				const size_t   sameSize  = sameEnd - i;
+				// trimming either end of a literal costs nothing, but a run in
+				//	the middle splits it in two.  A run at the end of a step may
+				//	continue in the next one, but is only dropped if it's long
+				//	enough by itself //
+				if(sameSize >= KASSET_DELTA_RUN_MIN || sameStart == literalStart ||
+					sameStart + sameSize == literal.size)
+				{
+					appendDeltaLiteral(io_delta,
+					                   literal.destination + literalStart,
+					                   sameStart - literalStart, literal.zero);
+					literalStart = sameStart + sameSize;
+				}
+				i = sameEnd;
+			}
+			compared += step;
+		}
+		appendDeltaLiteral(io_delta, literal.destination + literalStart,
+		                   literal.size - literalStart, literal.zero);
+	}
+	return true;
+}
+/** Order the copies of `io_delta` so that each copy runs before any copy
+ * which overwrites its source.  Whenever the remaining copies all wait on
+ * each other, the smallest of them becomes a literal.
+ * @return # of bytes which became literals */
+static uint64_t orderDeltaCopies(KAssetDelta& io_delta)
+{
+	const vector<KAssetDeltaCopy> copies = std::move(io_delta.copies);
+	io_delta.copies.clear();
+	const size_t copyCount = copies.size();
+	// destinations never overlap, so sorted by offset they can be searched //
+	vector<size_t> byDestination(copyCount);
+	for(size_t c = 0; c < copyCount; c++)
+		byDestination[c] = c;
+	std::sort(byDestination.begin(), byDestination.end(),
+		[&copies](size_t lhs, size_t rhs)
+		{
+			return copies[lhs].destination < copies[rhs].destination;
+		});
+	// `overwriters[c]` are the copies which must wait for copy `c` to read
+	//	its source; `waits[c]` is the # of copies copy `c` is waiting for //
+	vector<vector<size_t>> overwriters(copyCount);
+	vector<size_t> waits(copyCount, 0);
+	for(size_t c = 0; c < copyCount; c++)
+	{
+		const uint64_t sourceEnd = copies[c].source + copies[c].size;
+		auto itDestination = std::partition_point(
+			byDestination.begin(), byDestination.end(),
+			[&](size_t d)
+			{
+				return copies[d].destination + copies[d].size <=
+					copies[c].source;
+			});
+		for(; itDestination != byDestination.end() &&
+				copies[*itDestination].destination < sourceEnd;
+			++itDestination)
+		{
+			// a copy which overlaps itself is applied in a safe direction //
+			if(*itDestination == c)
+				continue;
+			overwriters[c].push_back(*itDestination);
+			waits[*itDestination]++;
+		}
+	}
+	vector<bool> done(copyCount, false);
+	vector<size_t> ready;
+	for(size_t c = 0; c < copyCount; c++)
+		if(waits[c] == 0)
+			ready.push_back(c);
+	uint64_t literalBytes = 0;
+	for(size_t doneCount = 0; doneCount < copyCount;)
+	{
+		size_t c;
+		if(ready.empty())
+		// break the cycle; a literal reads nothing from the pack //
+		{
+			c = SIZE_MAX;
+			for(size_t r = 0; r < copyCount; r++)
+				if(!done[r] && (c == SIZE_MAX || copies[r].size < copies[c].size))
+					c = r;
+			appendDeltaLiteral(io_delta, copies[c].destination, copies[c].size,
+			                   false);
+			literalBytes += copies[c].size;
+		}
+		else
+		{
+			c = ready.back();
+			ready.pop_back();
+			if(done[c])
+				continue;
+			io_delta.copies.push_back(copies[c]);
+		}
+		done[c] = true;
+		doneCount++;
+		for(size_t overwriter : overwriters[c])
+			if(--waits[overwriter] == 0 && !done[overwriter])
+				ready.push_back(overwriter);
+	}
+	return literalBytes;
+}
+/** Write the delta which turns `basePath` into `packPath`, which must have
+ * been laid out over `basePath` by `writeAssetPack`. */
+static bool writeAssetPackDelta(const fs::path& basePath,
+                                const KAssetPackIndex& base,
+                                const fs::path& packPath,
+                                const fs::path& deltaPath)
+{
+	KAssetPackIndex target;
+	uint64_t baseFileHash;
+	uint64_t targetFileHash;
+	if(!readAssetPackIndex(packPath, target) ||
+		!hashFile(basePath, &baseFileHash) ||
+		!hashFile(packPath, &targetFileHash))
+		return false;
+	FILE*const fileBase = openFile(basePath, "rb");
+	FILE*const filePack = openFile(packPath, "rb");
+	if(!fileBase || !filePack)
+	{
+		if(fileBase)
+			fclose(fileBase);
+		if(filePack)
+			fclose(filePack);
+		fprintf(g_stderr, "Failed to open '%s' or '%s'!\n",
+		        (char*)basePath.u8string().c_str(),
+		        (char*)packPath.u8string().c_str());
+		return false;
+	}
+	KAssetDelta delta;
+	// unchanged assets are found by content hash & never diffed //
+	std::unordered_map<uint64_t, size_t> baseEntryOf;
+	for(size_t e = 0; e < base.entries.size(); e++)
+		if(base.entries[e].storedSize > 0)
+			baseEntryOf.emplace(base.entries[e].contentHash, e);
+	vector<KAssetDeltaRange> targetCovered;
+	vector<KAssetDeltaRange> baseCovered;
+	std::unordered_map<uint64_t, bool> targetOffsetsSeen;
+	vector<uint32_t> chunkStoredSizes;
+	for(const KAssetPackIndexEntry& entry : target.entries)
+	{
+		// duplicate assets alias the same data //
+		if(entry.storedSize == 0 ||
+			!targetOffsetsSeen.emplace(entry.offset, true).second)
+			continue;
+		auto itBaseEntry = baseEntryOf.find(entry.contentHash);
+		if(itBaseEntry == baseEntryOf.end())
+			continue;
+		chunkStoredSizes.clear();
+		for(uint32_t c = 0; c < entry.chunkCount; c++)
+			chunkStoredSizes.push_back(
+				target.chunks[entry.firstChunk + c].storedSize);
+		const KAssetPackIndexEntry& baseEntry =
+			base.entries[itBaseEntry->second];
+		if(!packIndexEntryMatches(base, baseEntry, entry.contentHash,
+		                          chunkStoredSizes, entry.storedSize))
+			continue;
+		appendDeltaCopy(delta, baseEntry.offset, entry.offset,
+		                entry.storedSize);
+		targetCovered.push_back({entry.offset, entry.storedSize});
+		baseCovered.push_back({baseEntry.offset, baseEntry.storedSize});
+	}
+	const size_t unchangedCopyCount = delta.copies.size();
+	KAssetDeltaBase deltaBase;
+	bool success =
+		loadDeltaBase(fileBase, uncoveredRanges(base.fileSize, baseCovered),
+		              deltaBase);
+	vector<uint8_t> data;
+	for(const KAssetDeltaRange& range :
+			uncoveredRanges(target.fileSize, targetCovered))
+	{
+		data.resize(static_cast<size_t>(range.size));
+		success = success &&
+			readFileRange(filePack, range.offset, range.size, data.data());
+		if(!success)
+			break;
+		diffDeltaRange(deltaBase, data.data(), data.size(), range.offset,
+		               delta);
+	}
+	vector<uint8_t>().swap(deltaBase.bytes);
+	success = success &&
+		trimDeltaLiterals(fileBase, base.fileSize, filePack, delta);
+	fclose(fileBase);
+	const uint64_t cycleBytes = orderDeltaCopies(delta);
+	// write the delta; literal data comes straight from the new pack //
+	FILE*const fileDelta = success ? openFile(deltaPath, "wb") : nullptr;
+	success = success && fileDelta;
+	vector<uint8_t> buffer;
+	buffer.insert(buffer.end(), KASSET_DELTA_MAGIC, KASSET_DELTA_MAGIC + 4);
+	appendLe32(buffer, KASSET_DELTA_VERSION);
+	appendLe64(buffer, base.fileSize);
+	appendLe64(buffer, base.hash);
+	appendLe64(buffer, target.fileSize);
+	appendLe64(buffer, target.hash);
+	appendLe64(buffer, baseFileHash);
+	appendLe64(buffer, targetFileHash);
+	appendLe32(buffer, static_cast<uint32_t>(delta.copies.size()));
+	appendLe32(buffer, static_cast<uint32_t>(delta.literals.size()));
+	uint64_t copyBytes = 0;
+	for(const KAssetDeltaCopy& copy : delta.copies)
+	{
+		appendLe64(buffer, copy.source);
+		appendLe64(buffer, copy.destination);
+		appendLe64(buffer, copy.size);
+		copyBytes += copy.size;
+	}
+	success = success &&
+		fwrite(buffer.data(), 1, buffer.size(), fileDelta) == buffer.size();
+	uint64_t literalBytes = 0;
+	uint64_t zeroBytes    = 0;
+	for(const KAssetDeltaLiteral& literal : delta.literals)
+	{
+		if(!success)
+			break;
+		buffer.clear();
+		appendLe64(buffer, literal.destination);
+		appendLe64(buffer, literal.size);
+		appendLe32(buffer, literal.zero ? KASSET_DELTA_LITERAL_ZERO : 0);
+		appendLe32(buffer, 0);
+		success =
+			fwrite(buffer.data(), 1, buffer.size(), fileDelta) == buffer.size();
+		if(literal.zero)
+		{
+			zeroBytes += literal.size;
+			continue;
+		}
+		literalBytes += literal.size;
+		for(uint64_t written = 0; success && written < literal.size;)
+		{
+			const size_t step = static_cast<size_t>(std::min<uint64_t>(
+				literal.size - written, KASSET_DELTA_BUFFER_SIZE));
+			buffer.resize(step);
+			success =
+				readFileRange(filePack, literal.destination + written, step,
+				              buffer.data()) &&
+				fwrite(buffer.data(), 1, step, fileDelta) == step;
+			written += step;
+		}
+	}
+	fclose(filePack);
+	if(fileDelta && fclose(fileDelta) != 0)
+		success = false;
+	if(!success)
+	{
+		fprintf(g_stderr, "Failed to write '%s'!\n",
+		        (char*)deltaPath.u8string().c_str());
+		return false;
+	}
+	fprintf(g_stdout, "Delta '%s': %llu bytes of new data, %llu bytes zeroed, "
+	        "%llu bytes moved by %zu copies.\n",
+	        (char*)deltaPath.filename().u8string().c_str(),
+	        static_cast<unsigned long long>(literalBytes),
+	        static_cast<unsigned long long>(zeroBytes),
+	        static_cast<unsigned long long>(copyBytes), delta.copies.size());
+	if(g_verbose)
+		fprintf(g_stdout, "\t%zu whole unchanged assets moved; %llu bytes "
+		        "became literals to break cycles.\n", unchangedCopyCount,
+		        static_cast<unsigned long long>(cycleBytes));
+	return true;
+}
+/** Write a pack with `writeAssetPack`.  With `--delta-from`, the pack is
+ * laid out over its previous version, & the delta from that version is
+ * written next to it.  The new version is written to a temporary file which
+ * only replaces the pack once the delta has been written too, so the
+ * previous version (which may be the pack itself) is left as it was if
+ * anything fails. */
+static bool writeAssetPackVersion(const fs::path& assetPath,
+                                  const fs::path& packPath,
+                                  const KassetOptions& options,
+                                  KAssetCache& cache, vector<KAsset>& assets,
+                                  const vector<size_t>& members,
+                                  vector<KAssetPackChunk>& io_chunks,
+                                  uint64_t* o_dataSize = nullptr)
+{
+	if(!options.deltaFrom)
+		return writeAssetPack(assetPath, packPath, options, cache, assets,
+		                      members, io_chunks, o_dataSize);
+	fs::path basePath(options.deltaFrom);
+	if(fs::is_directory(basePath))
+		basePath /= packPath.filename();
+	fs::path deltaPath = packPath;
+	deltaPath += KASSET_DELTA_FILE_EXTENSION;
+	std::error_code errorCode;
+	if(!fs::exists(basePath))
+	{
+		fprintf(g_stdout, "WARNING: '%s' has no previous version; no delta "
+		        "written.\n", (char*)packPath.filename().u8string().c_str());
+		fs::remove(deltaPath, errorCode);
+		return writeAssetPack(assetPath, packPath, options, cache, assets,
+		                      members, io_chunks, o_dataSize);
+	}
+	fs::path tempPath = packPath;
+	tempPath += ".tmp";
+	KAssetPackIndex base;
+	const bool success = readAssetPackIndex(basePath, base) &&
+		writeAssetPack(assetPath, tempPath, options, cache, assets, members,
+		               io_chunks, o_dataSize, &base) &&
+		writeAssetPackDelta(basePath, base, tempPath, deltaPath);
+	if(success)
+		fs::rename(tempPath, packPath, errorCode);
+	if(!success || errorCode)
+	{
+		if(success)
+			fprintf(g_stderr, "Failed to move '%s' to '%s'!\n",
+			        (char*)tempPath.u8string().c_str(),
+			        (char*)packPath.u8string().c_str());
+		// a delta is only of use next to the pack it produces //
+		fs::remove(tempPath, errorCode);
+		fs::remove(deltaPath, errorCode);
+		return false;
+	}
+	return true;
+}
+/** `kasset --apply-delta pack_file delta_file [--verbose]` */
+static bool runApplyDelta(int argc, char** argv)
+{
+	if(argc < 4)
+	{
+		fprintf(g_stderr, "Incorrect # of arguments!\n");
+		return false;
+	}
+	const fs::path packPath (argv[2]);
+	const fs::path deltaPath(argv[3]);
+	for(int a = 4; a < argc; a++)
+	{
+		if(strcmp(argv[a], "--verbose") == 0)
+		{
+			g_verbose = true;
+		}
+		else
+		{
+			fprintf(g_stderr, "ERROR: incorrect usage on param[%i]=='%s'\n",
+			        a, argv[a]);
+			return false;
+		}
+	}
+	FILE*const fileDelta = openFile(deltaPath, "rb");
+	if(!fileDelta)
+	{
+		fprintf(g_stderr, "Failed to open '%s'!\n",
+		        (char*)deltaPath.u8string().c_str());
+		return false;
+	}
+	uint8_t header[KASSET_DELTA_HEADER_SIZE];
+	if(fread(header, 1, sizeof(header), fileDelta) != sizeof(header) ||
+		memcmp(header, KASSET_DELTA_MAGIC, 4) != 0 ||
+		cacheRead32(header + 4) != KASSET_DELTA_VERSION)
+	{
+		fclose(fileDelta);
+		fprintf(g_stderr, "'%s' is not a version %u kasset delta!\n",
+		        (char*)deltaPath.u8string().c_str(), KASSET_DELTA_VERSION);
+		return false;
+	}
+	const uint64_t baseSize     = cacheRead64(header +  8);
+	const uint64_t baseHash     = cacheRead64(header + 16);
+	const uint64_t targetSize   = cacheRead64(header + 24);
+	const uint64_t targetHash     = cacheRead64(header + 32);
+	const uint64_t baseFileHash   = cacheRead64(header + 40);
+	const uint64_t targetFileHash = cacheRead64(header + 48);
+	const uint32_t copyCount      = cacheRead32(header + 56);
+	const uint32_t literalCount   = cacheRead32(header + 60);
+	KAssetPackIndex index;
+	uint64_t fileHash;
+	if(!readAssetPackIndex(packPath, index) || !hashFile(packPath, &fileHash))
+	{
+		fclose(fileDelta);
+		return false;
+	}
+	if(index.fileSize == targetSize && index.hash == targetHash &&
+		fileHash == targetFileHash)
+	{
+		fclose(fileDelta);
+		fprintf(g_stdout, "'%s' is already up to date.\n",
+		        (char*)packPath.u8string().c_str());
+		return true;
+	}
+	if(index.fileSize != baseSize || index.hash != baseHash ||
+		fileHash != baseFileHash)
+	{
+		fclose(fileDelta);
+		fprintf(g_stderr, "'%s' is not the version of the pack which '%s' "
+		                  "applies to!\n",
+		        (char*)packPath.u8string().c_str(),
+		        (char*)deltaPath.u8string().c_str());
+		return false;
+	}
+	std::error_code errorCode;
+	if(targetSize > baseSize)
+		fs::resize_file(packPath, targetSize, errorCode);
+	FILE*const filePack = errorCode ? nullptr : openFile(packPath, "r+b");
+	bool success = filePack != nullptr;
+	vector<uint8_t> buffer(KASSET_DELTA_BUFFER_SIZE);
+	uint8_t record[24];
+	uint64_t bytesWritten = 0;
+	for(uint32_t c = 0; success && c < copyCount; c++)
+	{
+		success = fread(record, 1, 24, fileDelta) == 24;
+		if(!success)
+			break;
+		const uint64_t source      = cacheRead64(record);
+		const uint64_t destination = cacheRead64(record + 8);
+		const uint64_t size        = cacheRead64(record + 16);
+		success = source + size <= std::max(baseSize, targetSize) &&
+			destination + size <= targetSize &&
+			copyWithinFile(filePack, source, destination, size, buffer);
+		bytesWritten += size;
+	}
+	for(uint32_t l = 0; success && l < literalCount; l++)
+	{
+		success = fread(record, 1, 24, fileDelta) == 24;
+		if(!success)
+			break;
+		const uint64_t destination = cacheRead64(record);
+		const uint64_t size        = cacheRead64(record + 8);
+		const bool zero = (cacheRead32(record + 16) & KASSET_DELTA_LITERAL_ZERO) != 0;
+		success = destination + size <= targetSize &&
+			seekFile(filePack, destination);
+		if(zero)
+			std::fill(buffer.begin(), buffer.end(), uint8_t(0));
+		for(uint64_t written = 0; success && written < size;)
+		{
+			const size_t step = static_cast<size_t>(
+				std::min<uint64_t>(size - written, buffer.size()));
+			success =
+				(zero || fread(buffer.data(), 1, step, fileDelta) == step) &&
+				fwrite(buffer.data(), 1, step, filePack) == step;
+			written += step;
+		}
+		bytesWritten += size;
+	}
+	fclose(fileDelta);
+	if(filePack && fclose(filePack) != 0)
+		success = false;
+	if(success && targetSize < baseSize)
+	{
+		fs::resize_file(packPath, targetSize, errorCode);
+		success = !errorCode;
+	}
+	if(!success || !readAssetPackIndex(packPath, index) ||
+		index.fileSize != targetSize || index.hash != targetHash ||
+		!hashFile(packPath, &fileHash) || fileHash != targetFileHash)
+	{
+		fprintf(g_stderr, "Failed to apply '%s'; '%s' must be restored from a "
+		                  "full copy!\n",
+		        (char*)deltaPath.u8string().c_str(),
+		        (char*)packPath.u8string().c_str());
+		return false;
+	}
+	fprintf(g_stdout, "Patched '%s'; %llu bytes written.\n",
+	        (char*)packPath.u8string().c_str(),
+	        static_cast<unsigned long long>(bytesWritten));
+	return true;
+}
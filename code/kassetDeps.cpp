@@ -0,0 +1,293 @@
+// Asset dependency graph.  Included by `main.cpp`. //
+/* Some assets reference others: a flipbook needs its sprite sheet, & a
+ * material (`.mat`) needs its textures.  `--deps` runs the reference
+ * extractor registered for each asset type, then emits the graph as
+ * compressed sparse rows so that a loader can request an asset together
+ * with everything it transitively depends on in a single batch.
+ *
+ * A material is a list of `key: value` lines, like a flipbook; each value
+ * which names an asset (relative to the material's directory, or else to the
+ * asset directory) is a reference.  Other values are material parameters. */
+/** Append the file names which `asset` references to `o_references`.
+ * @return false if the asset could not be read */
+using KAssetReferenceExtractor =
+	bool (*)(const fs::path& assetPath, const KAsset& asset,
+	         const std::unordered_map<string, size_t>& assetOfFileName,
+	         vector<string>& o_references);
+/** Call `function(key, value)` for each line of a `key: value` metadata file.
+ * @return false if the file could not be read */
+static bool forEachMetadataLine(
+	const fs::path& path,
+	const std::function<void(const string&, const string&)>& function)
+{
+	const uintmax_t fileSize = fs::file_size(path);
+	char*const fileMetadata = readEntireFile(path.c_str(), fileSize);
+	if(!fileMetadata)
+		return false;
+	istringstream iss(fileMetadata);
+	free(fileMetadata);
+	string line;
+	string key;
+	string value;
+	while(std::getline(iss, line))
+	{
+		ltrim(line);
+		rtrim(line);
+		if(line.empty() || line[0] == '#' || !splitMetadataLine(line, key, value))
+			continue;
+		function(key, value);
+	}
+	return true;
+}
+static bool extractFlipbookReferences(
+	const fs::path& assetPath, const KAsset& asset,
+	const std::unordered_map<string, size_t>&, vector<string>& o_references)
+{
+	string texture;
+	const bool success = forEachMetadataLine(assetFilePath(assetPath, asset),
+		[&texture](const string& key, const string& value)
+		{
+			if(key == "texture")
+				texture = value;
+		});
+	o_references.push_back(flipbookSheetFileName(asset.fileName, texture));
+	return success;
+}
+static bool extractMaterialReferences(
+	const fs::path& assetPath, const KAsset& asset,
+	const std::unordered_map<string, size_t>& assetOfFileName,
+	vector<string>& o_references)
+{
+	const size_t slash = asset.fileName.rfind('/');
+	const string directory =
+		slash == string::npos ? "" : asset.fileName.substr(0, slash + 1);
+	return forEachMetadataLine(assetFilePath(assetPath, asset),
+		[&](const string&, const string& value)
+		{
+			if(assetOfFileName.count(directory + value))
+				o_references.push_back(directory + value);
+			else if(assetOfFileName.count(value))
+				o_references.push_back(value);
+			else if(assetTypeFromFileName(value) != KAssetType::UNKNOWN)
+			// this was probably meant to be an asset //
+				o_references.push_back(directory + value);
+		});
+}
+static const struct
+{
+	KAssetType type;
+	KAssetReferenceExtractor extract;
+} ASSET_REFERENCE_EXTRACTORS[] =
+	{ {KAssetType::FLIPBOOK_META, extractFlipbookReferences}
+	, {KAssetType::MATERIAL     , extractMaterialReferences}
+};
+struct KAssetDepGraph
+{
+	/** CSR rows of each asset's direct dependencies */
+	vector<size_t> depOffsets;
+	vector<size_t> deps;
+	/** CSR rows of each asset's transitive dependencies followed by the
+	 * asset itself; every row is in dependency order */
+	vector<size_t> closureOffsets;
+	vector<size_t> closure;
+	/** position of each asset in a topological order of the whole graph,
+	 * where dependencies come before their dependents */
+	vector<size_t> rank;
+};
+/** @return false if a reference couldn't be extracted, or the references
+ *          form a cycle */
+static bool buildAssetDepGraph(const fs::path& assetPath,
+                               const vector<KAsset>& assets,
+                               KAssetDepGraph& o_graph)
+{
+	std::unordered_map<string, size_t> assetOfFileName;
+	for(size_t a = 0; a < assets.size(); a++)
+		if(!assets[a].tombstone)
+			assetOfFileName[assets[a].fileName] = a;
+	vector<vector<string>> references(assets.size());
+	std::atomic<bool> success(true);
+	parallelFor(assets.size(), [&](size_t a)
+		{
+			if(assets[a].tombstone)
+				return;
+			for(const auto& extractor : ASSET_REFERENCE_EXTRACTORS)
+				if(extractor.type == assets[a].type &&
+					!extractor.extract(assetPath, assets[a], assetOfFileName,
+					                   references[a]))
+				{
+					fprintf(g_stderr, "Failed to extract the references of "
+					        "'%s'!\n", assets[a].fileName.c_str());
+					success = false;
+				}
+		});
+	if(!success)
+		return false;
+	vector<vector<size_t>> deps(assets.size());
+	for(size_t a = 0; a < assets.size(); a++)
+		for(const string& reference : references[a])
+		{
+			auto itDep = assetOfFileName.find(reference);
+			if(itDep == assetOfFileName.end())
+			{
+				fprintf(g_stdout, "WARNING: '%s' references '%s', which is "
+				        "not an asset.\n", assets[a].fileName.c_str(),
+				        reference.c_str());
+				continue;
+			}
+			if(std::find(deps[a].begin(), deps[a].end(), itDep->second) ==
+				deps[a].end())
+			{
+				deps[a].push_back(itDep->second);
+			}
+		}
+	// depth-first topological sort; each asset is ranked after all of its
+	//	dependencies //
+	enum class Mark : uint8_t { NONE, VISITING, DONE };
+	vector<Mark> marks(assets.size(), Mark::NONE);
+	o_graph.rank.assign(assets.size(), 0);
+	size_t nextRank = 0;
+	vector<std::pair<size_t, size_t>> stack;
+	for(size_t root = 0; root < assets.size(); root++)
+	{
+		if(marks[root] != Mark::NONE)
+			continue;
+		stack.push_back({root, 0});
+		marks[root] = Mark::VISITING;
+		while(!stack.empty())
+		{
+			const size_t a = stack.back().first;
+			const size_t d = stack.back().second++;
+			if(d == deps[a].size())
+			{
+				marks[a] = Mark::DONE;
+				o_graph.rank[a] = nextRank++;
+				stack.pop_back();
+				continue;
+			}
+			const size_t dep = deps[a][d];
+			if(marks[dep] == Mark::VISITING)
+			{
+				fprintf(g_stderr, "Asset dependency cycle: '%s' depends on "
+				        "'%s', which depends on it!\n",
+				        assets[a].fileName.c_str(),
+				        assets[dep].fileName.c_str());
+				return false;
+			}
+			if(marks[dep] == Mark::NONE)
+			{
+				marks[dep] = Mark::VISITING;
+				stack.push_back({dep, 0});
+			}
+		}
+	}
+	auto byRank = [&o_graph](size_t lhs, size_t rhs)
+	{
+		return o_graph.rank[lhs] < o_graph.rank[rhs];
+	};
+	o_graph.depOffsets.assign(1, 0);
+	o_graph.closureOffsets.assign(1, 0);
+	o_graph.deps.clear();
+	o_graph.closure.clear();
+	vector<size_t> closure;
+	vector<bool> inClosure(assets.size(), false);
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		std::sort(deps[a].begin(), deps[a].end(), byRank);
+		o_graph.deps.insert(o_graph.deps.end(), deps[a].begin(), deps[a].end());
+		o_graph.depOffsets.push_back(o_graph.deps.size());
+		closure.clear();
+		if(!assets[a].tombstone)
+		{
+			closure.push_back(a);
+			inClosure[a] = true;
+		}
+		for(size_t c = 0; c < closure.size(); c++)
+			for(size_t dep : deps[closure[c]])
+				if(!inClosure[dep])
+				{
+					inClosure[dep] = true;
+					closure.push_back(dep);
+				}
+		for(size_t c : closure)
+			inClosure[c] = false;
+		std::sort(closure.begin(), closure.end(), byRank);
+		o_graph.closure.insert(o_graph.closure.end(), closure.begin(),
+		                       closure.end());
+		o_graph.closureOffsets.push_back(o_graph.closure.size());
+	}
+	if(g_verbose)
+		fprintf(g_stdout, "Found %zu asset dependencies.\n",
+		        o_graph.deps.size());
+	return true;
+}
+static void appendUnsignedTable(string& result, const char* declaration,
+                                const vector<size_t>& values)
+{
+	result.append(declaration);
+	result.append(" = \n");
+	for(size_t v = 0; v < values.size(); v++)
+	{
+		stringstream ss;
+		ss << (v == 0 ? "\t{ " : "\t, ") << values[v] << "\n";
+		result.append(ss.str());
+	}
+	if(values.empty())
+		result.append("{0};\n");
+	else
+		result.append("};\n");
+}
+static string generateDepTables(const KAssetDepGraph& graph)
+{
+	string result;
+	result.append("/* Asset dependencies as compressed sparse rows: the direct "
+	              "dependencies of\n"
+	              "\tasset `a` are kgtAssetDeps[kgtAssetDepOffsets[a]] up to "
+	              "(excluding)\n"
+	              "\tkgtAssetDeps[kgtAssetDepOffsets[a + 1]].  The rows of "
+	              "kgtAssetDepClosure\n"
+	              "\tcontain every transitive dependency followed by the asset "
+	              "itself, so a\n"
+	              "\twhole request can be issued as one batch.  Each row lists "
+	              "dependencies\n"
+	              "\tbefore their dependents, & kgtAssetDepRank is the position "
+	              "of each asset\n"
+	              "\tin that order across the whole graph. */\n");
+	appendUnsignedTable(result, "static constexpr unsigned kgtAssetDepOffsets[]",
+	                    graph.depOffsets);
+	appendUnsignedTable(result, "static constexpr unsigned kgtAssetDeps[]",
+	                    graph.deps);
+	appendUnsignedTable(result,
+	                    "static constexpr unsigned kgtAssetDepClosureOffsets[]",
+	                    graph.closureOffsets);
+	appendUnsignedTable(result, "static constexpr unsigned kgtAssetDepClosure[]",
+	                    graph.closure);
+	appendUnsignedTable(result, "static constexpr unsigned kgtAssetDepRank[]",
+	                    graph.rank);
+	result.append(
+		"struct KgtAssetDepRange\n"
+		"{\n"
+		"\tconst unsigned* first;\n"
+		"\tconst unsigned* last;\n"
+		"\tconstexpr const unsigned* begin() const { return first; }\n"
+		"\tconstexpr const unsigned* end()   const { return last; }\n"
+		"\tconstexpr unsigned size() const\n"
+		"\t\t{ return static_cast<unsigned>(last - first); }\n"
+		"};\n"
+		"/** @return the KgtAssetIndex values `asset` directly depends on */\n"
+		"static constexpr KgtAssetDepRange kgtAssetDepsOf(KgtAssetIndex asset)\n"
+		"{\n"
+		"\treturn { kgtAssetDeps + kgtAssetDepOffsets[static_cast<unsigned>(asset)]\n"
+		"\t       , kgtAssetDeps + kgtAssetDepOffsets[static_cast<unsigned>(asset) + 1]};\n"
+		"}\n"
+		"/** @return `asset` & everything it transitively depends on, "
+		"dependencies\n"
+		" *          first */\n"
+		"static constexpr KgtAssetDepRange kgtAssetDepClosureOf(KgtAssetIndex asset)\n"
+		"{\n"
+		"\treturn { kgtAssetDepClosure + \n"
+		"\t           kgtAssetDepClosureOffsets[static_cast<unsigned>(asset)]\n"
+		"\t       , kgtAssetDepClosure + \n"
+		"\t           kgtAssetDepClosureOffsets[static_cast<unsigned>(asset) + 1]};\n"
+		"}\n");
+	return result;
+}
@@ -0,0 +1,385 @@
+// Flipbook metadata compilation.  Included by `main.cpp`. //
+/* A `.fbm` file describes an animation whose frames are cells of a sprite
+ * sheet.  Each line is a `key: value` (or `key = value`) pair:
+ *	frame-size-x: 32         width of each frame in pixels (required)
+ *	frame-size-y: 32         height of each frame in pixels (required)
+ *	frame-count: 8           defaults to every cell of the sheet
+ *	frames-per-second: 12    (required unless frame-milliseconds is given)
+ *	frame-milliseconds: 100 100 250 ...   the duration of each frame
+ *	repeat: loop             loop, once or ping-pong (true/false also work)
+ *	texture: walk.png        the sheet, relative to the `.fbm`; defaults to
+ *	                         the PNG with the same name as the `.fbm`
+ * Frames are taken from the sheet left to right, then top to bottom.  Empty
+ * lines & lines beginning with '#' are ignored.  `--flipbooks` compiles every
+ * `.fbm` asset into constexpr tables, so games never parse text or look up
+ * the sheet by name when loading an animation. */
+enum class KFlipbookRepeat : uint8_t
+{
+	LOOP,
+	ONCE,
+	PING_PONG
+};
+struct KFlipbookFrame
+{
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+	float seconds;
+};
+struct KFlipbook
+{
+	/** KgtAssetIndex of the sprite sheet */
+	size_t sheet;
+	size_t firstFrame;
+	size_t frameCount;
+	float seconds;
+	KFlipbookRepeat repeat;
+};
+/** Read the dimensions out of a PNG's header without decoding it. */
+static bool readPngDimensions(const fs::path& pngPath,
+                              uint32_t& o_width, uint32_t& o_height)
+{
+	FILE*const file = openFile(pngPath, "rb");
+	if(!file)
+		return false;
+	uint8_t header[24];
+	const bool headerRead = fread(header, 1, sizeof(header), file) == 24;
+	fclose(file);
+	if(!headerRead || memcmp(header + 12, "IHDR", 4) != 0)
+		return false;
+	o_width  = pngRead32(header + 16);
+	o_height = pngRead32(header + 20);
+	return true;
+}
+/** Split a `key: value` (or `key = value`) line of a metadata file.
+ * @return false if the line has no separator */
+static bool splitMetadataLine(const string& line, string& o_key,
+                              string& o_value)
+{
+	const size_t separator = line.find_first_of(":=");
+	if(separator == string::npos)
+		return false;
+	o_key   = line.substr(0, separator);
+	o_value = line.substr(separator + 1);
+	rtrim(o_key);
+	ltrim(o_value);
+	return true;
+}
+/** @param texture the flipbook's `texture` value, which may be empty
+ * @return the file name of a flipbook's sprite sheet */
+static string flipbookSheetFileName(const string& fbmFileName,
+                                    const string& texture)
+{
+	if(texture.empty())
+		return fbmFileName.substr(0, fbmFileName.size() - 4) + ".png";
+	const size_t slash = fbmFileName.rfind('/');
+	return slash == string::npos ? texture
+		: fbmFileName.substr(0, slash + 1) + texture;
+}
+static bool parseFlipbookUnsigned(const string& value, uint32_t& o_result)
+{
+	uint64_t result = 0;
+	for(char c : value)
+	{
+		if(!isNumeric(c))
+			return false;
+		result = 10*result + static_cast<uint64_t>(c - '0');
+		if(result > UINT32_MAX)
+			return false;
+	}
+	o_result = static_cast<uint32_t>(result);
+	return !value.empty();
+}
+/** @return false if the `.fbm` file is malformed, or its sheet is not a PNG
+ *          asset */
+static bool compileFlipbook(const fs::path& assetPath, size_t fbmAsset,
+                            const vector<KAsset>& assets,
+                            const std::unordered_map<string, size_t>& assetOfFileName,
+                            KFlipbook& o_flipbook,
+                            vector<KFlipbookFrame>& io_frames)
+{
+	const KAsset& asset = assets[fbmAsset];
+	const fs::path fbmPath = assetFilePath(assetPath, asset);
+	const uintmax_t fileSize = fs::file_size(fbmPath);
+	char*const fileFlipbook = readEntireFile(fbmPath.c_str(), fileSize);
+	if(!fileFlipbook)
+		return false;
+	istringstream iss(fileFlipbook);
+	free(fileFlipbook);
+	uint32_t frameSizeX = 0;
+	uint32_t frameSizeY = 0;
+	uint32_t frameCount = 0;
+	uint32_t framesPerSecond = 0;
+	vector<uint32_t> frameMilliseconds;
+	string sheetFileName = flipbookSheetFileName(asset.fileName, "");
+	o_flipbook.repeat = KFlipbookRepeat::LOOP;
+	string line;
+	for(size_t lineNumber = 1; std::getline(iss, line); lineNumber++)
+	{
+		ltrim(line);
+		rtrim(line);
+		if(line.empty() || line[0] == '#')
+			continue;
+		string key;
+		string value;
+		bool valid = true;
+		if(!splitMetadataLine(line, key, value))
+			valid = false;
+		else if(key == "frame-size-x")
+			valid = parseFlipbookUnsigned(value, frameSizeX) && frameSizeX > 0;
+		else if(key == "frame-size-y")
+			valid = parseFlipbookUnsigned(value, frameSizeY) && frameSizeY > 0;
+		else if(key == "frame-count")
+			valid = parseFlipbookUnsigned(value, frameCount) && frameCount > 0;
+		else if(key == "frames-per-second")
+			valid = parseFlipbookUnsigned(value, framesPerSecond) &&
+				framesPerSecond > 0;
+		else if(key == "frame-milliseconds")
+		{
+			istringstream issValue(value);
+			string milliseconds;
+			frameMilliseconds.clear();
+			while(valid && issValue >> milliseconds)
+			{
+				frameMilliseconds.push_back(0);
+				valid = parseFlipbookUnsigned(milliseconds,
+				                              frameMilliseconds.back());
+			}
+			valid = valid && !frameMilliseconds.empty();
+		}
+		else if(key == "repeat")
+		{
+			if(value == "loop" || value == "true")
+				o_flipbook.repeat = KFlipbookRepeat::LOOP;
+			else if(value == "once" || value == "false")
+				o_flipbook.repeat = KFlipbookRepeat::ONCE;
+			else if(value == "ping-pong")
+				o_flipbook.repeat = KFlipbookRepeat::PING_PONG;
+			else
+				valid = false;
+		}
+		else if(key == "texture" && !value.empty())
+			sheetFileName = flipbookSheetFileName(asset.fileName, value);
+		else
+			valid = false;
+		if(!valid)
+		{
+			fprintf(g_stderr, "Malformed line %zu in flipbook '%s': '%s'\n",
+			        lineNumber, asset.fileName.c_str(), line.c_str());
+			return false;
+		}
+	}
+	if(frameSizeX == 0 || frameSizeY == 0 ||
+		(framesPerSecond == 0 && frameMilliseconds.empty()))
+	{
+		fprintf(g_stderr, "Flipbook '%s' requires frame-size-x, frame-size-y & "
+		        "either frames-per-second or frame-milliseconds!\n",
+		        asset.fileName.c_str());
+		return false;
+	}
+	auto itSheet = assetOfFileName.find(sheetFileName);
+	if(itSheet == assetOfFileName.end() ||
+		assets[itSheet->second].type != KAssetType::PNG)
+	{
+		fprintf(g_stderr, "Flipbook '%s' refers to '%s', which is not a PNG "
+		        "asset!\n", asset.fileName.c_str(), sheetFileName.c_str());
+		return false;
+	}
+	o_flipbook.sheet = itSheet->second;
+	uint32_t sheetWidth  = 0;
+	uint32_t sheetHeight = 0;
+	if(!readPngDimensions(assetFilePath(assetPath, assets[o_flipbook.sheet]),
+	                      sheetWidth, sheetHeight))
+	{
+		fprintf(g_stderr, "Failed to read the dimensions of '%s'!\n",
+		        sheetFileName.c_str());
+		return false;
+	}
+	const uint64_t columns = sheetWidth  / frameSizeX;
+	const uint64_t cells   = columns*(sheetHeight / frameSizeY);
+	if(frameCount == 0)
+		frameCount = static_cast<uint32_t>(
+			frameMilliseconds.empty() ? cells : frameMilliseconds.size());
+	if(frameCount == 0 || frameCount > cells)
+	{
+		fprintf(g_stderr, "Flipbook '%s' has %u frames, but its %ux%u sheet "
+		        "only fits %ju frames of %ux%u!\n", asset.fileName.c_str(),
+		        frameCount, sheetWidth, sheetHeight,
+		        static_cast<uintmax_t>(cells), frameSizeX, frameSizeY);
+		return false;
+	}
+	if(!frameMilliseconds.empty() && frameMilliseconds.size() != frameCount)
+	{
+		fprintf(g_stderr, "Flipbook '%s' has %u frames, but %zu frame "
+		        "durations!\n", asset.fileName.c_str(), frameCount,
+		        frameMilliseconds.size());
+		return false;
+	}
+	o_flipbook.firstFrame = io_frames.size();
+	o_flipbook.frameCount = frameCount;
+	o_flipbook.seconds    = 0;
+	for(uint32_t f = 0; f < frameCount; f++)
+	{
+		KFlipbookFrame frame;
+		frame.x       = static_cast<uint32_t>(f % columns)*frameSizeX;
+		frame.y       = static_cast<uint32_t>(f / columns)*frameSizeY;
+		frame.width   = frameSizeX;
+		frame.height  = frameSizeY;
+		frame.seconds = frameMilliseconds.empty()
+			? 1.f / static_cast<float>(framesPerSecond)
+			: static_cast<float>(frameMilliseconds[f]) / 1000.f;
+		o_flipbook.seconds += frame.seconds;
+		io_frames.push_back(frame);
+	}
+	return true;
+}
+/** Compile every `.fbm` asset.  `o_flipbooks` receives one entry per asset;
+ * assets which are not flipbooks have a `frameCount` of 0.
+ * @return false if any flipbook failed to compile */
+static bool compileFlipbooks(const fs::path& assetPath,
+                             const vector<KAsset>& assets,
+                             vector<KFlipbook>& o_flipbooks,
+                             vector<KFlipbookFrame>& o_frames)
+{
+	o_flipbooks.assign(assets.size(), KFlipbook{assets.size(), 0, 0, 0,
+	                                            KFlipbookRepeat::LOOP});
+	o_frames.clear();
+	std::unordered_map<string, size_t> assetOfFileName;
+	for(size_t a = 0; a < assets.size(); a++)
+		if(!assets[a].tombstone)
+			assetOfFileName[assets[a].fileName] = a;
+	bool success = true;
+	size_t flipbookCount = 0;
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		if(assets[a].tombstone || assets[a].type != KAssetType::FLIPBOOK_META)
+			continue;
+		if(!compileFlipbook(assetPath, a, assets, assetOfFileName,
+		                    o_flipbooks[a], o_frames))
+		{
+			success = false;
+			continue;
+		}
+		flipbookCount++;
+	}
+	if(g_verbose)
+		fprintf(g_stdout, "Compiled %zu flipbooks (%zu frames).\n",
+		        flipbookCount, o_frames.size());
+	return success;
+}
+static void appendFloatLiteral(stringstream& ss, float value)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.9g", static_cast<double>(value));
+	ss << buffer;
+	if(!strpbrk(buffer, ".e"))
+		ss << ".";
+	ss << "f";
+}
+static string generateFlipbookTables(const vector<KFlipbook>& flipbooks,
+                                     const vector<KFlipbookFrame>& frames)
+{
+	static const char* REPEAT_NAMES[] = {"LOOP", "ONCE", "PING_PONG"};
+	string result;
+	result.append("/* Flipbooks compiled from `.fbm` assets.  Frame rectangles "
+	              "are in pixels of the\n"
+	              "\tsprite sheet.  `kgtAssetFlipbooks` has an entry for every "
+	              "KgtAssetIndex;\n"
+	              "\tthose of assets which are not flipbooks have a "
+	              "`frameCount` of 0. */\n");
+	result.append("enum class KgtFlipbookRepeat : unsigned char\n");
+	result.append("\t{ LOOP\n\t, ONCE\n\t, PING_PONG\n};\n");
+	result.append("struct KgtFlipbookFrame\n");
+	result.append("{\n");
+	result.append("\tunsigned x;\n");
+	result.append("\tunsigned y;\n");
+	result.append("\tunsigned width;\n");
+	result.append("\tunsigned height;\n");
+	result.append("\tfloat seconds;\n");
+	result.append("};\n");
+	result.append("struct KgtFlipbook\n");
+	result.append("{\n");
+	result.append("\tKgtAssetIndex sheet;\n");
+	result.append("\t/* index into kgtFlipbookFrames */\n");
+	result.append("\tunsigned firstFrame;\n");
+	result.append("\tunsigned frameCount;\n");
+	result.append("\t/* the duration of one pass through every frame */\n");
+	result.append("\tfloat seconds;\n");
+	result.append("\tKgtFlipbookRepeat repeat;\n");
+	result.append("};\n");
+	result.append("static constexpr KgtFlipbookFrame kgtFlipbookFrames[] = \n");
+	for(size_t f = 0; f < frames.size(); f++)
+	{
+		const KFlipbookFrame& frame = frames[f];
+		stringstream ss;
+		ss << (f == 0 ? "\t{ {" : "\t, {") << frame.x << ", " << frame.y << ", "
+		   << frame.width << ", " << frame.height << ", ";
+		appendFloatLiteral(ss, frame.seconds);
+		ss << "}\n";
+		result.append(ss.str());
+	}
+	if(frames.empty())
+		result.append("{{0, 0, 0, 0, 0.f}};\n");
+	else
+		result.append("};\n");
+	result.append("static constexpr KgtFlipbook kgtAssetFlipbooks[] = \n");
+	for(size_t a = 0; a < flipbooks.size(); a++)
+	{
+		const KFlipbook& flipbook = flipbooks[a];
+		stringstream ss;
+		ss << (a == 0 ? "\t{ {" : "\t, {")
+		   << "static_cast<KgtAssetIndex>(" << flipbook.sheet << "), "
+		   << flipbook.firstFrame << ", " << flipbook.frameCount << ", ";
+		appendFloatLiteral(ss, flipbook.seconds);
+		ss << ", KgtFlipbookRepeat::"
+		   << REPEAT_NAMES[static_cast<size_t>(flipbook.repeat)] << "}\n";
+		result.append(ss.str());
+	}
+	if(flipbooks.empty())
+		result.append("{{KgtAssetIndex::ENUM_SIZE, 0, 0, 0.f, "
+		              "KgtFlipbookRepeat::LOOP}};\n");
+	else
+		result.append("};\n");
+	result.append(
+		"/** @return the index into kgtFlipbookFrames which is showing `seconds` "
+		"after\n"
+		" *          `flipbook` started playing */\n"
+		"static constexpr unsigned kgtFlipbookFrameAt(const KgtFlipbook& flipbook,\n"
+		"                                             float seconds)\n"
+		"{\n"
+		"\tif(flipbook.frameCount == 0)\n"
+		"\t\treturn flipbook.firstFrame;\n"
+		"\tconst unsigned lastFrame = flipbook.frameCount - 1;\n"
+		"\tbool reverse = false;\n"
+		"\tif(seconds < 0)\n"
+		"\t\tseconds = 0;\n"
+		"\tif(flipbook.repeat == KgtFlipbookRepeat::ONCE)\n"
+		"\t{\n"
+		"\t\tif(seconds >= flipbook.seconds)\n"
+		"\t\t\treturn flipbook.firstFrame + lastFrame;\n"
+		"\t}\n"
+		"\telse if(flipbook.seconds > 0)\n"
+		"\t{\n"
+		"\t\tconst float period = flipbook.repeat == KgtFlipbookRepeat::LOOP\n"
+		"\t\t\t? flipbook.seconds : 2*flipbook.seconds;\n"
+		"\t\tseconds -= period*static_cast<float>(\n"
+		"\t\t\tstatic_cast<unsigned long long>(seconds / period));\n"
+		"\t\tif(seconds >= flipbook.seconds)\n"
+		"\t\t{\n"
+		"\t\t\treverse = true;\n"
+		"\t\t\tseconds -= flipbook.seconds;\n"
+		"\t\t}\n"
+		"\t}\n"
+		"\tunsigned frame = 0;\n"
+		"\tfor(; frame < lastFrame; frame++)\n"
+		"\t{\n"
+		"\t\tconst unsigned f = reverse ? lastFrame - frame : frame;\n"
+		"\t\tseconds -= kgtFlipbookFrames[flipbook.firstFrame + f].seconds;\n"
+		"\t\tif(seconds < 0)\n"
+		"\t\t\tbreak;\n"
+		"\t}\n"
+		"\treturn flipbook.firstFrame + (reverse ? lastFrame - frame : frame);\n"
+		"}\n");
+	return result;
+}
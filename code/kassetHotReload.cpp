@@ -0,0 +1,301 @@
+// Hot-reload companion module generation.  Included by `main.cpp`. //
+static const char* GEN_ASSET_HOT_RELOAD_FILE_NAME = "gen_kgtAssetHotReload.h";
+static const char GEN_ASSET_HOT_RELOAD_RUNTIME[] = R"KASSET(
+#include <atomic>
+#include <thread>
+#include <cstring>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string>
+#endif
+/** Watches the directories of all assets for modifications, & queues up the
+ * KgtAssetIndex of each modified asset.  The queue is a lock-free single-
+ * producer/single-consumer ring: a background thread produces, and the game
+ * drains it (typically once per frame).  Each asset is queued at most once
+ * until it is drained, so the queue can never overflow.
+ * This object is large; give it static storage or allocate it. */
+struct KgtAssetHotReload
+{
+	int fdInotify;
+	int fdWakeup[2];
+	unsigned watchCount;
+	/** (watch descriptor, directory index) pairs, sorted by watch descriptor */
+	int watches[KGT_ASSET_HOT_RELOAD_DIR_COUNT][2];
+	std::thread thread;
+	std::atomic<unsigned> queueHead;
+	std::atomic<unsigned> queueTail;
+	unsigned queue[KGT_ASSET_HOT_RELOAD_QUEUE_SIZE];
+	std::atomic<bool> queued[KGT_ASSET_COUNT > 0 ? KGT_ASSET_COUNT : 1];
+};
+static inline void kgtAssetHotReloadPush(KgtAssetHotReload* hr,
+                                         unsigned asset)
+{
+	if(hr->queued[asset].exchange(true, std::memory_order_acq_rel))
+		return;
+	const unsigned head = hr->queueHead.load(std::memory_order_relaxed);
+	hr->queue[head & (KGT_ASSET_HOT_RELOAD_QUEUE_SIZE - 1)] = asset;
+	hr->queueHead.store(head + 1, std::memory_order_release);
+}
+/** @return the KgtAssetIndex of `fileName` within directory `dir`, or
+ *          KGT_ASSET_COUNT if it isn't an asset */
+static inline unsigned kgtAssetHotReloadFind(unsigned dir,
+                                             const char* fileName)
+{
+	unsigned lo = kgtAssetHotReloadDirs[dir].firstFile;
+	unsigned hi = lo + kgtAssetHotReloadDirs[dir].fileCount;
+	while(lo < hi)
+	{
+		const unsigned mid = lo + (hi - lo)/2;
+		const int cmp = strcmp(kgtAssetHotReloadFiles[mid].name, fileName);
+		if(cmp == 0)
+			return kgtAssetHotReloadFiles[mid].asset;
+		if(cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return KGT_ASSET_COUNT;
+}
+#if defined(__linux__)
+static inline int kgtAssetHotReloadFindDir(const KgtAssetHotReload* hr,
+                                           int wd)
+{
+	unsigned lo = 0;
+	unsigned hi = hr->watchCount;
+	while(lo < hi)
+	{
+		const unsigned mid = lo + (hi - lo)/2;
+		if(hr->watches[mid][0] == wd)
+			return hr->watches[mid][1];
+		if(hr->watches[mid][0] < wd)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return -1;
+}
+static inline void kgtAssetHotReloadRun(KgtAssetHotReload* hr)
+{
+	alignas(inotify_event) char buffer[16*1024];
+	pollfd fds[2] = {{hr->fdInotify, POLLIN, 0}, {hr->fdWakeup[0], POLLIN, 0}};
+	for(;;)
+	{
+		if(poll(fds, 2, -1) < 0)
+			continue;
+		if(fds[1].revents)
+			return;
+		const ssize_t bytesRead = read(hr->fdInotify, buffer, sizeof(buffer));
+		for(ssize_t b = 0; b < bytesRead; )
+		{
+			const inotify_event* event =
+				reinterpret_cast<const inotify_event*>(buffer + b);
+			b += sizeof(inotify_event) + event->len;
+			if(event->mask & IN_Q_OVERFLOW)
+			// the kernel dropped events, so we must assume the worst //
+			{
+				for(unsigned a = 0; a < KGT_ASSET_COUNT; a++)
+					kgtAssetHotReloadPush(hr, a);
+				continue;
+			}
+			if(event->len == 0)
+				continue;
+			const int dir = kgtAssetHotReloadFindDir(hr, event->wd);
+			if(dir < 0)
+				continue;
+			const unsigned asset = kgtAssetHotReloadFind(dir, event->name);
+			if(asset < KGT_ASSET_COUNT)
+				kgtAssetHotReloadPush(hr, asset);
+		}
+	}
+}
+#endif// defined(__linux__)
+/** Register a watch on every asset directory & begin queueing changes.
+ * @param assetRootPath the same asset directory that was given to kasset
+ * @return false if hot-reloading is unavailable */
+static inline bool kgtAssetHotReloadStart(KgtAssetHotReload* hr,
+                                          const char* assetRootPath)
+{
+	hr->queueHead.store(0);
+	hr->queueTail.store(0);
+	for(unsigned a = 0; a < KGT_ASSET_COUNT; a++)
+		hr->queued[a].store(false);
+#if defined(__linux__)
+	hr->fdInotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(hr->fdInotify < 0)
+		return false;
+	if(pipe2(hr->fdWakeup, O_CLOEXEC) != 0)
+	{
+		close(hr->fdInotify);
+		return false;
+	}
+	hr->watchCount = 0;
+	std::string path;
+	for(unsigned d = 0; d < KGT_ASSET_HOT_RELOAD_DIR_COUNT; d++)
+	{
+		path.assign(assetRootPath);
+		if(kgtAssetHotReloadDirs[d].path[0])
+			path.append("/").append(kgtAssetHotReloadDirs[d].path);
+		const int wd = inotify_add_watch(hr->fdInotify, path.c_str(),
+		                                 IN_CLOSE_WRITE | IN_MOVED_TO);
+		if(wd < 0)
+			continue;
+		// keep `watches` sorted; directories that share an inode share a
+		//	watch descriptor, and the first one registered wins //
+		unsigned w = hr->watchCount;
+		while(w > 0 && hr->watches[w - 1][0] > wd)
+			w--;
+		if(w > 0 && hr->watches[w - 1][0] == wd)
+			continue;
+		memmove(hr->watches[w + 1], hr->watches[w],
+		        (hr->watchCount - w)*sizeof(hr->watches[0]));
+		hr->watches[w][0] = wd;
+		hr->watches[w][1] = static_cast<int>(d);
+		hr->watchCount++;
+	}
+	hr->thread = std::thread(kgtAssetHotReloadRun, hr);
+	return true;
+#else
+	(void)assetRootPath;
+	return false;
+#endif// defined(__linux__)
+}
+static inline void kgtAssetHotReloadStop(KgtAssetHotReload* hr)
+{
+#if defined(__linux__)
+	if(!hr->thread.joinable())
+		return;
+	const char wakeup = 0;
+	while(write(hr->fdWakeup[1], &wakeup, 1) < 0) {}
+	hr->thread.join();
+	close(hr->fdWakeup[0]);
+	close(hr->fdWakeup[1]);
+	close(hr->fdInotify);
+#else
+	(void)hr;
+#endif// defined(__linux__)
+}
+/** Pop the next modified asset off the queue.  Must only be called from one
+ * thread at a time.
+ * @return false if no more assets have been modified */
+static inline bool kgtAssetHotReloadPop(KgtAssetHotReload* hr,
+                                        KgtAssetIndex* o_asset)
+{
+	const unsigned tail = hr->queueTail.load(std::memory_order_relaxed);
+	if(tail == hr->queueHead.load(std::memory_order_acquire))
+		return false;
+	const unsigned asset =
+		hr->queue[tail & (KGT_ASSET_HOT_RELOAD_QUEUE_SIZE - 1)];
+	hr->queueTail.store(tail + 1, std::memory_order_release);
+	// clear the flag only after the asset is dequeued, so that any further
+	//	modifications queue the asset again //
+	hr->queued[asset].store(false, std::memory_order_release);
+	*o_asset = static_cast<KgtAssetIndex>(asset);
+	return true;
+}
+/** Call `fn(KgtAssetIndex)` for each asset modified since the last drain. */
+template<class Fn>
+static inline void kgtAssetHotReloadDrain(KgtAssetHotReload* hr, Fn fn)
+{
+	KgtAssetIndex asset;
+	while(kgtAssetHotReloadPop(hr, &asset))
+		fn(asset);
+}
+)KASSET";
+/** @return the hot-reload companion module for `assets`, which contains a
+ *          table mapping each asset directory & file name to its
+ *          KgtAssetIndex, plus the runtime notifier itself */
+static string generateHotReloadModule(const vector<KAsset>& assets)
+{
+	struct DirFile
+	{
+		string dir;
+		string name;
+		size_t asset;
+	};
+	vector<DirFile> dirFiles;
+	dirFiles.reserve(assets.size());
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		if(assets[a].tombstone)
+			continue;
+		string fileName = assets[a].fileName;
+		std::replace(fileName.begin(), fileName.end(), '\\', '/');
+		const size_t slash = fileName.rfind('/');
+		if(slash == string::npos)
+			dirFiles.push_back({string(), fileName, a});
+		else
+			dirFiles.push_back({fileName.substr(0, slash),
+			                    fileName.substr(slash + 1), a});
+	}
+	std::sort(dirFiles.begin(), dirFiles.end(),
+		[](const DirFile& lhs, const DirFile& rhs)
+		{
+			if(lhs.dir != rhs.dir)
+				return lhs.dir < rhs.dir;
+			return lhs.name < rhs.name;
+		});
+	size_t dirCount = 0;
+	for(size_t f = 0; f < dirFiles.size(); f++)
+		if(f == 0 || dirFiles[f].dir != dirFiles[f - 1].dir)
+			dirCount++;
+	// the ring buffer never needs to hold more than one entry per asset //
+	size_t queueSize = 1;
+	while(queueSize < assets.size())
+		queueSize *= 2;
+	string result;
+	result.append("#pragma once\n");
+	result.append("/* Runtime asset hot-reload notifier generated by kasset. */\n");
+	result.append("#include \"gen_kgtAssets.h\"\n");
+	stringstream ss;
+	ss << "static const unsigned KGT_ASSET_HOT_RELOAD_DIR_COUNT = "
+	   << std::max<size_t>(dirCount, 1) << ";\n";
+	ss << "static const unsigned KGT_ASSET_HOT_RELOAD_QUEUE_SIZE = "
+	   << queueSize << ";\n";
+	result.append(ss.str());
+	result.append("struct KgtAssetHotReloadDir\n");
+	result.append("{\n");
+	result.append("\t/* relative to the asset directory */\n");
+	result.append("\tconst char* path;\n");
+	result.append("\tunsigned firstFile;\n");
+	result.append("\tunsigned fileCount;\n");
+	result.append("};\n");
+	result.append("struct KgtAssetHotReloadFile\n");
+	result.append("{\n");
+	result.append("\tconst char* name;\n");
+	result.append("\tunsigned asset;\n");
+	result.append("};\n");
+	result.append("static const KgtAssetHotReloadDir kgtAssetHotReloadDirs[] = \n");
+	for(size_t f = 0, d = 0; f < dirFiles.size(); )
+	{
+		size_t fEnd = f + 1;
+		while(fEnd < dirFiles.size() && dirFiles[fEnd].dir == dirFiles[f].dir)
+			fEnd++;
+		stringstream ssDir;
+		ssDir << (d++ == 0 ? "\t{ {\"" : "\t, {\"") << dirFiles[f].dir << "\", "
+		      << f << ", " << fEnd - f << "}\n";
+		result.append(ssDir.str());
+		f = fEnd;
+	}
+	if(dirFiles.empty())
+		result.append("{{\"\", 0, 0}};\n");
+	else
+		result.append("};\n");
+	result.append("/* sorted by name within each directory */\n");
+	result.append("static const KgtAssetHotReloadFile kgtAssetHotReloadFiles[] = \n");
+	for(size_t f = 0; f < dirFiles.size(); f++)
+	{
+		stringstream ssFile;
+		ssFile << (f == 0 ? "\t{ {\"" : "\t, {\"") << dirFiles[f].name << "\", "
+		       << dirFiles[f].asset << "}\n";
+		result.append(ssFile.str());
+	}
+	if(dirFiles.empty())
+		result.append("{{\"\", 0}};\n");
+	else
+		result.append("};\n");
+	result.append(GEN_ASSET_HOT_RELOAD_RUNTIME);
+	return result;
+}
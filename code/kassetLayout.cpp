@@ -0,0 +1,281 @@
+// Layouts of the generated asset index.  Included by `main.cpp`. //
+/* Every translation unit which includes `gen_kgtAssets.h` parses the
+ * KgtAssetIndex enum & the asset file names, so for large asset trees the
+ * layout of these dominates the cost of kasset to the rest of the build.
+ * `--layout` selects one of:
+ *	monolithic  everything in the header (the default)
+ *	split       the file name table is defined once in `gen_kgtAssets.cpp`,
+ *	            which must be compiled into the program; the header only
+ *	            declares it
+ *	blob        the file names are a few large string literals indexed by an
+ *	            offset table, instead of an array of pointers which each need
+ *	            a relocation
+ *	module      the enum & file names are exported by the C++20 module
+ *	            `kgtAssets` (`gen_kgtAssets.cppm`), which the header imports
+ * In every layout `kgtAssetFileName` is the way to get an asset's file name;
+ * only the monolithic, split & module layouts define `kgtAssetFileNames[]`.
+ * `kasset --bench` measures the cost of each layout to consumers; see
+ * kassetBench.cpp. */
+static const char* GEN_ASSET_SOURCE_FILE_NAME = "gen_kgtAssets.cpp";
+static const char* GEN_ASSET_MODULE_FILE_NAME = "gen_kgtAssets.cppm";
+/* MSVC limits a string literal to 64KiB after concatenation, so the blob is
+ * split into chunks of at most this many bytes; a name never straddles two
+ * chunks. */
+static const size_t KASSET_FILE_NAME_BLOB_CHUNK_BITS = 15;
+static const char*const KASSET_HEADER_LAYOUT_NAMES[] =
+	{"monolithic", "split", "blob", "module"};
+/** @return false if `name` is not a layout */
+static bool parseHeaderLayout(const char* name, KAssetHeaderLayout& o_layout)
+{
+	for(size_t l = 0; l < std::size(KASSET_HEADER_LAYOUT_NAMES); l++)
+		if(strcmp(name, KASSET_HEADER_LAYOUT_NAMES[l]) == 0)
+		{
+			o_layout = static_cast<KAssetHeaderLayout>(l);
+			return true;
+		}
+	return false;
+}
+/** @return the file which accompanies the header in `layout`, or nullptr */
+static const char* headerLayoutSourceFileName(KAssetHeaderLayout layout)
+{
+	switch(layout)
+	{
+		case KAssetHeaderLayout::SPLIT:  return GEN_ASSET_SOURCE_FILE_NAME;
+		case KAssetHeaderLayout::MODULE: return GEN_ASSET_MODULE_FILE_NAME;
+		default:                         return nullptr;
+	}
+}
+/** @return the # of assets which aren't tombstones */
+static size_t appendAssetIndexEnum(string& result, const vector<KAsset>& assets,
+                                   const char* declarationPrefix)
+{
+	result.append(declarationPrefix);
+	result.append("enum class KgtAssetIndex : unsigned\n");
+	size_t liveAssetCount = 0;
+	for(size_t afn = 0; afn < assets.size(); afn++)
+	{
+		if(assets[afn].tombstone)
+			continue;
+		appendAssetEnumEntry(result, assets[afn].fileName, afn,
+		                     liveAssetCount++ == 0);
+	}
+	result.append(liveAssetCount == 0
+		? "\t{ ENUM_SIZE"
+		: "\t, ENUM_SIZE");
+	// trailing tombstones must still be counted //
+	if(!assets.empty() && assets.back().tombstone)
+	{
+		stringstream ss;
+		ss << " = " << assets.size();
+		result.append(ss.str());
+	}
+	result.append("\n};\n");
+	return liveAssetCount;
+}
+static void appendAssetFileNameTable(string& result,
+                                     const vector<KAsset>& assets,
+                                     const char* declaration)
+{
+	result.append(declaration);
+	result.append(" = \n");
+	for(size_t afn = 0; afn < assets.size(); afn++)
+	{
+		if(assets[afn].tombstone)
+		{
+			result.append(afn == 0
+				? "\t{ nullptr\n"
+				: "\t, nullptr\n");
+			continue;
+		}
+		appendAssetFileNameEntry(result, assets[afn].fileName, afn == 0);
+	}
+	if(assets.empty())
+		result.append("{\"NO_KASSETS_FOUND\"};\n");
+	else
+		result.append("};\n");
+}
+static void appendAssetFileNameBlob(string& result,
+                                    const vector<KAsset>& assets)
+{
+	const size_t chunkCapacity = size_t(1) << KASSET_FILE_NAME_BLOB_CHUNK_BITS;
+	vector<size_t> offsets(assets.size(), SIZE_MAX);
+	string chunks;
+	size_t chunkCount = 0;
+	size_t chunkSize  = chunkCapacity;
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		if(assets[a].tombstone)
+			continue;
+		const size_t nameSize = assets[a].fileName.size() + 1;
+		if(chunkSize + nameSize > chunkCapacity)
+		{
+			stringstream ssChunk;
+			ssChunk << (chunkCount == 0 ? "\t{ " : "\t, ") << "/* chunk "
+			        << chunkCount << " */\n";
+			chunks.append(ssChunk.str());
+			chunkCount++;
+			chunkSize = 0;
+		}
+		offsets[a] = (chunkCount - 1) << KASSET_FILE_NAME_BLOB_CHUNK_BITS |
+			chunkSize;
+		chunkSize += nameSize;
+		// each name is its own literal, so a name starting with a digit can't
+		//	extend the previous "\0" escape //
+		string entry;
+		appendAssetFileNameEntry(entry, assets[a].fileName, true);
+		entry.insert(entry.size() - 2, "\\0");
+		chunks.append("\t\t");
+		chunks.append(entry, 3, string::npos);
+	}
+	result.append("/* Asset file names, each followed by a null terminator, in "
+	              "chunks of up to\n");
+	stringstream ss;
+	ss << "\t" << chunkCapacity << " bytes.  Each offset is the chunk index << "
+	   << KASSET_FILE_NAME_BLOB_CHUNK_BITS
+	   << " | the position within that\n"
+	      "\tchunk, or ~0u for a removed asset. */\n";
+	result.append(ss.str());
+	result.append("static constexpr const char* kgtAssetFileNameBlob[] = \n");
+	if(chunkCount == 0)
+		result.append("{\"NO_KASSETS_FOUND\"};\n");
+	else
+	{
+		result.append(chunks);
+		result.append("};\n");
+	}
+	result.append("static constexpr unsigned kgtAssetFileNameOffsets[] = \n");
+	for(size_t a = 0; a < offsets.size(); a++)
+	{
+		stringstream ssOffset;
+		ssOffset << (a == 0 ? "\t{ " : "\t, ");
+		if(offsets[a] == SIZE_MAX)
+			ssOffset << "~0u\n";
+		else
+			ssOffset << offsets[a] << "\n";
+		result.append(ssOffset.str());
+	}
+	if(offsets.empty())
+		result.append("{0};\n");
+	else
+		result.append("};\n");
+	ss.str("");
+	ss << "static constexpr const char* kgtAssetFileName(KgtAssetIndex asset)\n"
+	      "{\n"
+	      "\tconst unsigned offset = "
+	      "kgtAssetFileNameOffsets[static_cast<unsigned>(asset)];\n"
+	      "\tif(offset == ~0u)\n"
+	      "\t\treturn nullptr;\n"
+	      "\treturn kgtAssetFileNameBlob[offset >> "
+	   << KASSET_FILE_NAME_BLOB_CHUNK_BITS << "] + \n"
+	      "\t       (offset & "
+	   << (chunkCapacity - 1) << "u);\n"
+	      "}\n";
+	result.append(ss.str());
+}
+/** Generate the asset index (KgtAssetIndex, KGT_ASSET_COUNT &
+ * `kgtAssetFileName`) in the chosen layout.  Every other table of the header
+ * is appended to the result.
+ * @param o_source receives the contents of `headerLayoutSourceFileName`
+ * @return the beginning of the header */
+static string generateAssetIndex(const vector<KAsset>& assets,
+                                 const KassetOptions& options,
+                                 string& o_source, size_t& o_liveAssetCount)
+{
+	string result;
+	result.append("#pragma once\n");
+	o_source.clear();
+	switch(options.headerLayout)
+	{
+		case KAssetHeaderLayout::MONOLITHIC:
+		case KAssetHeaderLayout::BLOB:
+		{
+			o_liveAssetCount = appendAssetIndexEnum(result, assets, "");
+			result.append("static const unsigned KGT_ASSET_COUNT = \n");
+			result.append("\tstatic_cast<unsigned>(KgtAssetIndex::ENUM_SIZE);\n");
+			if(options.headerLayout == KAssetHeaderLayout::BLOB)
+			{
+				appendAssetFileNameBlob(result, assets);
+				break;
+			}
+			if(options.pathLookup)
+			{
+				appendAssetFileNameTable(result, assets,
+					"static constexpr const char* kgtAssetFileNames[]");
+				result.append("static constexpr ");
+			}
+			else
+			{
+				appendAssetFileNameTable(result, assets,
+					"static const char* kgtAssetFileNames[]");
+				result.append("static inline ");
+			}
+			result.append("const char* kgtAssetFileName(KgtAssetIndex asset)\n"
+			              "{\n"
+			              "\treturn kgtAssetFileNames[static_cast<unsigned>(asset)];\n"
+			              "}\n");
+		}break;
+		case KAssetHeaderLayout::SPLIT:
+		{
+			o_liveAssetCount = appendAssetIndexEnum(result, assets, "");
+			result.append("static const unsigned KGT_ASSET_COUNT = \n");
+			result.append("\tstatic_cast<unsigned>(KgtAssetIndex::ENUM_SIZE);\n");
+			result.append("/* defined in `gen_kgtAssets.cpp` */\n");
+			result.append("extern const char*const kgtAssetFileNames[];\n");
+			result.append("static inline const char* kgtAssetFileName("
+			              "KgtAssetIndex asset)\n"
+			              "{\n"
+			              "\treturn kgtAssetFileNames[static_cast<unsigned>(asset)];\n"
+			              "}\n");
+			o_source.append("#include \"gen_kgtAssets.h\"\n");
+			appendAssetFileNameTable(o_source, assets,
+			                         "const char*const kgtAssetFileNames[]");
+		}break;
+		case KAssetHeaderLayout::MODULE:
+		{
+			o_source.append("export module kgtAssets;\n");
+			o_liveAssetCount = appendAssetIndexEnum(o_source, assets, "export ");
+			o_source.append("export inline constexpr unsigned KGT_ASSET_COUNT = \n");
+			o_source.append(
+				"\tstatic_cast<unsigned>(KgtAssetIndex::ENUM_SIZE);\n");
+			appendAssetFileNameTable(o_source, assets,
+				"export inline constexpr const char* kgtAssetFileNames[]");
+			o_source.append("export constexpr const char* kgtAssetFileName("
+			                "KgtAssetIndex asset)\n"
+			                "{\n"
+			                "\treturn kgtAssetFileNames[static_cast<unsigned>(asset)];\n"
+			                "}\n");
+			result.append("import kgtAssets;\n");
+		}break;
+	}
+	return result;
+}
+/** Write the generated header, along with the source file of its layout.
+ * The source files of the other layouts are removed, so that one left behind
+ * by an earlier run with another `--layout` can't be built by mistake. */
+static bool writeKAssetsHeader(const fs::path& outputPath,
+                               KAssetHeaderLayout layout,
+                               const string& header, const string& source)
+{
+	const fs::path headerPath = outputPath / GEN_ASSET_HEADER_FILE_NAME;
+	if(!writeEntireFile(headerPath.c_str(), header.c_str(), false))
+		return false;
+	const char*const sourceFileName = headerLayoutSourceFileName(layout);
+	for(size_t l = 0; l < std::size(KASSET_HEADER_LAYOUT_NAMES); l++)
+	{
+		const char*const otherFileName = 
+			headerLayoutSourceFileName(static_cast<KAssetHeaderLayout>(l));
+		if(!otherFileName || otherFileName == sourceFileName)
+			continue;
+		std::error_code errorCode;
+		fs::remove(outputPath / otherFileName, errorCode);
+		if(errorCode)
+		{
+			fprintf(g_stderr, "Failed to remove '%s'!\n", otherFileName);
+			return false;
+		}
+	}
+	if(!sourceFileName)
+		return true;
+	const fs::path sourcePath = outputPath / sourceFileName;
+	return writeEntireFile(sourcePath.c_str(), source.c_str(), false);
+}
@@ -0,0 +1,146 @@
+// Stable KgtAssetIndex allocation via an index lock file.  Included by
+//	`main.cpp`. //
+/* The lock file is a plain text file meant to be committed alongside the
+ * assets.  Each line is either:
+ *	`<index> <asset file name>`  an asset which owns KgtAssetIndex `index`
+ *	`<index>`                    a tombstone left behind by a removed asset
+ * Empty lines & lines beginning with '#' are ignored. */
+static const wchar_t* ASSET_LOCK_FILE_NAME = L"assets.lock";
+/** @param o_slots receives the asset file name locked to each KgtAssetIndex,
+ *                 or an empty string for each tombstone
+ * @return false if the lock file is malformed */
+static bool readAssetLock(const fs::path& lockPath, vector<string>& o_slots)
+{
+	o_slots.clear();
+	const uintmax_t fileSize = fs::file_size(lockPath);
+	char*const fileAssetLock = readEntireFile(lockPath.c_str(), fileSize);
+	if(!fileAssetLock)
+		return false;
+	// writeAssetLock writes a line for every slot, so no index can exceed
+	//	the # of lines; this keeps a damaged line from allocating an 
+	//	enormous # of slots //
+	const size_t lineCount = 
+		std::count(fileAssetLock, fileAssetLock + strlen(fileAssetLock), '\n')
+		+ 1;
+	istringstream iss(fileAssetLock);
+	free(fileAssetLock);
+	vector<bool> indexLocked;
+	string line;
+	for(size_t lineNumber = 1; std::getline(iss, line); lineNumber++)
+	{
+		rtrim(line);
+		if(line.empty() || line[0] == '#')
+			continue;
+		size_t index = 0;
+		size_t c = 0;
+		// stop accumulating once the index is out of range, so that long
+		//	digit strings can't wrap around into range //
+		for(; c < line.size() && isNumeric(line[c]); c++)
+			if(index < lineCount)
+				index = 10*index + (line[c] - '0');
+		if(c == 0 || (c < line.size() && line[c] != ' ') ||
+			index >= lineCount)
+		{
+			fprintf(g_stderr, "Malformed line %zu in asset lock file: '%s'\n",
+			        lineNumber, line.c_str());
+			return false;
+		}
+		if(index >= o_slots.size())
+		{
+			o_slots.resize(index + 1);
+			indexLocked.resize(index + 1, false);
+		}
+		if(indexLocked[index])
+		{
+			fprintf(g_stderr, "Asset index %zu is locked more than once!\n",
+			        index);
+			return false;
+		}
+		indexLocked[index] = true;
+		if(c < line.size())
+			o_slots[index] = line.substr(c + 1);
+	}
+	return true;
+}
+static bool writeAssetLock(const fs::path& lockPath,
+                           const vector<KAsset>& assets)
+{
+	string result;
+	result.append("# Generated by kasset; commit this file to keep each asset's\n");
+	result.append("#\tKgtAssetIndex stable.  Lines without a file name are\n");
+	result.append("#\ttombstones of removed assets (see `--lock-compact`).\n");
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		stringstream ss;
+		ss << a;
+		if(!assets[a].tombstone)
+			ss << " " << assets[a].fileName;
+		ss << "\n";
+		result.append(ss.str());
+	}
+	// avoid touching the lock file if nothing changed, so that build systems
+	//	don't consider it to be dirty //
+	if(fs::exists(lockPath))
+	{
+		const uintmax_t fileSize = fs::file_size(lockPath);
+		char*const fileAssetLock = readEntireFile(lockPath.c_str(), fileSize);
+		const bool unchanged = fileAssetLock && result == fileAssetLock;
+		free(fileAssetLock);
+		if(unchanged)
+			return true;
+	}
+	return writeEntireFile(lockPath.c_str(), result.c_str(), false);
+}
+/** Rearrange `assets` such that each asset is located at the KgtAssetIndex it
+ * was locked to in `slots`.  Assets which were removed since the last run
+ * leave behind tombstones, and new assets are appended after the last slot.
+ * If `compact` is set, all tombstones are removed & the remaining assets are
+ * renumbered without changing their relative order. */
+static void applyAssetLock(const vector<string>& slots, bool compact,
+                           vector<KAsset>& assets)
+{
+	std::unordered_map<string, size_t> slotOfFileName;
+	for(size_t s = 0; s < slots.size(); s++)
+		if(!slots[s].empty())
+			slotOfFileName[slots[s]] = s;
+	vector<KAsset> lockedAssets(slots.size());
+	for(KAsset& lockedAsset : lockedAssets)
+		lockedAsset.tombstone = true;
+	size_t newAssetCount = 0;
+	for(KAsset& asset : assets)
+	{
+		auto itSlot = slotOfFileName.find(asset.fileName);
+		if(itSlot == slotOfFileName.end())
+		{
+			if(g_verbose)
+				fprintf(g_stdout, "Appending new asset '%s' to the lock...\n",
+				        asset.fileName.c_str());
+			lockedAssets.push_back(std::move(asset));
+			newAssetCount++;
+		}
+		else
+			lockedAssets[itSlot->second] = std::move(asset);
+	}
+	size_t tombstoneCount = 0;
+	for(const KAsset& lockedAsset : lockedAssets)
+		if(lockedAsset.tombstone)
+			tombstoneCount++;
+	if(compact)
+	{
+		lockedAssets.erase(
+			std::remove_if(lockedAssets.begin(), lockedAssets.end(),
+				[](const KAsset& asset) { return asset.tombstone; }),
+			lockedAssets.end());
+		if(tombstoneCount > 0 || g_verbose)
+			fprintf(g_stdout, "Compacted %zu tombstones out of the asset "
+			        "lock.\n", tombstoneCount);
+	}
+	else if(tombstoneCount > lockedAssets.size()/4)
+		fprintf(g_stdout, "WARNING: %zu of %zu asset indices are tombstones; "
+		        "consider running with `--lock-compact`.\n", tombstoneCount,
+		        lockedAssets.size());
+	if(g_verbose)
+		fprintf(g_stdout, "Asset lock: %zu new assets, %zu tombstones.\n",
+		        newAssetCount, compact ? size_t(0) : tombstoneCount);
+	assets.swap(lockedAssets);
+}
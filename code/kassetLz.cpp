@@ -0,0 +1,118 @@
+// LZ4 block format compressor.  Included by `main.cpp`. //
+/* Each compressed block is a sequence of:
+ *	u8   token            (hi nibble: literal length, lo nibble: match length-4)
+ *	u8[] literal length   (only if the hi nibble is 15: sum of bytes until !255)
+ *	u8[] literals
+ *	u16  match offset     (little-endian; absent in the final sequence)
+ *	u8[] match length     (only if the lo nibble is 15: as for literal length)
+ * The last 5 bytes of a block are always literals, and the final match must
+ * begin at least 12 bytes before the end of the block, so that decoders are
+ * free to copy in wide words. */
+static const int LZ_HASH_BITS = 16;
+static const size_t LZ_HASH_TABLE_SIZE = size_t(1) << LZ_HASH_BITS;
+static const size_t LZ_MIN_MATCH = 4;
+static const size_t LZ_LAST_LITERALS = 5;
+static const size_t LZ_MATCH_FIND_LIMIT = 12;
+static const size_t LZ_MAX_OFFSET = 65535;
+static inline uint32_t lzRead32(const uint8_t* p)
+{
+	uint32_t result;
+	memcpy(&result, p, sizeof(result));
+	return result;
+}
+static inline uint32_t lzHash(uint32_t sequence)
+{
+	return (sequence * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+static inline uint8_t* lzWriteLength(uint8_t* op, size_t length)
+{
+	for(; length >= 255; length -= 255)
+		*op++ = 255;
+	*op++ = static_cast<uint8_t>(length);
+	return op;
+}
+/** @return false if the sequence does not fit in the remaining output */
+static bool lzEmitSequence(uint8_t*& op, const uint8_t* opEnd,
+                           const uint8_t* literals, size_t literalLength,
+                           size_t matchOffset, size_t matchLength)
+{
+	const bool hasMatch = matchLength > 0;
+	const size_t worstCaseSize = 1 + literalLength/255 + 1 + literalLength +
+		(hasMatch ? 2 + matchLength/255 + 1 : 0);
+	if(static_cast<size_t>(opEnd - op) < worstCaseSize)
+		return false;
+	uint8_t*const token = op++;
+	*token = static_cast<uint8_t>(std::min<size_t>(literalLength, 15) << 4);
+	if(literalLength >= 15)
+		op = lzWriteLength(op, literalLength - 15);
+	memcpy(op, literals, literalLength);
+	op += literalLength;
+	if(!hasMatch)
+		return true;
+	*op++ = static_cast<uint8_t>(matchOffset);
+	*op++ = static_cast<uint8_t>(matchOffset >> 8);
+	const size_t matchLengthCode = matchLength - LZ_MIN_MATCH;
+	*token |= static_cast<uint8_t>(std::min<size_t>(matchLengthCode, 15));
+	if(matchLengthCode >= 15)
+		op = lzWriteLength(op, matchLengthCode - 15);
+	return true;
+}
+/** Greedy single-probe compressor; trades some ratio for speed in the same
+ * way as LZ4's default mode.  `hashTable` must have `LZ_HASH_TABLE_SIZE`
+ * elements & can be reused between calls.
+ * @return the compressed size, or 0 if the output would not fit inside of
+ *         `dstCapacity` bytes */
+static size_t lzCompress(const uint8_t* src, size_t srcSize,
+                         uint8_t* dst, size_t dstCapacity,
+                         uint32_t* hashTable)
+{
+	const uint8_t*const srcEnd = src + srcSize;
+	const uint8_t* ip     = src;
+	const uint8_t* anchor = src;
+	uint8_t* op = dst;
+	const uint8_t*const opEnd = dst + dstCapacity;
+	if(srcSize > LZ_MATCH_FIND_LIMIT)
+	{
+		const uint8_t*const matchFindLimit = srcEnd - LZ_MATCH_FIND_LIMIT;
+		const uint8_t*const matchLimit     = srcEnd - LZ_LAST_LITERALS;
+		memset(hashTable, 0, LZ_HASH_TABLE_SIZE*sizeof(hashTable[0]));
+		while(ip < matchFindLimit)
+		{
+			const uint32_t sequence = lzRead32(ip);
+			const uint32_t h = lzHash(sequence);
+			const uint8_t* ref = src + hashTable[h];
+			hashTable[h] = static_cast<uint32_t>(ip - src);
+			if(ref >= ip || static_cast<size_t>(ip - ref) > LZ_MAX_OFFSET ||
+				lzRead32(ref) != sequence)
+			{
+				// skip faster through data that is not compressing //
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+			while(ip > anchor && ref > src && ip[-1] == ref[-1])
+			{
+				ip--;
+				ref--;
+			}
+			size_t matchLength = LZ_MIN_MATCH;
+			while(ip + matchLength < matchLimit &&
+				ip[matchLength] == ref[matchLength])
+			{
+				matchLength++;
+			}
+			if(!lzEmitSequence(op, opEnd, anchor, ip - anchor, ip - ref,
+			                   matchLength))
+			{
+				return 0;
+			}
+			ip    += matchLength;
+			anchor = ip;
+			if(ip < matchFindLimit)
+				hashTable[lzHash(lzRead32(ip - 2))] =
+					static_cast<uint32_t>(ip - 2 - src);
+		}
+	}
+	if(!lzEmitSequence(op, opEnd, anchor, srcEnd - anchor, 0, 0))
+		return 0;
+	return op - dst;
+}
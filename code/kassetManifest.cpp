@@ -0,0 +1,375 @@
+// Binary asset manifest (.kam) generation.  Included by `main.cpp`. //
+/* Manifest file layout (all integers are little-endian, and every section
+ * begins at an offset aligned to 8 bytes):
+ *	header:
+ *		char magic[4] = "KAM1"
+ *		u32  version
+ *		u32  assetCount
+ *		u32  flags            (reserved)
+ *		u64  sizesOffset
+ *		u64  hashesOffset
+ *		u64  nameOffsetsOffset
+ *		u64  typesOffset
+ *		u64  namesOffset
+ *		u64  namesSize
+ *	u64 sizes[assetCount]
+ *	u64 hashes[assetCount]  (content hashes)
+ *	u32 nameOffsets[assetCount]  (relative to `namesOffset`)
+ *	u8  types[assetCount]   (KAssetType)
+ *	names: null-terminated asset file names, '/' separated */
+static const char* GEN_ASSET_MANIFEST_FILE_NAME = "gen_kgtAssets.kam";
+static const char* GEN_ASSET_MANIFEST_READER_FILE_NAME = "kgtAssetManifest.h";
+static const char KASSET_MANIFEST_MAGIC[4] = {'K', 'A', 'M', '1'};
+static const uint32_t KASSET_MANIFEST_VERSION = 1;
+static const uint64_t KASSET_MANIFEST_HEADER_SIZE = 64;
+static const uint64_t KASSET_MANIFEST_ALIGNMENT = 8;
+static const size_t KASSET_MANIFEST_STREAM_BUFFER_SIZE = 64*1024;
+/** Writes a manifest one asset at a time in bounded memory.  Each section is
+ * buffered separately & flushed to its own region of the file, so the # of
+ * assets & the total size of their names must be known up front. */
+struct KAssetManifestWriter
+{
+	FILE* file;
+	fs::path path;
+	uint64_t assetCount;
+	uint64_t namesSize;
+	uint64_t assetsWritten;
+	uint64_t namesWritten;
+	enum Section { SIZES, HASHES, NAME_OFFSETS, TYPES, NAMES, SECTION_COUNT };
+	/** file offset at which each section's buffer will be flushed */
+	uint64_t sectionOffsets[SECTION_COUNT];
+	vector<uint8_t> sectionBuffers[SECTION_COUNT];
+};
+static bool manifestWriterFlush(KAssetManifestWriter& writer, 
+                                size_t section)
+{
+	vector<uint8_t>& buffer = writer.sectionBuffers[section];
+	if(buffer.empty())
+		return true;
+	if(!seekFile(writer.file, writer.sectionOffsets[section]) ||
+		fwrite(buffer.data(), 1, buffer.size(), writer.file) != buffer.size())
+	{
+		return false;
+	}
+	writer.sectionOffsets[section] += buffer.size();
+	buffer.clear();
+	return true;
+}
+static bool manifestWriterBegin(KAssetManifestWriter& writer, 
+                                const fs::path& manifestPath, 
+                                uint64_t assetCount, uint64_t namesSize)
+{
+	writer = {};
+	writer.path       = manifestPath;
+	writer.assetCount = assetCount;
+	writer.namesSize  = namesSize;
+	if(namesSize > UINT32_MAX)
+	{
+		fprintf(g_stderr, "Asset names are too large for a manifest!\n");
+		return false;
+	}
+	const uint64_t count = assetCount;
+	const uint64_t sizesOffset = KASSET_MANIFEST_HEADER_SIZE;
+	const uint64_t hashesOffset = sizesOffset + 8*count;
+	const uint64_t nameOffsetsOffset = hashesOffset + 8*count;
+	const uint64_t typesOffset = alignUp(nameOffsetsOffset + 4*count, 
+	                                     KASSET_MANIFEST_ALIGNMENT);
+	const uint64_t namesOffset = alignUp(typesOffset + count, 
+	                                     KASSET_MANIFEST_ALIGNMENT);
+	writer.sectionOffsets[KAssetManifestWriter::SIZES]        = sizesOffset;
+	writer.sectionOffsets[KAssetManifestWriter::HASHES]       = hashesOffset;
+	writer.sectionOffsets[KAssetManifestWriter::NAME_OFFSETS] = 
+		nameOffsetsOffset;
+	writer.sectionOffsets[KAssetManifestWriter::TYPES]        = typesOffset;
+	writer.sectionOffsets[KAssetManifestWriter::NAMES]        = namesOffset;
+	vector<uint8_t> header;
+	header.insert(header.end(), KASSET_MANIFEST_MAGIC, KASSET_MANIFEST_MAGIC + 4);
+	appendLe32(header, KASSET_MANIFEST_VERSION);
+	appendLe32(header, static_cast<uint32_t>(count));
+	appendLe32(header, 0);
+	appendLe64(header, sizesOffset);
+	appendLe64(header, hashesOffset);
+	appendLe64(header, nameOffsetsOffset);
+	appendLe64(header, typesOffset);
+	appendLe64(header, namesOffset);
+	appendLe64(header, namesSize);
+	assert(header.size() == KASSET_MANIFEST_HEADER_SIZE);
+	writer.file = openFile(manifestPath, "wb");
+	if(!writer.file || 
+		fwrite(header.data(), 1, header.size(), writer.file) != header.size())
+	{
+		fprintf(g_stderr, "Failed to write '%s'!\n", 
+		        (char*)manifestPath.u8string().c_str());
+		if(writer.file)
+			fclose(writer.file);
+		writer.file = nullptr;
+		return false;
+	}
+	return true;
+}
+static bool manifestWriterAppend(KAssetManifestWriter& writer, 
+                                 const KAsset& asset)
+{
+	assert(writer.assetsWritten < writer.assetCount);
+	vector<uint8_t>*const buffers = writer.sectionBuffers;
+	appendLe64(buffers[KAssetManifestWriter::SIZES], asset.fileSize);
+	appendLe64(buffers[KAssetManifestWriter::HASHES], asset.contentHash);
+	appendLe32(buffers[KAssetManifestWriter::NAME_OFFSETS], 
+	           static_cast<uint32_t>(writer.namesWritten));
+	buffers[KAssetManifestWriter::TYPES].push_back(
+		static_cast<uint8_t>(asset.type));
+	vector<uint8_t>& names = buffers[KAssetManifestWriter::NAMES];
+	for(char c : asset.fileName)
+		names.push_back(c == '\\' ? '/' : static_cast<uint8_t>(c));
+	names.push_back('\0');
+	writer.namesWritten += asset.fileName.size() + 1;
+	writer.assetsWritten++;
+	for(size_t s = 0; s < KAssetManifestWriter::SECTION_COUNT; s++)
+		if(buffers[s].size() >= KASSET_MANIFEST_STREAM_BUFFER_SIZE &&
+			!manifestWriterFlush(writer, s))
+		{
+			fprintf(g_stderr, "Failed to write '%s'!\n", 
+			        (char*)writer.path.u8string().c_str());
+			return false;
+		}
+	return true;
+}
+/** Flush all sections & close the manifest.  Always closes the file. */
+static bool manifestWriterEnd(KAssetManifestWriter& writer)
+{
+	assert(writer.assetsWritten == writer.assetCount);
+	assert(writer.namesWritten == writer.namesSize);
+	bool success = true;
+	for(size_t s = 0; s < KAssetManifestWriter::SECTION_COUNT; s++)
+		if(!manifestWriterFlush(writer, s))
+			success = false;
+	// pad the sections which precede the names out to their alignment //
+	const uint8_t zeroes[KASSET_MANIFEST_ALIGNMENT] = {};
+	for(size_t s : {KAssetManifestWriter::NAME_OFFSETS, 
+	                KAssetManifestWriter::TYPES})
+	{
+		const uint64_t offset = writer.sectionOffsets[s];
+		const size_t padding = static_cast<size_t>(
+			alignUp(offset, KASSET_MANIFEST_ALIGNMENT) - offset);
+		if(padding > 0 && (!seekFile(writer.file, offset) || 
+			fwrite(zeroes, 1, padding, writer.file) != padding))
+		{
+			success = false;
+		}
+	}
+	if(fclose(writer.file) != 0)
+		success = false;
+	writer.file = nullptr;
+	if(!success)
+		fprintf(g_stderr, "Failed to write '%s'!\n", 
+		        (char*)writer.path.u8string().c_str());
+	return success;
+}
+static bool writeAssetManifest(const fs::path& manifestPath, 
+                               const vector<KAsset>& assets)
+{
+	uint64_t namesSize = 0;
+	for(const KAsset& asset : assets)
+		namesSize += asset.fileName.size() + 1;
+	KAssetManifestWriter writer;
+	if(!manifestWriterBegin(writer, manifestPath, assets.size(), namesSize))
+		return false;
+	for(const KAsset& asset : assets)
+		if(!manifestWriterAppend(writer, asset))
+		{
+			fclose(writer.file);
+			return false;
+		}
+	return manifestWriterEnd(writer);
+}
+static const char GEN_ASSET_MANIFEST_READER[] = R"KASSET(#pragma once
+/* Header-only reader for binary asset manifests (.kam) generated by kasset.
+ * The manifest is memory-mapped & accessed in place; opening it performs no
+ * parsing or allocation beyond validating the header.  Assumes a
+ * little-endian host. */
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#define KGT_ASSET_MANIFEST_VERSION 1
+enum class KgtAssetManifestType : unsigned char
+{
+	UNKNOWN,
+	PNG,
+	WAV,
+	OGG,
+	FLIPBOOK_META,
+	MATERIAL
+};
+struct KgtAssetManifestHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t assetCount;
+	uint32_t flags;
+	uint64_t sizesOffset;
+	uint64_t hashesOffset;
+	uint64_t nameOffsetsOffset;
+	uint64_t typesOffset;
+	uint64_t namesOffset;
+	uint64_t namesSize;
+};
+static_assert(sizeof(KgtAssetManifestHeader) == 64);
+struct KgtAssetManifest
+{
+	const unsigned char* data;
+	size_t dataSize;
+	const KgtAssetManifestHeader* header;
+	const uint64_t* sizes;
+	const uint64_t* hashes;
+	const uint32_t* nameOffsets;
+	const unsigned char* types;
+	const char* names;
+#if defined(_WIN32)
+	HANDLE hFile;
+	HANDLE hMapping;
+#endif
+};
+static inline bool kgtAssetManifestSectionValid(
+	const KgtAssetManifest* manifest, uint64_t offset, uint64_t size)
+{
+	return offset <= manifest->dataSize &&
+		size <= manifest->dataSize - offset && offset % 8 == 0;
+}
+static inline void kgtAssetManifestClose(KgtAssetManifest* manifest)
+{
+#if defined(_WIN32)
+	if(manifest->data)
+		UnmapViewOfFile(manifest->data);
+	if(manifest->hMapping)
+		CloseHandle(manifest->hMapping);
+	if(manifest->hFile && manifest->hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(manifest->hFile);
+#else
+	if(manifest->data)
+		munmap(const_cast<unsigned char*>(manifest->data), manifest->dataSize);
+#endif
+	memset(manifest, 0, sizeof(*manifest));
+}
+/** Map a manifest into memory.  The manifest remains valid until it is passed
+ * to `kgtAssetManifestClose`.
+ * @return false if the file can't be mapped or isn't a valid manifest */
+static inline bool kgtAssetManifestOpen(KgtAssetManifest* manifest,
+                                        const char* path)
+{
+	memset(manifest, 0, sizeof(*manifest));
+#if defined(_WIN32)
+	manifest->hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+	                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LARGE_INTEGER fileSize;
+	if(manifest->hFile == INVALID_HANDLE_VALUE ||
+		!GetFileSizeEx(manifest->hFile, &fileSize) || fileSize.QuadPart == 0)
+	{
+		kgtAssetManifestClose(manifest);
+		return false;
+	}
+	manifest->dataSize = static_cast<size_t>(fileSize.QuadPart);
+	manifest->hMapping = CreateFileMappingA(manifest->hFile, nullptr,
+	                                        PAGE_READONLY, 0, 0, nullptr);
+	if(manifest->hMapping)
+		manifest->data = static_cast<const unsigned char*>(
+			MapViewOfFile(manifest->hMapping, FILE_MAP_READ, 0, 0, 0));
+	if(!manifest->data)
+	{
+		kgtAssetManifestClose(manifest);
+		return false;
+	}
+#else
+	const int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if(fd < 0)
+		return false;
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0)
+	{
+		close(fd);
+		return false;
+	}
+	void*const data = mmap(nullptr, static_cast<size_t>(fileStat.st_size),
+	                       PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED)
+		return false;
+	manifest->data     = static_cast<const unsigned char*>(data);
+	manifest->dataSize = static_cast<size_t>(fileStat.st_size);
+#endif
+	const KgtAssetManifestHeader*const header =
+		reinterpret_cast<const KgtAssetManifestHeader*>(manifest->data);
+	if(manifest->dataSize < sizeof(KgtAssetManifestHeader))
+	{
+		kgtAssetManifestClose(manifest);
+		return false;
+	}
+	const uint64_t count = header->assetCount;
+	if(memcmp(header->magic, "KAM1", 4) != 0 ||
+		header->version != KGT_ASSET_MANIFEST_VERSION ||
+		!kgtAssetManifestSectionValid(manifest, header->sizesOffset, 8*count) ||
+		!kgtAssetManifestSectionValid(manifest, header->hashesOffset, 8*count) ||
+		!kgtAssetManifestSectionValid(manifest, header->nameOffsetsOffset,
+		                              4*count) ||
+		!kgtAssetManifestSectionValid(manifest, header->typesOffset, count) ||
+		!kgtAssetManifestSectionValid(manifest, header->namesOffset,
+		                              header->namesSize) ||
+		(count > 0 && (header->namesSize == 0 ||
+			manifest->data[header->namesOffset + header->namesSize - 1] != '\0')))
+	{
+		kgtAssetManifestClose(manifest);
+		return false;
+	}
+	manifest->header = header;
+	manifest->sizes = reinterpret_cast<const uint64_t*>(
+		manifest->data + header->sizesOffset);
+	manifest->hashes = reinterpret_cast<const uint64_t*>(
+		manifest->data + header->hashesOffset);
+	manifest->nameOffsets = reinterpret_cast<const uint32_t*>(
+		manifest->data + header->nameOffsetsOffset);
+	manifest->types = manifest->data + header->typesOffset;
+	manifest->names = reinterpret_cast<const char*>(
+		manifest->data + header->namesOffset);
+	return true;
+}
+static inline unsigned kgtAssetManifestCount(
+	const KgtAssetManifest* manifest)
+{
+	return manifest->header->assetCount;
+}
+/** @return the asset's file name relative to the asset directory, or nullptr
+ *          if the manifest is corrupt */
+static inline const char* kgtAssetManifestName(
+	const KgtAssetManifest* manifest, unsigned asset)
+{
+	const uint32_t nameOffset = manifest->nameOffsets[asset];
+	if(nameOffset >= manifest->header->namesSize)
+		return nullptr;
+	return manifest->names + nameOffset;
+}
+static inline uint64_t kgtAssetManifestSize(
+	const KgtAssetManifest* manifest, unsigned asset)
+{
+	return manifest->sizes[asset];
+}
+static inline uint64_t kgtAssetManifestHash(
+	const KgtAssetManifest* manifest, unsigned asset)
+{
+	return manifest->hashes[asset];
+}
+static inline KgtAssetManifestType kgtAssetManifestTypeOf(
+	const KgtAssetManifest* manifest, unsigned asset)
+{
+	return static_cast<KgtAssetManifestType>(manifest->types[asset]);
+}
+)KASSET";
@@ -0,0 +1,920 @@
+// Asset pack file generation.  Included by `main.cpp`. //
+/* Pack file layout (all integers are little-endian):
+ *	header:
+ *		char magic[4] = "KPAK"
+ *		u32  version
+ *		u32  entryCount
+ *		u32  alignment        (of each asset's data offset)
+ *		u64  tocOffset
+ *		u32  chunkSize        (uncompressed size of each compressed chunk)
+ *		u32  chunkCount
+ *		u64  chunkTableOffset
+ *		u64  reserved
+ *	data:
+ *		stored contents of each unique asset; duplicate assets alias the data
+ *		of their canonical asset instead of storing another copy.  Assets are
+ *		stored in KgtAssetIndex order, unless they were laid out from a trace:
+ *		then each layout group is stored contiguously & starts on a new page.
+ *		Processed assets (such as decoded textures) store the processed data
+ *		in place of the asset file's contents
+ *	table of contents, one entry per asset in the pack in KgtAssetIndex order
+ *	(every KgtAssetIndex, unless the pack belongs to a bundle):
+ *		u64  offset
+ *		u64  storedSize
+ *		u64  size
+ *		u64  contentHash
+ *		u32  firstChunk
+ *		u32  chunkCount       (0 if the asset is stored uncompressed)
+ *	chunk table, one entry per chunk:
+ *		u64  offset
+ *		u32  storedSize       (| KASSET_PACK_CHUNK_RAW if stored uncompressed)
+ *		u32  reserved
+ * Compressed assets are split into chunks of `chunkSize` bytes which are each
+ * compressed independently, so any chunk can be decoded on its own. */
+static const char* GEN_ASSET_PACK_FILE_NAME = "gen_kgtAssets.pack";
+static const char* GEN_ASSET_PACK_RUNTIME_FILE_NAME = "gen_kgtAssetPack.h";
+static const char KASSET_PACK_MAGIC[4] = {'K', 'P', 'A', 'K'};
+static const uint32_t KASSET_PACK_VERSION = 2;
+static const uint64_t KASSET_PACK_HEADER_SIZE = 48;
+static const uint64_t KASSET_PACK_ALIGNMENT = 16;
+static const uint64_t KASSET_PACK_PAGE_ALIGNMENT = 4096;
+static const uint32_t KASSET_PACK_CHUNK_SIZE = 64*1024;
+static const uint32_t KASSET_PACK_CHUNK_RAW = 0x80000000u;
+struct KAssetPackChunk
+{
+	uint64_t offset;
+	uint32_t storedSize;
+};
+struct KAssetPackJob
+{
+	size_t assetIndex;
+	vector<uint8_t> stored;
+	/** empty if the asset is stored uncompressed */
+	vector<uint32_t> chunkStoredSizes;
+	bool done;
+	bool success;
+};
+/** The table of contents of an existing pack file. */
+struct KAssetPackIndexEntry
+{
+	uint64_t offset;
+	uint64_t storedSize;
+	uint64_t size;
+	uint64_t contentHash;
+	uint32_t firstChunk;
+	uint32_t chunkCount;
+};
+struct KAssetPackIndex
+{
+	uint64_t fileSize;
+	uint64_t tocOffset;
+	/** of the header, table of contents & chunk table together, which
+	 * identifies a version of the pack without reading its data */
+	uint64_t hash;
+	vector<KAssetPackIndexEntry> entries;
+	vector<KAssetPackChunk> chunks;
+};
+static bool readAssetPackIndex(const fs::path& packPath,
+                               KAssetPackIndex& o_index)
+{
+	const auto packName = packPath.u8string();
+	std::error_code errorCode;
+	o_index.fileSize = fs::file_size(packPath, errorCode);
+	if(errorCode)
+	{
+		fprintf(g_stderr, "Failed to open '%s'!\n", (char*)packName.c_str());
+		return false;
+	}
+	FILE*const file = openFile(packPath, "rb");
+	if(!file)
+	{
+		fprintf(g_stderr, "Failed to open '%s'!\n", (char*)packName.c_str());
+		return false;
+	}
+	uint8_t header[KASSET_PACK_HEADER_SIZE];
+	bool success = 
+		fread(header, 1, sizeof(header), file) == sizeof(header) && 
+		memcmp(header, KASSET_PACK_MAGIC, 4) == 0 && 
+		cacheRead32(header + 4) == KASSET_PACK_VERSION;
+	const uint32_t entryCount       = success ? cacheRead32(header +  8) : 0;
+	const uint64_t tocOffset        = success ? cacheRead64(header + 16) : 0;
+	const uint32_t chunkCount       = success ? cacheRead32(header + 28) : 0;
+	const uint64_t chunkTableOffset = success ? cacheRead64(header + 32) : 0;
+	const uint64_t indexEnd = chunkTableOffset + 16*uint64_t(chunkCount);
+	success = success && tocOffset >= KASSET_PACK_HEADER_SIZE && 
+		chunkTableOffset == tocOffset + 40*uint64_t(entryCount) && 
+		indexEnd <= o_index.fileSize;
+	vector<uint8_t> buffer;
+	if(success)
+	{
+		buffer.resize(static_cast<size_t>(indexEnd - tocOffset));
+		success = seekFile(file, tocOffset) && 
+			fread(buffer.data(), 1, buffer.size(), file) == buffer.size();
+	}
+	fclose(file);
+	if(!success)
+	{
+		fprintf(g_stderr, "'%s' is not a version %u kasset pack!\n", 
+		        (char*)packName.c_str(), KASSET_PACK_VERSION);
+		return false;
+	}
+	o_index.tocOffset = tocOffset;
+	o_index.hash      = hashBytes(buffer.data(), buffer.size(), 
+	                              hashBytes(header, sizeof(header), 0));
+	o_index.entries.resize(entryCount);
+	for(uint32_t e = 0; e < entryCount; e++)
+	{
+		const uint8_t*const entryData = buffer.data() + 40*size_t(e);
+		KAssetPackIndexEntry& entry = o_index.entries[e];
+		entry.offset      = cacheRead64(entryData);
+		entry.storedSize  = cacheRead64(entryData + 8);
+		entry.size        = cacheRead64(entryData + 16);
+		entry.contentHash = cacheRead64(entryData + 24);
+		entry.firstChunk  = cacheRead32(entryData + 32);
+		entry.chunkCount  = cacheRead32(entryData + 36);
+	}
+	o_index.chunks.resize(chunkCount);
+	for(uint32_t c = 0; c < chunkCount; c++)
+	{
+		const uint8_t*const chunkData = 
+			buffer.data() + 40*size_t(entryCount) + 16*size_t(c);
+		o_index.chunks[c].offset     = cacheRead64(chunkData);
+		o_index.chunks[c].storedSize = cacheRead32(chunkData + 8);
+	}
+	return true;
+}
+/** @return whether `entry` of `index` stores exactly what `job` would */
+static bool packIndexEntryMatches(const KAssetPackIndex& index,
+                                  const KAssetPackIndexEntry& entry,
+                                  uint64_t contentHash, 
+                                  const vector<uint32_t>& chunkStoredSizes,
+                                  uint64_t storedSize)
+{
+	if(entry.contentHash != contentHash || entry.storedSize != storedSize || 
+		entry.chunkCount != chunkStoredSizes.size() || 
+		uint64_t(entry.firstChunk) + entry.chunkCount > index.chunks.size())
+	{
+		return false;
+	}
+	for(uint32_t c = 0; c < entry.chunkCount; c++)
+		if(index.chunks[entry.firstChunk + c].storedSize != 
+				chunkStoredSizes[c])
+			return false;
+	return true;
+}
+static bool writePadding(FILE* file, uint64_t byteCount)
+{
+	static const uint8_t ZEROES[64] = {};
+	while(byteCount > 0)
+	{
+		const size_t chunk =
+			static_cast<size_t>(std::min<uint64_t>(byteCount, sizeof(ZEROES)));
+		if(fwrite(ZEROES, 1, chunk, file) != chunk)
+			return false;
+		byteCount -= chunk;
+	}
+	return true;
+}
+static bool readFileRange(FILE* file, uint64_t offset, uint64_t size,
+                          uint8_t* o_data)
+{
+	return seekFile(file, offset) &&
+		fread(o_data, 1, static_cast<size_t>(size), file) == size;
+}
+/** Copy `size` bytes within `file`.  If the destination overlaps the end of
+ * the source, the bytes are copied from back to front so that the source is
+ * read before it is overwritten. */
+static bool copyWithinFile(FILE* file, uint64_t source, uint64_t destination,
+                           uint64_t size, vector<uint8_t>& buffer)
+{
+	const bool backward = destination > source && destination < source + size;
+	for(uint64_t copied = 0; copied < size;)
+	{
+		const size_t step = static_cast<size_t>(
+			std::min<uint64_t>(size - copied, buffer.size()));
+		const uint64_t at = backward ? size - copied - step : copied;
+		if(!readFileRange(file, source + at, step, buffer.data()) ||
+			!seekFile(file, destination + at) ||
+			fwrite(buffer.data(), 1, step, file) != step)
+			return false;
+		copied += step;
+	}
+	return true;
+}
+/** Split `contents` into chunks and compress each of them.  If the asset as
+ * a whole doesn't compress well, it is stored uncompressed instead. */
+static void compressAsset(const vector<uint8_t>& contents, KAssetPackJob& job,
+                          vector<uint32_t>& hashTable)
+{
+	hashTable.resize(LZ_HASH_TABLE_SIZE);
+	job.stored.resize(contents.size());
+	job.chunkStoredSizes.clear();
+	size_t storedSize = 0;
+	// Any chunk that doesn't fit in less space than the original is simply
+	//	stored raw, so the stored asset is never larger than `contents` //
+	const size_t storedSizeLimit = contents.size() - contents.size()/16;
+	for(size_t c = 0; c < contents.size(); c += KASSET_PACK_CHUNK_SIZE)
+	{
+		const size_t chunkSize =
+			std::min<size_t>(KASSET_PACK_CHUNK_SIZE, contents.size() - c);
+		size_t chunkStoredSize =
+			lzCompress(contents.data() + c, chunkSize,
+			           job.stored.data() + storedSize, chunkSize - 1,
+			           hashTable.data());
+		if(chunkStoredSize == 0)
+		{
+			memcpy(job.stored.data() + storedSize, contents.data() + c,
+			       chunkSize);
+			chunkStoredSize = chunkSize;
+			job.chunkStoredSizes.push_back(
+				static_cast<uint32_t>(chunkSize) | KASSET_PACK_CHUNK_RAW);
+		}
+		else
+			job.chunkStoredSizes.push_back(
+				static_cast<uint32_t>(chunkStoredSize));
+		storedSize += chunkStoredSize;
+		if(storedSize >= storedSizeLimit)
+			break;
+	}
+	if(storedSize >= storedSizeLimit)
+	// this asset is incompressible; don't make the runtime decode it //
+	{
+		job.stored = contents;
+		job.chunkStoredSizes.clear();
+		return;
+	}
+	job.stored.resize(storedSize);
+}
+/** Output: the u32 stored size of each chunk, followed by the stored
+ * contents.  meta[0] is the # of chunks; an asset which is stored
+ * uncompressed has no chunks & no output data. */
+static const char* processPackCompress(KAssetProcessOutput& io_input,
+                                       const KassetOptions&,
+                                       KAssetProcessOutput& o_output)
+{
+	static thread_local vector<uint32_t> hashTable;
+	KAssetPackJob job = {};
+	compressAsset(io_input.data, job, hashTable);
+	o_output.data.clear();
+	o_output.meta[0] = static_cast<uint32_t>(job.chunkStoredSizes.size());
+	if(job.chunkStoredSizes.empty())
+		return nullptr;
+	for(uint32_t chunkStoredSize : job.chunkStoredSizes)
+		appendLe32(o_output.data, chunkStoredSize);
+	o_output.data.insert(o_output.data.end(), job.stored.begin(),
+	                     job.stored.end());
+	return nullptr;
+}
+/* Compression runs as each asset is streamed into the pack, rather than
+	being scheduled with the other processors, but it is cached the same way */
+static const KAssetProcessor PACK_COMPRESS_PROCESSOR =
+	{ "lz4-chunks", 1, KAssetType::UNKNOWN, nullptr, nullptr, nullptr
+	, processPackCompress, nullptr, nullptr, nullptr};
+/** Compress `contents` through the cache. */
+static void compressAssetCached(const KassetOptions& options,
+                                KAssetCache& cache, uint64_t contentHash,
+                                vector<uint8_t>& contents, KAssetPackJob& job)
+{
+	const uint64_t key =
+		processorCacheKey(PACK_COMPRESS_PROCESSOR, options, contentHash);
+	KAssetProcessOutput compressed = {};
+	if(!cacheLoad(cache, key, compressed))
+	{
+		KAssetProcessOutput input = {};
+		input.data.swap(contents);
+		processPackCompress(input, options, compressed);
+		input.data.swap(contents);
+		cacheStore(cache, key, compressed);
+	}
+	const size_t chunkCount = compressed.meta[0];
+	job.chunkStoredSizes.resize(chunkCount);
+	if(chunkCount == 0 || compressed.data.size() < 4*chunkCount)
+	// this asset is incompressible //
+	{
+		job.chunkStoredSizes.clear();
+		job.stored.swap(contents);
+		return;
+	}
+	for(size_t c = 0; c < chunkCount; c++)
+		job.chunkStoredSizes[c] = cacheRead32(compressed.data.data() + 4*c);
+	job.stored.assign(compressed.data.begin() + 4*chunkCount,
+	                  compressed.data.end());
+}
+static void processPackJob(const fs::path& assetPath, KAsset& asset,
+                           const KassetOptions& options, KAssetCache& cache,
+                           KAssetPackJob& job, vector<uint8_t>& contents)
+{
+	job.success = readFileContents(assetPackedPath(assetPath, asset),
+	                               assetPackedSize(asset), contents);
+	if(!job.success)
+	{
+		fprintf(g_stderr, "Failed to read '%s'! (was it modified?)\n",
+		        asset.fileName.c_str());
+		return;
+	}
+	asset.packContentHash = hashContents(contents.data(), contents.size());
+	if(options.compress)
+		compressAssetCached(options, cache, asset.packContentHash, contents, 
+		                    job);
+	else
+		job.stored.swap(contents);
+}
+struct KAssetPackExtent
+{
+	uint64_t offset;
+	uint64_t size;
+};
+/** An asset of the layout group being written which could not keep its
+ * offset from the previous version of the pack, & was stored after the end
+ * of that version until the whole group has been seen. */
+struct KAssetPackPlacement
+{
+	size_t assetIndex;
+	uint64_t tempOffset;
+	uint64_t size;
+};
+/** Move each of `placements` from its temporary offset into the first space
+ * at or after `floor` which none of `pinned` occupies & which is large
+ * enough, in order.  Temporary offsets must follow the end of the previous
+ * version of the pack & be in the same order as `placements`, so that no
+ * asset ever moves up & none is overwritten before it has been moved.
+ * @param pinned the extents of the group's assets which kept their offset
+ * @param io_dataEnd the end of all of the pack's data placed so far */
+static bool placeAssetPackGroup(FILE* file, vector<KAsset>& assets,
+                                vector<KAssetPackChunk>& io_chunks,
+                                vector<KAssetPackExtent>& pinned,
+                                const vector<KAssetPackPlacement>& placements,
+                                uint64_t floor, uint64_t& io_dataEnd,
+                                vector<uint8_t>& buffer)
+{
+	std::sort(pinned.begin(), pinned.end(),
+		[](const KAssetPackExtent& lhs, const KAssetPackExtent& rhs)
+		{
+			return lhs.offset < rhs.offset;
+		});
+	// the last hole extends past the end of the pack //
+	vector<KAssetPackExtent> holes;
+	uint64_t holeStart = floor;
+	for(const KAssetPackExtent& pin : pinned)
+	{
+		if(pin.offset > holeStart)
+			holes.push_back({holeStart, pin.offset - holeStart});
+		holeStart  = std::max(holeStart, pin.offset + pin.size);
+		io_dataEnd = std::max(io_dataEnd, pin.offset + pin.size);
+	}
+	holes.push_back({holeStart, UINT64_MAX - holeStart});
+	for(const KAssetPackPlacement& placement : placements)
+	{
+		uint64_t offset = 0;
+		for(KAssetPackExtent& hole : holes)
+		{
+			offset = alignUp(hole.offset, KASSET_PACK_ALIGNMENT);
+			const uint64_t holeEnd = hole.offset + hole.size;
+			if(offset > holeEnd || holeEnd - offset < placement.size)
+				continue;
+			hole.offset = offset + placement.size;
+			hole.size   = holeEnd - hole.offset;
+			break;
+		}
+		assert(offset <= placement.tempOffset);
+		if(offset != placement.tempOffset &&
+			!copyWithinFile(file, placement.tempOffset, offset, placement.size,
+			                buffer))
+			return false;
+		KAsset& asset = assets[placement.assetIndex];
+		asset.packOffset = offset;
+		for(uint32_t c = 0; c < asset.packChunkCount; c++)
+			io_chunks[asset.packFirstChunk + c].offset -=
+				placement.tempOffset - offset;
+		io_dataEnd = std::max(io_dataEnd, offset + placement.size);
+	}
+	return true;
+}
+/** Order pack `members` by layout group, keeping them in KgtAssetIndex order
+ * within each group. */
+static void orderPackMembers(const vector<KAsset>& assets, 
+                             vector<size_t>& members)
+{
+	std::stable_sort(members.begin(), members.end(), 
+		[&assets](size_t lhs, size_t rhs)
+		{
+			return assets[lhs].layoutGroup < assets[rhs].layoutGroup;
+		});
+}
+/** Write the stored contents of the unique assets among `members` into a
+ * single pack file.  Assets are read & compressed in parallel, while the
+ * calling thread writes them out in KgtAssetIndex order.  Only a bounded
+ * window of assets is held in memory at any one time.  Requires `dedupAssets`
+ * to have been run on `assets` first.  Assigns the pack location of every
+ * member.
+ * @param members KgtAssetIndex values of the assets to pack, in the order
+ *                they are to be stored (see `orderPackMembers`)
+ * @param io_chunks the chunks of the pack are appended to this
+ * @param o_dataSize if non-null, receives the # of bytes between the end of
+ *                   the pack header & the end of the last asset's data
+ * @param base if non-null, the previous version of this pack.  Assets whose
+ *             stored contents are unchanged keep their offset from `base`, so
+ *             that a delta between the two versions (see kassetDelta.cpp)
+ *             never has to move unchanged data, & every other asset takes
+ *             the first space freed by the assets of `base` which changed or
+ *             were removed that it fits in (or goes after the rest).  Layout
+ *             groups stay in order, each starting on its own page: an asset
+ *             only keeps its offset if that follows all of the earlier
+ *             groups' data, so assets which the trace moved to another group
+ *             are placed like changed ones.  Space which nothing fits in is
+ *             left unused, & once that wastes more than a quarter of the
+ *             data a fresh pack would need, the pack is laid out from
+ *             scratch instead. */
+static bool writeAssetPack(const fs::path& assetPath, const fs::path& packPath,
+                           const KassetOptions& options, KAssetCache& cache,
+                           vector<KAsset>& assets,
+                           const vector<size_t>& members,
+                           vector<KAssetPackChunk>& io_chunks,
+                           uint64_t* o_dataSize = nullptr,
+                           const KAssetPackIndex* base = nullptr)
+{
+	// chunk indices in the generated tables span all packs, but each pack's
+	//	own table of contents indexes only its own chunks //
+	const size_t chunkBase = io_chunks.size();
+	// assets are moved within the pack once they have been written when it
+	//	is laid out over `base` //
+	FILE*const filePack = openFile(packPath, base ? "w+b" : "wb");
+	if(!filePack)
+	{
+		fprintf(g_stderr, "Failed to open '%s'!\n",
+		        (char*)packPath.u8string().c_str());
+		return false;
+	}
+	// the first member with each content is the one stored in this pack //
+	std::unordered_map<size_t, size_t> packCanonicalOf;
+	vector<KAssetPackJob> jobs;
+	for(size_t a : members)
+	{
+		if(assets[a].tombstone || 
+			!packCanonicalOf.emplace(assets[a].canonicalIndex, a).second)
+		{
+			continue;
+		}
+		jobs.emplace_back();
+		jobs.back().assetIndex = a;
+	}
+	const unsigned threadCount =
+		std::max(1u, std::thread::hardware_concurrency());
+	const size_t jobWindow = 2*threadCount;
+	std::mutex jobMutex;
+	std::condition_variable jobCondition;
+	size_t jobNext    = 0;
+	size_t jobWritten = 0;
+	bool abort = false;
+	FILE*const runStdout = g_stdout;
+	FILE*const runStderr = g_stderr;
+	auto worker = [&]()
+	{
+		g_stdout = runStdout;
+		g_stderr = runStderr;
+		vector<uint8_t> contents;
+		for(;;)
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobCondition.wait(lock, [&]()
+				{
+					return abort || jobNext >= jobs.size() ||
+						jobNext < jobWritten + jobWindow;
+				});
+			if(abort || jobNext >= jobs.size())
+				return;
+			KAssetPackJob& job = jobs[jobNext++];
+			lock.unlock();
+			processPackJob(assetPath, assets[job.assetIndex], options, cache,
+			               job, contents);
+			lock.lock();
+			job.done = true;
+			jobCondition.notify_all();
+		}
+	};
+	vector<std::thread> threads;
+	for(unsigned t = 0; t < threadCount; t++)
+		threads.emplace_back(worker);
+	bool success = writePadding(filePack, KASSET_PACK_HEADER_SIZE);
+	uint64_t cursor  = KASSET_PACK_HEADER_SIZE;
+	uint64_t dataEnd = KASSET_PACK_HEADER_SIZE;
+	// where the data would end if the pack was laid out from scratch //
+	uint64_t freshDataEnd = KASSET_PACK_HEADER_SIZE;
+	// entries of `base` by content hash, each of which may be claimed by 
+	//	only one asset //
+	std::unordered_map<uint64_t, size_t> baseEntryOf;
+	vector<KAssetPackExtent> groupPinned;
+	vector<KAssetPackPlacement> groupPlacements;
+	uint64_t groupFloor = KASSET_PACK_HEADER_SIZE;
+	vector<uint8_t> moveBuffer;
+	if(base)
+	{
+		for(size_t e = 0; e < base->entries.size(); e++)
+			baseEntryOf.emplace(base->entries[e].contentHash, e);
+		// the data of `base` which can't be kept is rewritten, so the data
+		//	taking its place has to wait until the group has been seen //
+		cursor = alignUp(base->fileSize, KASSET_PACK_PAGE_ALIGNMENT);
+		moveBuffer.resize(KASSET_PACK_CHUNK_SIZE);
+	}
+	uint64_t totalSize       = 0;
+	uint64_t totalStoredSize = 0;
+	for(KAssetPackJob& job : jobs)
+	{
+		{
+			std::unique_lock<std::mutex> lock(jobMutex);
+			jobCondition.wait(lock, [&job]() { return job.done; });
+		}
+		KAsset& asset = assets[job.assetIndex];
+		// each layout group begins on a new page, so that reading it in never
+		//	drags in the tail of the previous group //
+		const bool groupBegins = &job != &jobs.front() && 
+			asset.layoutGroup != assets[(&job - 1)->assetIndex].layoutGroup;
+		const uint64_t alignment = groupBegins 
+			? KASSET_PACK_PAGE_ALIGNMENT : KASSET_PACK_ALIGNMENT;
+		uint64_t offset = alignUp(cursor, alignment);
+		freshDataEnd = alignUp(freshDataEnd, alignment) + job.stored.size();
+		if(base && groupBegins)
+		{
+			success = success &&
+				placeAssetPackGroup(filePack, assets, io_chunks, groupPinned,
+				                    groupPlacements, groupFloor, dataEnd,
+				                    moveBuffer);
+			groupPinned.clear();
+			groupPlacements.clear();
+			groupFloor = alignUp(dataEnd, KASSET_PACK_PAGE_ALIGNMENT);
+		}
+		bool pinned = false;
+		auto itBaseEntry = baseEntryOf.find(asset.packContentHash);
+		if(job.success && itBaseEntry != baseEntryOf.end() && 
+			base->entries[itBaseEntry->second].offset >= groupFloor &&
+			packIndexEntryMatches(*base, base->entries[itBaseEntry->second], 
+			                      asset.packContentHash, job.chunkStoredSizes, 
+			                      job.stored.size()))
+		{
+			offset = base->entries[itBaseEntry->second].offset;
+			pinned = true;
+			baseEntryOf.erase(itBaseEntry);
+		}
+		if(base && pinned)
+			groupPinned.push_back({offset, job.stored.size()});
+		else if(base)
+			groupPlacements.push_back({job.assetIndex, offset, 
+			                           job.stored.size()});
+		success = success && job.success &&
+			(!base || seekFile(filePack, pinned ? offset : cursor)) &&
+			(pinned || writePadding(filePack, offset - cursor)) &&
+			fwrite(job.stored.data(), 1, job.stored.size(), filePack) ==
+				job.stored.size();
+		if(!success)
+		{
+			std::lock_guard<std::mutex> lock(jobMutex);
+			abort = true;
+			jobCondition.notify_all();
+			break;
+		}
+		asset.packOffset     = offset;
+		asset.packStoredSize = job.stored.size();
+		asset.packFirstChunk = static_cast<uint32_t>(io_chunks.size());
+		asset.packChunkCount =
+			static_cast<uint32_t>(job.chunkStoredSizes.size());
+		uint64_t chunkOffset = offset;
+		for(uint32_t chunkStoredSize : job.chunkStoredSizes)
+		{
+			io_chunks.push_back({chunkOffset, chunkStoredSize});
+			chunkOffset += chunkStoredSize & ~KASSET_PACK_CHUNK_RAW;
+		}
+		if(!pinned)
+			cursor = offset + job.stored.size();
+		if(!base)
+			dataEnd = cursor;
+		totalSize       += assetPackedSize(asset);
+		totalStoredSize += job.stored.size();
+		vector<uint8_t>().swap(job.stored);
+		vector<uint32_t>().swap(job.chunkStoredSizes);
+		std::lock_guard<std::mutex> lock(jobMutex);
+		jobWritten++;
+		jobCondition.notify_all();
+	}
+	for(std::thread& thread : threads)
+		thread.join();
+	if(base)
+	{
+		success = success &&
+			placeAssetPackGroup(filePack, assets, io_chunks, groupPinned,
+			                    groupPlacements, groupFloor, dataEnd,
+			                    moveBuffer);
+		const uint64_t freshDataSize = freshDataEnd - KASSET_PACK_HEADER_SIZE;
+		if(success && dataEnd - freshDataEnd > freshDataSize/4)
+		{
+			fclose(filePack);
+			fprintf(g_stdout, "Laying '%s' out from scratch, since keeping "
+			        "its previous layout would waste %llu of %llu bytes.\n",
+			        (char*)packPath.filename().u8string().c_str(),
+			        static_cast<unsigned long long>(dataEnd - freshDataEnd),
+			        static_cast<unsigned long long>(
+			            dataEnd - KASSET_PACK_HEADER_SIZE));
+			io_chunks.resize(chunkBase);
+			return writeAssetPack(assetPath, packPath, options, cache, assets,
+			                      members, io_chunks, o_dataSize);
+		}
+	}
+	if(o_dataSize)
+		*o_dataSize = dataEnd - KASSET_PACK_HEADER_SIZE;
+	// duplicate assets alias the pack entry of their canonical asset //
+	for(size_t a : members)
+	{
+		KAsset& asset = assets[a];
+		if(asset.tombstone)
+			continue;
+		const KAsset& canonical = 
+			assets[packCanonicalOf.at(asset.canonicalIndex)];
+		asset.packContentHash = canonical.packContentHash;
+		asset.packOffset      = canonical.packOffset;
+		asset.packStoredSize  = canonical.packStoredSize;
+		asset.packFirstChunk  = canonical.packFirstChunk;
+		asset.packChunkCount  = canonical.packChunkCount;
+	}
+	const uint64_t tocOffset = alignUp(dataEnd, KASSET_PACK_ALIGNMENT);
+	vector<size_t> tocMembers = members;
+	std::sort(tocMembers.begin(), tocMembers.end());
+	vector<uint8_t> buffer;
+	for(size_t a : tocMembers)
+	{
+		const KAsset& asset = assets[a];
+		appendLe64(buffer, asset.packOffset);
+		appendLe64(buffer, asset.packStoredSize);
+		appendLe64(buffer, assetPackedSize(asset));
+		appendLe64(buffer, asset.packContentHash);
+		appendLe32(buffer, 
+		           asset.packFirstChunk - static_cast<uint32_t>(chunkBase));
+		appendLe32(buffer, asset.packChunkCount);
+	}
+	const uint64_t chunkTableOffset = tocOffset + buffer.size();
+	for(size_t c = chunkBase; c < io_chunks.size(); c++)
+	{
+		const KAssetPackChunk& chunk = io_chunks[c];
+		appendLe64(buffer, chunk.offset);
+		appendLe32(buffer, chunk.storedSize);
+		appendLe32(buffer, 0);
+	}
+	success = success &&
+		(base ? seekFile(filePack, tocOffset) 
+		      : writePadding(filePack, tocOffset - cursor)) &&
+		fwrite(buffer.data(), 1, buffer.size(), filePack) == buffer.size();
+	const uint64_t packEnd = tocOffset + buffer.size();
+	buffer.clear();
+	buffer.insert(buffer.end(), KASSET_PACK_MAGIC, KASSET_PACK_MAGIC + 4);
+	appendLe32(buffer, KASSET_PACK_VERSION);
+	appendLe32(buffer, static_cast<uint32_t>(members.size()));
+	appendLe32(buffer, static_cast<uint32_t>(KASSET_PACK_ALIGNMENT));
+	appendLe64(buffer, tocOffset);
+	appendLe32(buffer, KASSET_PACK_CHUNK_SIZE);
+	appendLe32(buffer, static_cast<uint32_t>(io_chunks.size() - chunkBase));
+	appendLe64(buffer, chunkTableOffset);
+	appendLe64(buffer, 0);
+	success = success &&
+		fseek(filePack, 0, SEEK_SET) == 0 &&
+		fwrite(buffer.data(), 1, buffer.size(), filePack) == buffer.size();
+	if(fclose(filePack) != 0)
+		success = false;
+	if(success && base)
+	// cut off the temporary copies of the assets which were moved //
+	{
+		std::error_code errorCode;
+		fs::resize_file(packPath, packEnd, errorCode);
+		success = !errorCode;
+	}
+	if(!success)
+	{
+		fprintf(g_stderr, "Failed to write '%s'!\n",
+		        (char*)packPath.u8string().c_str());
+		return false;
+	}
+	if(options.compress && (g_verbose || totalSize > 0))
+		fprintf(g_stdout, "Packed %llu bytes of unique asset data into %llu "
+		        "bytes.\n", static_cast<unsigned long long>(totalSize),
+		        static_cast<unsigned long long>(totalStoredSize));
+	return true;
+}
+/** @param bundled each bundle has its own pack; see `kgtAssetBundles` */
+static string generatePackTables(const vector<KAsset>& assets,
+                                 const vector<KAssetPackChunk>& chunks,
+                                 bool bundled)
+{
+	string result;
+	stringstream ss;
+	if(!bundled)
+		ss << "#define KGT_ASSET_PACK_FILE_NAME \""
+		   << GEN_ASSET_PACK_FILE_NAME << "\"\n";
+	ss << "#define KGT_ASSET_PACK_CHUNK_SIZE " << KASSET_PACK_CHUNK_SIZE
+	   << "u\n";
+	ss << "#define KGT_ASSET_PACK_CHUNK_RAW 0x" << std::hex
+	   << KASSET_PACK_CHUNK_RAW << std::dec << "u\n";
+	ss << "static const unsigned KGT_ASSET_PACK_CHUNK_COUNT = "
+	   << chunks.size() << ";\n";
+	result.append(ss.str());
+	result.append("struct KgtAssetPackEntry\n");
+	result.append("{\n");
+	result.append("\tunsigned long long offset;\n");
+	result.append("\tunsigned long long storedSize;\n");
+	result.append("\tunsigned long long size;\n");
+	result.append("\t/* `chunkCount` is 0 if the asset is stored uncompressed */\n");
+	result.append("\tunsigned firstChunk;\n");
+	result.append("\tunsigned chunkCount;\n");
+	result.append("};\n");
+	result.append("struct KgtAssetPackChunk\n");
+	result.append("{\n");
+	result.append("\tunsigned long long offset;\n");
+	result.append("\t/* | KGT_ASSET_PACK_CHUNK_RAW if stored uncompressed */\n");
+	result.append("\tunsigned storedSize;\n");
+	result.append("};\n");
+	result.append("static const KgtAssetPackEntry kgtAssetPackEntries[] = \n");
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		const KAsset& asset = assets[a];
+		stringstream ssEntry;
+		ssEntry << (a == 0 ? "\t{ {" : "\t, {") << asset.packOffset << "ULL, "
+		        << asset.packStoredSize << "ULL, " << assetPackedSize(asset)
+		        << "ULL, "
+		        << asset.packFirstChunk << ", " << asset.packChunkCount
+		        << "}\n";
+		result.append(ssEntry.str());
+	}
+	if(assets.empty())
+		result.append("{{0, 0, 0, 0, 0}};\n");
+	else
+		result.append("};\n");
+	result.append("static const KgtAssetPackChunk kgtAssetPackChunks[] = \n");
+	for(size_t c = 0; c < chunks.size(); c++)
+	{
+		stringstream ssChunk;
+		ssChunk << (c == 0 ? "\t{ {" : "\t, {") << chunks[c].offset << "ULL, 0x"
+		        << std::hex << chunks[c].storedSize << std::dec << "u}\n";
+		result.append(ssChunk.str());
+	}
+	if(chunks.empty())
+		result.append("{{0, 0}};\n");
+	else
+		result.append("};\n");
+	return result;
+}
+static const char GEN_ASSET_PACK_RUNTIME[] = R"KASSET(#pragma once
+/* Runtime access to the asset pack generated by kasset. */
+#include "gen_kgtAssets.h"
+#include <cstdio>
+#include <cstring>
+/** Decode one LZ4-format block.
+ * @return # of bytes written to `dst`, or -1 if `src` is malformed or its
+ *         decoded contents do not fit in `dstCapacity` bytes */
+static inline long long kgtAssetPackDecompress(const void* src,
+                                               size_t srcSize, void* dst,
+                                               size_t dstCapacity)
+{
+	const unsigned char* ip = static_cast<const unsigned char*>(src);
+	const unsigned char*const ipEnd = ip + srcSize;
+	unsigned char*const opBegin = static_cast<unsigned char*>(dst);
+	unsigned char* op = opBegin;
+	unsigned char*const opEnd = opBegin + dstCapacity;
+	while(ip < ipEnd)
+	{
+		const unsigned token = *ip++;
+		size_t literalLength = token >> 4;
+		if(literalLength == 15)
+		{
+			unsigned char b;
+			do
+			{
+				if(ip >= ipEnd)
+					return -1;
+				b = *ip++;
+				literalLength += b;
+			} while(b == 255);
+		}
+		if(static_cast<size_t>(ipEnd - ip) < literalLength ||
+			static_cast<size_t>(opEnd - op) < literalLength)
+			return -1;
+		memcpy(op, ip, literalLength);
+		ip += literalLength;
+		op += literalLength;
+		// the final sequence of a block contains only literals //
+		if(ip == ipEnd)
+			break;
+		if(ipEnd - ip < 2)
+			return -1;
+		const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+		ip += 2;
+		if(offset == 0 || offset > static_cast<size_t>(op - opBegin))
+			return -1;
+		size_t matchLength = token & 15;
+		if(matchLength == 15)
+		{
+			unsigned char b;
+			do
+			{
+				if(ip >= ipEnd)
+					return -1;
+				b = *ip++;
+				matchLength += b;
+			} while(b == 255);
+		}
+		matchLength += 4;
+		if(static_cast<size_t>(opEnd - op) < matchLength)
+			return -1;
+		const unsigned char* match = op - offset;
+		if(offset >= matchLength)
+		{
+			memcpy(op, match, matchLength);
+			op += matchLength;
+		}
+		else
+		// overlapping matches repeat the most recent `offset` bytes //
+		{
+			for(size_t m = 0; m < matchLength; m++)
+				*op++ = *match++;
+		}
+	}
+	return op - opBegin;
+}
+static inline bool kgtAssetPackSeek(FILE* pack, unsigned long long offset)
+{
+#if _MSC_VER
+	return _fseeki64(pack, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+	return fseeko(pack, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+/** Decodes an asset from the pack one chunk at a time, so the asset can be
+ * streamed straight into its final destination. */
+struct KgtAssetPackStream
+{
+	FILE* pack;
+	unsigned asset;
+	/** index of the next chunk to decode, relative to the asset's chunks */
+	unsigned chunk;
+	unsigned long long bytesDecoded;
+};
+static inline KgtAssetPackStream kgtAssetPackStreamBegin(FILE* pack,
+                                                         KgtAssetIndex asset)
+{
+	KgtAssetPackStream result = {};
+	result.pack  = pack;
+	result.asset = static_cast<unsigned>(asset);
+	return result;
+}
+/** Decode the next chunk of the stream's asset.  `dst` must have room for
+ * KGT_ASSET_PACK_CHUNK_SIZE bytes, and so must `scratch`, which holds the
+ * compressed chunk while it is decoded.
+ * @return # of bytes written to `dst`, 0 once the whole asset is decoded, or
+ *         -1 on failure */
+static inline long long kgtAssetPackStreamNext(KgtAssetPackStream& stream,
+                                               void* dst, void* scratch)
+{
+	const KgtAssetPackEntry& entry = kgtAssetPackEntries[stream.asset];
+	if(stream.bytesDecoded >= entry.size)
+		return 0;
+	const unsigned long long bytesRemaining = entry.size - stream.bytesDecoded;
+	const size_t chunkSize = bytesRemaining < KGT_ASSET_PACK_CHUNK_SIZE
+		? static_cast<size_t>(bytesRemaining) : KGT_ASSET_PACK_CHUNK_SIZE;
+	unsigned long long offset = entry.offset + stream.bytesDecoded;
+	size_t storedSize = chunkSize;
+	bool raw = true;
+	if(entry.chunkCount > 0)
+	{
+		const KgtAssetPackChunk& chunk =
+			kgtAssetPackChunks[entry.firstChunk + stream.chunk];
+		offset     = chunk.offset;
+		storedSize = chunk.storedSize & ~KGT_ASSET_PACK_CHUNK_RAW;
+		raw        = (chunk.storedSize & KGT_ASSET_PACK_CHUNK_RAW) != 0;
+	}
+	if(!kgtAssetPackSeek(stream.pack, offset))
+		return -1;
+	void*const readDst = raw ? dst : scratch;
+	if(fread(readDst, 1, storedSize, stream.pack) != storedSize)
+		return -1;
+	if(!raw && kgtAssetPackDecompress(scratch, storedSize, dst, chunkSize) !=
+			static_cast<long long>(chunkSize))
+		return -1;
+	stream.chunk++;
+	stream.bytesDecoded += chunkSize;
+	return static_cast<long long>(chunkSize);
+}
+/** Read & decode an entire asset into `dst`, which must have room for
+ * `kgtAssetPackEntries[asset].size` bytes.  `scratch` must have room for
+ * KGT_ASSET_PACK_CHUNK_SIZE bytes. */
+static inline bool kgtAssetPackRead(FILE* pack, KgtAssetIndex asset,
+                                    void* dst, void* scratch)
+{
+	KgtAssetPackStream stream = kgtAssetPackStreamBegin(pack, asset);
+	unsigned char* dstBytes = static_cast<unsigned char*>(dst);
+	for(;;)
+	{
+		const long long bytesDecoded =
+			kgtAssetPackStreamNext(stream, dstBytes, scratch);
+		if(bytesDecoded < 0)
+			return false;
+		if(bytesDecoded == 0)
+			return true;
+		dstBytes += bytesDecoded;
+	}
+}
+)KASSET";
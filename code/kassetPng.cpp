@@ -0,0 +1,859 @@
+// Offline PNG decoding into GPU-ready texture blobs.  Included by
+//	`main.cpp`. //
+/* `--decode-png` decodes every PNG asset into a blob of premultiplied RGBA8
+ * pixels (with `--mips`, followed by the rest of its mip chain) so that the
+ * runtime can upload textures straight out of a memory-mapped file or the
+ * pack without decoding anything.  Each mip level is tightly packed, &
+ * half the size of the previous level (rounded down, but at least 1).
+ * Decoding is entirely in-tree: a DEFLATE decoder, & PNG unfiltering which
+ * uses SSE2 for the Sub, Up & Paeth filters when it is available. */
+#if defined(__SSE2__) || defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define KASSET_PNG_SSE2 1
+#endif
+static const char* GEN_ASSET_TEXTURE_DIRECTORY = "gen_kgtTextures";
+static const char* KASSET_TEXTURE_EXTENSION = ".rgba8";
+/* PNGs larger than this are almost certainly corrupt */
+static const uint32_t KASSET_PNG_MAX_DIMENSION = 1u << 16;
+struct KPngImage
+{
+	uint32_t width;
+	uint32_t height;
+	/** premultiplied RGBA8, top row first */
+	vector<uint8_t> rgba;
+};
+/* ---------------------------- DEFLATE decoding ---------------------------- */
+static const unsigned INFLATE_MAX_BITS = 15;
+static const unsigned INFLATE_LENGTH_BASE[29] =
+	{ 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59,
+	  67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const unsigned INFLATE_LENGTH_EXTRA[29] =
+	{ 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4,
+	  5, 5, 5, 5, 0 };
+static const unsigned INFLATE_DIST_BASE[30] =
+	{ 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+	  513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385,
+	  24577 };
+static const unsigned INFLATE_DIST_EXTRA[30] =
+	{ 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10,
+	  11, 11, 12, 12, 13, 13 };
+struct KInflateBits
+{
+	const uint8_t* data;
+	size_t size;
+	size_t position;
+	uint64_t bits;
+	unsigned bitCount;
+	/** bits past the end of the data were requested */
+	bool overrun;
+};
+static inline void inflateRefill(KInflateBits& in, unsigned bitCount)
+{
+	while(in.bitCount < bitCount)
+	{
+		uint64_t byte = 0;
+		if(in.position < in.size)
+			byte = in.data[in.position++];
+		else
+			in.overrun = true;
+		in.bits |= byte << in.bitCount;
+		in.bitCount += 8;
+	}
+}
+static inline unsigned inflateBits(KInflateBits& in, unsigned bitCount)
+{
+	if(bitCount == 0)
+		return 0;
+	inflateRefill(in, bitCount);
+	const unsigned result =
+		static_cast<unsigned>(in.bits & ((uint64_t(1) << bitCount) - 1));
+	in.bits >>= bitCount;
+	in.bitCount -= bitCount;
+	return result;
+}
+/** A canonical Huffman code decoded with a single table lookup: each entry
+ * is `symbol << 4 | code length`, indexed by the next 15 bits of input. */
+struct KInflateHuffman
+{
+	vector<uint16_t> table;
+};
+/** @return false if the code lengths don't describe a valid prefix code */
+static bool inflateBuildHuffman(KInflateHuffman& huffman,
+                                const uint8_t* lengths, unsigned symbolCount)
+{
+	unsigned counts[INFLATE_MAX_BITS + 1] = {};
+	for(unsigned s = 0; s < symbolCount; s++)
+		counts[lengths[s]]++;
+	counts[0] = 0;
+	unsigned nextCode[INFLATE_MAX_BITS + 1] = {};
+	int codesLeft = 1;
+	for(unsigned length = 1; length <= INFLATE_MAX_BITS; length++)
+	{
+		codesLeft = 2*codesLeft - static_cast<int>(counts[length]);
+		if(codesLeft < 0)
+			return false;
+		nextCode[length] = (nextCode[length - 1] + counts[length - 1]) << 1;
+	}
+	huffman.table.assign(size_t(1) << INFLATE_MAX_BITS, 0);
+	for(unsigned s = 0; s < symbolCount; s++)
+	{
+		const unsigned length = lengths[s];
+		if(length == 0)
+			continue;
+		// DEFLATE packs Huffman codes starting from their most significant
+		//	bit, so the table is indexed by the code's bits reversed //
+		const unsigned code = nextCode[length]++;
+		unsigned reversed = 0;
+		for(unsigned b = 0; b < length; b++)
+			reversed |= ((code >> b) & 1) << (length - 1 - b);
+		const uint16_t entry = static_cast<uint16_t>(s << 4 | length);
+		for(size_t i = reversed; i < huffman.table.size(); i += size_t(1) << length)
+			huffman.table[i] = entry;
+	}
+	return true;
+}
+/** @return the decoded symbol, or -1 if the input is not a valid code */
+static inline int inflateSymbol(KInflateBits& in, const KInflateHuffman& huffman)
+{
+	inflateRefill(in, INFLATE_MAX_BITS);
+	const uint16_t entry = huffman.table[in.bits & ((1u << INFLATE_MAX_BITS) - 1)];
+	const unsigned length = entry & 15;
+	if(length == 0)
+		return -1;
+	in.bits >>= length;
+	in.bitCount -= length;
+	return entry >> 4;
+}
+static const char* inflateDynamicTables(KInflateBits& in,
+                                        KInflateHuffman& litLen,
+                                        KInflateHuffman& dist)
+{
+	static const uint8_t CODE_LENGTH_ORDER[19] =
+		{ 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	const unsigned litLenCount = inflateBits(in, 5) + 257;
+	const unsigned distCount   = inflateBits(in, 5) + 1;
+	const unsigned codeLengthCount = inflateBits(in, 4) + 4;
+	if(litLenCount > 286 || distCount > 30)
+		return "invalid dynamic Huffman table sizes";
+	uint8_t codeLengthLengths[19] = {};
+	for(unsigned c = 0; c < codeLengthCount; c++)
+		codeLengthLengths[CODE_LENGTH_ORDER[c]] =
+			static_cast<uint8_t>(inflateBits(in, 3));
+	KInflateHuffman codeLength;
+	if(!inflateBuildHuffman(codeLength, codeLengthLengths, 19))
+		return "invalid code length code";
+	uint8_t lengths[286 + 30] = {};
+	for(unsigned l = 0; l < litLenCount + distCount; )
+	{
+		const int symbol = inflateSymbol(in, codeLength);
+		if(symbol < 0)
+			return "invalid code length";
+		if(symbol < 16)
+		{
+			lengths[l++] = static_cast<uint8_t>(symbol);
+			continue;
+		}
+		uint8_t repeated = 0;
+		unsigned repeat;
+		if(symbol == 16)
+		{
+			if(l == 0)
+				return "code length repeat without a previous length";
+			repeated = lengths[l - 1];
+			repeat = 3 + inflateBits(in, 2);
+		}
+		else if(symbol == 17)
+			repeat = 3 + inflateBits(in, 3);
+		else
+			repeat = 11 + inflateBits(in, 7);
+		if(l + repeat > litLenCount + distCount)
+			return "code length repeat overflows the table";
+		while(repeat--)
+			lengths[l++] = repeated;
+	}
+	if(lengths[256] == 0)
+		return "missing end-of-block code";
+	if(!inflateBuildHuffman(litLen, lengths, litLenCount) ||
+		!inflateBuildHuffman(dist, lengths + litLenCount, distCount))
+	{
+		return "invalid literal/length or distance code";
+	}
+	return nullptr;
+}
+/** Decode a zlib stream.
+ * @param expectedSize the exact decoded size, used to reserve the output
+ * @return an error message, or nullptr on success */
+static const char* inflateZlib(const uint8_t* data, size_t size,
+                               size_t expectedSize, vector<uint8_t>& o_out)
+{
+	if(size < 6)
+		return "zlib stream is truncated";
+	if((data[0] & 15) != 8 || (data[0] >> 4) > 7 ||
+		(data[0]*256u + data[1]) % 31 != 0 || (data[1] & 0x20))
+	{
+		return "unsupported zlib stream header";
+	}
+	o_out.clear();
+	o_out.reserve(expectedSize);
+	KInflateBits in = {data + 2, size - 2, 0, 0, 0, false};
+	KInflateHuffman litLen;
+	KInflateHuffman dist;
+	for(bool finalBlock = false; !finalBlock; )
+	{
+		finalBlock = inflateBits(in, 1) != 0;
+		const unsigned blockType = inflateBits(in, 2);
+		if(blockType == 0)
+		// stored; skip to a byte boundary, then copy verbatim //
+		{
+			inflateBits(in, in.bitCount & 7);
+			const unsigned length    = inflateBits(in, 16);
+			const unsigned lengthNot = inflateBits(in, 16);
+			if((length ^ 0xFFFF) != lengthNot)
+				return "corrupt stored block length";
+			// drain the bits which were already buffered first //
+			unsigned remaining = length;
+			while(remaining > 0 && in.bitCount >= 8)
+			{
+				o_out.push_back(static_cast<uint8_t>(inflateBits(in, 8)));
+				remaining--;
+			}
+			if(in.size - in.position < remaining)
+				return "stored block is truncated";
+			o_out.insert(o_out.end(), in.data + in.position,
+			             in.data + in.position + remaining);
+			in.position += remaining;
+			continue;
+		}
+		if(blockType == 1)
+		{
+			uint8_t lengths[288 + 32];
+			memset(lengths      , 8, 144);
+			memset(lengths + 144, 9, 112);
+			memset(lengths + 256, 7,  24);
+			memset(lengths + 280, 8,   8);
+			memset(lengths + 288, 5,  32);
+			inflateBuildHuffman(litLen, lengths, 288);
+			inflateBuildHuffman(dist, lengths + 288, 32);
+		}
+		else if(blockType == 2)
+		{
+			const char*const error = inflateDynamicTables(in, litLen, dist);
+			if(error)
+				return error;
+		}
+		else
+			return "invalid block type";
+		for(;;)
+		{
+			const int symbol = inflateSymbol(in, litLen);
+			if(in.overrun)
+				return "zlib stream is truncated";
+			if(symbol < 0)
+				return "invalid literal/length code";
+			if(symbol < 256)
+			{
+				o_out.push_back(static_cast<uint8_t>(symbol));
+				continue;
+			}
+			if(symbol == 256)
+				break;
+			if(symbol > 285)
+				return "invalid length symbol";
+			const unsigned length = INFLATE_LENGTH_BASE[symbol - 257] +
+				inflateBits(in, INFLATE_LENGTH_EXTRA[symbol - 257]);
+			const int distSymbol = inflateSymbol(in, dist);
+			if(distSymbol < 0 || distSymbol > 29)
+				return "invalid distance code";
+			const size_t distance = INFLATE_DIST_BASE[distSymbol] +
+				inflateBits(in, INFLATE_DIST_EXTRA[distSymbol]);
+			if(distance > o_out.size())
+				return "distance is too far back";
+			size_t from = o_out.size() - distance;
+			// matches may overlap the bytes they produce //
+			for(unsigned l = 0; l < length; l++)
+				o_out.push_back(o_out[from++]);
+		}
+		if(in.overrun)
+			return "zlib stream is truncated";
+	}
+	// the Adler-32 checksum follows at the next byte boundary //
+	inflateBits(in, in.bitCount & 7);
+	uint32_t adlerExpected = 0;
+	for(int b = 0; b < 4; b++)
+		adlerExpected = adlerExpected << 8 | inflateBits(in, 8);
+	if(in.overrun)
+		return "missing zlib checksum";
+	uint32_t adlerA = 1;
+	uint32_t adlerB = 0;
+	for(size_t i = 0; i < o_out.size(); )
+	{
+		// 5552 is the most bytes which can be summed before `adlerB` overflows
+		const size_t end = std::min(o_out.size(), i + 5552);
+		for(; i < end; i++)
+		{
+			adlerA += o_out[i];
+			adlerB += adlerA;
+		}
+		adlerA %= 65521;
+		adlerB %= 65521;
+	}
+	if((adlerB << 16 | adlerA) != adlerExpected)
+		return "zlib checksum mismatch";
+	return nullptr;
+}
+/* ----------------------------- PNG unfiltering ---------------------------- */
+static inline uint8_t pngPaeth(int a, int b, int c)
+{
+	const int p  = a + b - c;
+	const int pa = abs(p - a);
+	const int pb = abs(p - b);
+	const int pc = abs(p - c);
+	if(pa <= pb && pa <= pc)
+		return static_cast<uint8_t>(a);
+	if(pb <= pc)
+		return static_cast<uint8_t>(b);
+	return static_cast<uint8_t>(c);
+}
+#if KASSET_PNG_SSE2
+/* SSE2 unfiltering, modeled on libpng's intrinsics: one pixel per iteration
+ * for Sub & Paeth (each pixel depends on the previous one), & 16 bytes at a
+ * time for Up. */
+static inline __m128i pngLoadPixel(const uint8_t* p, size_t bpp)
+{
+	uint32_t pixel = 0;
+	memcpy(&pixel, p, bpp);
+	return _mm_cvtsi32_si128(static_cast<int>(pixel));
+}
+static inline void pngStorePixel(uint8_t* p, __m128i v, size_t bpp)
+{
+	const uint32_t pixel = static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+	memcpy(p, &pixel, bpp);
+}
+static void pngUnfilterSubSse2(uint8_t* row, size_t rowSize, size_t bpp)
+{
+	__m128i a = _mm_setzero_si128();
+	for(size_t x = 0; x + bpp <= rowSize; x += bpp)
+	{
+		a = _mm_add_epi8(a, pngLoadPixel(row + x, bpp));
+		pngStorePixel(row + x, a, bpp);
+	}
+}
+static void pngUnfilterPaethSse2(uint8_t* row, const uint8_t* prior,
+                                 size_t rowSize, size_t bpp)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i b = zero;
+	__m128i d = zero;
+	for(size_t x = 0; x + bpp <= rowSize; x += bpp)
+	{
+		const __m128i c = b;
+		b = _mm_unpacklo_epi8(pngLoadPixel(prior + x, bpp), zero);
+		const __m128i a = d;
+		d = _mm_unpacklo_epi8(pngLoadPixel(row + x, bpp), zero);
+		// p - a == b - c, p - b == a - c, p - c == (a - c) + (b - c) //
+		__m128i pa = _mm_sub_epi16(b, c);
+		__m128i pb = _mm_sub_epi16(a, c);
+		__m128i pc = _mm_add_epi16(pa, pb);
+		pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+		pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+		pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+		const __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+		const __m128i useA = _mm_cmpeq_epi16(smallest, pa);
+		const __m128i useB = _mm_cmpeq_epi16(smallest, pb);
+		const __m128i bOrC = _mm_or_si128(_mm_and_si128(useB, b),
+		                                  _mm_andnot_si128(useB, c));
+		const __m128i nearest = _mm_or_si128(_mm_and_si128(useA, a),
+		                                     _mm_andnot_si128(useA, bOrC));
+		d = _mm_add_epi8(d, nearest);
+		pngStorePixel(row + x, _mm_packus_epi16(d, d), bpp);
+	}
+}
+#endif// KASSET_PNG_SSE2
+/** Reverse the filter of one scanline in place.  `prior` is the previous
+ * unfiltered scanline, or all zeroes for the first scanline.
+ * @param bpp bytes per complete pixel, rounded up to 1 */
+static bool pngUnfilterRow(uint8_t filter, uint8_t* row, const uint8_t* prior,
+                           size_t rowSize, size_t bpp)
+{
+	switch(filter)
+	{
+		case 0:
+			return true;
+		case 1:
+#if KASSET_PNG_SSE2
+			if(bpp == 3 || bpp == 4)
+			{
+				pngUnfilterSubSse2(row, rowSize, bpp);
+				return true;
+			}
+#endif
+			for(size_t x = bpp; x < rowSize; x++)
+				row[x] = static_cast<uint8_t>(row[x] + row[x - bpp]);
+			return true;
+		case 2:
+		{
+			size_t x = 0;
+#if KASSET_PNG_SSE2
+			for(; x + 16 <= rowSize; x += 16)
+			{
+				const __m128i sum = _mm_add_epi8(
+					_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x)),
+					_mm_loadu_si128(reinterpret_cast<const __m128i*>(prior + x)));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(row + x), sum);
+			}
+#endif
+			for(; x < rowSize; x++)
+				row[x] = static_cast<uint8_t>(row[x] + prior[x]);
+			return true;
+		}
+		case 3:
+			for(size_t x = 0; x < rowSize; x++)
+			{
+				const unsigned left = x >= bpp ? row[x - bpp] : 0;
+				row[x] = static_cast<uint8_t>(row[x] + ((left + prior[x]) >> 1));
+			}
+			return true;
+		case 4:
+#if KASSET_PNG_SSE2
+			if(bpp == 3 || bpp == 4)
+			{
+				pngUnfilterPaethSse2(row, prior, rowSize, bpp);
+				return true;
+			}
+#endif
+			for(size_t x = 0; x < rowSize; x++)
+			{
+				const int left      = x >= bpp ? row[x - bpp]   : 0;
+				const int upperLeft = x >= bpp ? prior[x - bpp] : 0;
+				row[x] = static_cast<uint8_t>(
+					row[x] + pngPaeth(left, prior[x], upperLeft));
+			}
+			return true;
+	}
+	return false;
+}
+/* ------------------------------- PNG decoding ----------------------------- */
+struct KPngHeader
+{
+	uint32_t width;
+	uint32_t height;
+	uint8_t bitDepth;
+	uint8_t colorType;
+	uint8_t interlace;
+	unsigned channels;
+	uint8_t palette[256][4];
+	unsigned paletteSize;
+	/** the color which is fully transparent for color types 0 & 2 */
+	bool hasColorKey;
+	uint16_t colorKey[3];
+};
+static inline uint32_t pngRead32(const uint8_t* p)
+{
+	return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 |
+		p[3];
+}
+static uint32_t pngCrc(const uint8_t* data, size_t size)
+{
+	static uint32_t table[256];
+	static std::once_flag tableOnce;
+	std::call_once(tableOnce, []()
+		{
+			for(uint32_t n = 0; n < 256; n++)
+			{
+				uint32_t c = n;
+				for(int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				table[n] = c;
+			}
+		});
+	uint32_t crc = 0xFFFFFFFFu;
+	for(size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return crc ^ 0xFFFFFFFFu;
+}
+/** Read sample `s` of an unfiltered scanline, at the image's bit depth. */
+static inline unsigned pngSample(const KPngHeader& header, const uint8_t* row,
+                                 size_t s)
+{
+	switch(header.bitDepth)
+	{
+		case 16:
+			return unsigned(row[2*s]) << 8 | row[2*s + 1];
+		case 8:
+			return row[s];
+		default:
+		{
+			const size_t bit = s*header.bitDepth;
+			const unsigned shift =
+				8 - header.bitDepth - static_cast<unsigned>(bit & 7);
+			return (row[bit >> 3] >> shift) & ((1u << header.bitDepth) - 1);
+		}
+	}
+}
+/** Convert pixel `x` of an unfiltered scanline to premultiplied RGBA8. */
+static inline void pngConvertPixel(const KPngHeader& header, const uint8_t* row,
+                                   size_t x, uint8_t* o_rgba)
+{
+	const size_t s = x*header.channels;
+	const unsigned maxSample = (1u << header.bitDepth) - 1;
+	// reduce a sample to 8 bits (16 bit samples keep their high byte) //
+	auto to8 = [&header, maxSample](unsigned sample) -> uint8_t
+	{
+		if(header.bitDepth == 16)
+			return static_cast<uint8_t>(sample >> 8);
+		return static_cast<uint8_t>(sample*255/maxSample);
+	};
+	unsigned r, g, b, a = 255;
+	switch(header.colorType)
+	{
+		case 0:
+		{
+			const unsigned gray = pngSample(header, row, s);
+			r = g = b = to8(gray);
+			if(header.hasColorKey && gray == header.colorKey[0])
+				a = 0;
+		}break;
+		case 2:
+		{
+			const unsigned sr = pngSample(header, row, s);
+			const unsigned sg = pngSample(header, row, s + 1);
+			const unsigned sb = pngSample(header, row, s + 2);
+			r = to8(sr);
+			g = to8(sg);
+			b = to8(sb);
+			if(header.hasColorKey && sr == header.colorKey[0] &&
+				sg == header.colorKey[1] && sb == header.colorKey[2])
+			{
+				a = 0;
+			}
+		}break;
+		case 3:
+		{
+			// out-of-range indices were rejected when the image was read //
+			const uint8_t*const entry = header.palette[pngSample(header, row, s)];
+			r = entry[0];
+			g = entry[1];
+			b = entry[2];
+			a = entry[3];
+		}break;
+		case 4:
+			r = g = b = to8(pngSample(header, row, s));
+			a = to8(pngSample(header, row, s + 1));
+			break;
+		default:
+			r = to8(pngSample(header, row, s));
+			g = to8(pngSample(header, row, s + 1));
+			b = to8(pngSample(header, row, s + 2));
+			a = to8(pngSample(header, row, s + 3));
+			break;
+	}
+	o_rgba[0] = static_cast<uint8_t>((r*a + 127)/255);
+	o_rgba[1] = static_cast<uint8_t>((g*a + 127)/255);
+	o_rgba[2] = static_cast<uint8_t>((b*a + 127)/255);
+	o_rgba[3] = static_cast<uint8_t>(a);
+}
+/** Decode a PNG file into premultiplied RGBA8.
+ * @return an error message, or nullptr on success */
+static const char* pngDecode(const uint8_t* data, size_t size,
+                             KPngImage& o_image)
+{
+	static const uint8_t SIGNATURE[8] = {137, 'P', 'N', 'G', 13, 10, 26, 10};
+	if(size < 8 || memcmp(data, SIGNATURE, 8) != 0)
+		return "not a PNG file";
+	KPngHeader header = {};
+	vector<uint8_t> idat;
+	bool seenHeader = false;
+	bool seenEnd = false;
+	for(size_t c = 8; !seenEnd; )
+	{
+		if(size - c < 12)
+			return "truncated chunk";
+		const uint32_t length = pngRead32(data + c);
+		const uint8_t*const type = data + c + 4;
+		const uint8_t*const body = data + c + 8;
+		if(length > size - c - 12)
+			return "truncated chunk";
+		if(pngCrc(type, length + 4) != pngRead32(body + length))
+			return "chunk CRC mismatch";
+		c += 12 + size_t(length);
+		if(!seenHeader && memcmp(type, "IHDR", 4) != 0)
+			return "missing IHDR chunk";
+		if(memcmp(type, "IHDR", 4) == 0)
+		{
+			if(seenHeader || length != 13)
+				return "invalid IHDR chunk";
+			seenHeader = true;
+			header.width     = pngRead32(body);
+			header.height    = pngRead32(body + 4);
+			header.bitDepth  = body[8];
+			header.colorType = body[9];
+			header.interlace = body[12];
+			static const unsigned CHANNELS[7] = {1, 0, 3, 1, 2, 0, 4};
+			header.channels = header.colorType < 7
+				? CHANNELS[header.colorType] : 0;
+			const unsigned depth = header.bitDepth;
+			const bool depthValid =
+				(depth == 8 || depth == 16 ||
+				 ((depth == 1 || depth == 2 || depth == 4) &&
+				  (header.colorType == 0 || header.colorType == 3))) &&
+				!(header.colorType == 3 && depth == 16);
+			if(header.channels == 0 || !depthValid || body[10] != 0 ||
+				body[11] != 0 || header.interlace > 1)
+			{
+				return "unsupported PNG format";
+			}
+			if(header.width == 0 || header.height == 0 ||
+				header.width > KASSET_PNG_MAX_DIMENSION ||
+				header.height > KASSET_PNG_MAX_DIMENSION)
+			{
+				return "invalid PNG dimensions";
+			}
+		}
+		else if(memcmp(type, "PLTE", 4) == 0)
+		{
+			if(length % 3 != 0 || length/3 > 256 || !idat.empty())
+				return "invalid PLTE chunk";
+			header.paletteSize = length/3;
+			for(unsigned p = 0; p < header.paletteSize; p++)
+			{
+				memcpy(header.palette[p], body + 3*p, 3);
+				header.palette[p][3] = 255;
+			}
+		}
+		else if(memcmp(type, "tRNS", 4) == 0)
+		{
+			if(header.colorType == 3)
+			{
+				if(length > header.paletteSize)
+					return "invalid tRNS chunk";
+				for(unsigned p = 0; p < length; p++)
+					header.palette[p][3] = body[p];
+			}
+			else if((header.colorType == 0 && length == 2) ||
+				(header.colorType == 2 && length == 6))
+			{
+				header.hasColorKey = true;
+				for(unsigned k = 0; k < length/2; k++)
+					header.colorKey[k] =
+						static_cast<uint16_t>(body[2*k] << 8 | body[2*k + 1]);
+			}
+			else
+				return "invalid tRNS chunk";
+		}
+		else if(memcmp(type, "IDAT", 4) == 0)
+			idat.insert(idat.end(), body, body + length);
+		else if(memcmp(type, "IEND", 4) == 0)
+			seenEnd = true;
+		else if(!(type[0] & 0x20))
+			return "unknown critical chunk";
+	}
+	if(header.colorType == 3 && header.paletteSize == 0)
+		return "missing PLTE chunk";
+	// Adam7 passes: x offset, y offset, x step, y step //
+	static const uint32_t ADAM7[7][4] =
+		{ {0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4},
+		  {1, 0, 2, 2}, {0, 1, 1, 2} };
+	static const uint32_t NOT_INTERLACED[1][4] = { {0, 0, 1, 1} };
+	const uint32_t (*const passes)[4] = header.interlace ? ADAM7 : NOT_INTERLACED;
+	const unsigned passCount = header.interlace ? 7 : 1;
+	const size_t bitsPerPixel = size_t(header.bitDepth)*header.channels;
+	const size_t bpp = std::max<size_t>(1, bitsPerPixel/8);
+	size_t expectedSize = 0;
+	for(unsigned p = 0; p < passCount; p++)
+	{
+		const size_t passWidth = (header.width  - passes[p][0] + passes[p][2] - 1)/passes[p][2];
+		const size_t passHeight = (header.height - passes[p][1] + passes[p][3] - 1)/passes[p][3];
+		if(passWidth > 0 && passHeight > 0)
+			expectedSize += passHeight*(1 + (passWidth*bitsPerPixel + 7)/8);
+	}
+	vector<uint8_t> scanlines;
+	const char*const error =
+		inflateZlib(idat.data(), idat.size(), expectedSize, scanlines);
+	if(error)
+		return error;
+	if(scanlines.size() < expectedSize)
+		return "image data is truncated";
+	o_image.width  = header.width;
+	o_image.height = header.height;
+	o_image.rgba.assign(size_t(header.width)*header.height*4, 0);
+	const size_t maxRowSize = (size_t(header.width)*bitsPerPixel + 7)/8;
+	vector<uint8_t> zeroRow(maxRowSize, 0);
+	uint8_t* cursor = scanlines.data();
+	for(unsigned p = 0; p < passCount; p++)
+	{
+		const uint32_t x0 = passes[p][0], y0 = passes[p][1];
+		const uint32_t dx = passes[p][2], dy = passes[p][3];
+		const size_t passWidth = (header.width  - x0 + dx - 1)/dx;
+		const size_t passHeight = (header.height - y0 + dy - 1)/dy;
+		if(passWidth == 0 || passHeight == 0)
+			continue;
+		const size_t rowSize = (passWidth*bitsPerPixel + 7)/8;
+		const uint8_t* prior = zeroRow.data();
+		for(size_t y = 0; y < passHeight; y++)
+		{
+			uint8_t*const row = cursor + 1;
+			if(!pngUnfilterRow(cursor[0], row, prior, rowSize, bpp))
+				return "invalid scanline filter";
+			if(header.colorType == 3)
+				for(size_t x = 0; x < passWidth; x++)
+					if(pngSample(header, row, x) >= header.paletteSize)
+						return "palette index out of range";
+			uint8_t*const outRow = o_image.rgba.data() +
+				((y0 + y*dy)*size_t(header.width) + x0)*4;
+			for(size_t x = 0; x < passWidth; x++)
+				pngConvertPixel(header, row, x, outRow + x*dx*4);
+			prior = row;
+			cursor += 1 + rowSize;
+		}
+	}
+	return nullptr;
+}
+/* ------------------------------ texture blobs ----------------------------- */
+static uint32_t textureMipCount(uint32_t width, uint32_t height)
+{
+	uint32_t result = 1;
+	for(uint32_t size = std::max(width, height); size > 1; size >>= 1)
+		result++;
+	return result;
+}
+/** Append the rest of the mip chain to `blob`, which holds only mip 0, using
+ * a box filter.  Premultiplied alpha makes a plain average correct. */
+static void textureAppendMips(uint32_t width, uint32_t height,
+                              vector<uint8_t>& blob)
+{
+	const uint32_t mipCount = textureMipCount(width, height);
+	size_t sourceOffset = 0;
+	for(uint32_t m = 1; m < mipCount; m++)
+	{
+		const uint32_t mipWidth  = std::max(1u, width  >> 1);
+		const uint32_t mipHeight = std::max(1u, height >> 1);
+		const size_t mipOffset = blob.size();
+		blob.resize(mipOffset + size_t(mipWidth)*mipHeight*4);
+		const uint8_t*const source = blob.data() + sourceOffset;
+		uint8_t*const mip = blob.data() + mipOffset;
+		for(uint32_t y = 0; y < mipHeight; y++)
+			for(uint32_t x = 0; x < mipWidth; x++)
+			{
+				// an odd trailing row/column is folded into the last texel //
+				const uint32_t sx0 = 2*x, sy0 = 2*y;
+				const uint32_t sx1 = x == mipWidth  - 1 ? width  : 2*x + 2;
+				const uint32_t sy1 = y == mipHeight - 1 ? height : 2*y + 2;
+				const uint32_t count = (sx1 - sx0)*(sy1 - sy0);
+				for(int c = 0; c < 4; c++)
+				{
+					uint32_t sum = 0;
+					for(uint32_t sy = sy0; sy < sy1; sy++)
+						for(uint32_t sx = sx0; sx < sx1; sx++)
+							sum += source[(size_t(sy)*width + sx)*4 + c];
+					mip[(size_t(y)*mipWidth + x)*4 + c] =
+						static_cast<uint8_t>((sum + count/2)/count);
+				}
+			}
+		sourceOffset = mipOffset;
+		width  = mipWidth;
+		height = mipHeight;
+	}
+}
+/** @return the path of `asset`'s texture blob relative to the output
+ *          directory, '/' separated */
+static string textureBlobFileName(const KAsset& asset)
+{
+	return string(GEN_ASSET_TEXTURE_DIRECTORY) + "/" + asset.fileName +
+		KASSET_TEXTURE_EXTENSION;
+}
+static const char* processPngDecode(KAssetProcessOutput& io_input,
+                                    const KassetOptions&,
+                                    KAssetProcessOutput& o_output)
+{
+	KPngImage image;
+	const char*const error =
+		pngDecode(io_input.data.data(), io_input.data.size(), image);
+	if(error)
+		return error;
+	vector<uint8_t>().swap(io_input.data);
+	o_output.data.swap(image.rgba);
+	o_output.meta[0] = image.width;
+	o_output.meta[1] = image.height;
+	o_output.meta[2] = 1;
+	return nullptr;
+}
+static const char* processTextureMips(KAssetProcessOutput& io_input,
+                                      const KassetOptions&,
+                                      KAssetProcessOutput& o_output)
+{
+	o_output.data.swap(io_input.data);
+	o_output.meta[0] = io_input.meta[0];
+	o_output.meta[1] = io_input.meta[1];
+	o_output.meta[2] = textureMipCount(o_output.meta[0], o_output.meta[1]);
+	textureAppendMips(o_output.meta[0], o_output.meta[1], o_output.data);
+	return nullptr;
+}
+static void applyTextureOutput(KAsset& asset, const KAssetProcessOutput& output)
+{
+	asset.textureWidth    = output.meta[0];
+	asset.textureHeight   = output.meta[1];
+	asset.textureMipCount = output.meta[2];
+}
+static bool processPngEnabled(const KassetOptions& options)
+{
+	return options.decodePng;
+}
+static bool processMipsEnabled(const KassetOptions& options)
+{
+	return options.mips;
+}
+static string generateTextureTables(const vector<KAsset>& assets)
+{
+	string result;
+	result.append("/* Textures decoded by kasset: premultiplied RGBA8, top row "
+	              "first.  Mip 0 comes\n"
+	              "\tfirst, & each following mip is half the size of the "
+	              "previous one (rounded\n"
+	              "\tdown, but at least 1).  `blobFileName` is relative to the "
+	              "output directory,\n"
+	              "\t& is nullptr for assets which are not textures. */\n");
+	result.append("struct KgtAssetTexture\n");
+	result.append("{\n");
+	result.append("\tconst char* blobFileName;\n");
+	result.append("\tunsigned width;\n");
+	result.append("\tunsigned height;\n");
+	result.append("\tunsigned mipCount;\n");
+	result.append("\tunsigned long long byteSize;\n");
+	result.append("};\n");
+	result.append("static const KgtAssetTexture kgtAssetTextures[] = \n");
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		const KAsset& asset = assets[a];
+		stringstream ss;
+		ss << (a == 0 ? "\t{ {" : "\t, {");
+		if(asset.textureMipCount > 0)
+			ss << "\"" << textureBlobFileName(assets[asset.canonicalIndex])
+			   << "\", ";
+		else
+			ss << "nullptr, ";
+		ss << asset.textureWidth << ", " << asset.textureHeight << ", "
+		   << asset.textureMipCount << ", " << asset.processedSize
+		   << "ULL}\n";
+		result.append(ss.str());
+	}
+	if(assets.empty())
+		result.append("{{nullptr, 0, 0, 0, 0}};\n");
+	else
+		result.append("};\n");
+	result.append(
+		"/** @return the byte offset of `mip` within a texture's blob */\n"
+		"static constexpr unsigned long long kgtAssetTextureMipOffset(\n"
+		"\tunsigned width, unsigned height, unsigned mip)\n"
+		"{\n"
+		"\tunsigned long long offset = 0;\n"
+		"\tfor(unsigned m = 0; m < mip; m++)\n"
+		"\t{\n"
+		"\t\toffset += 4ULL*width*height;\n"
+		"\t\twidth  = width  > 1 ? width  / 2 : 1;\n"
+		"\t\theight = height > 1 ? height / 2 : 1;\n"
+		"\t}\n"
+		"\treturn offset;\n"
+		"}\n");
+	return result;
+}
@@ -0,0 +1,199 @@
+// Asset processing pipeline.  Included by `main.cpp`. //
+/* Processors transform the contents of one type of asset, either straight
+ * from the asset file or from the output of another processor, so together
+ * they form a DAG.  Each asset's final output (that of the last enabled
+ * processor for its type which no other enabled processor consumes) is
+ * pulled through the DAG on demand: every step first looks for its output in
+ * the cache (see kassetCache.cpp), & only runs, after obtaining its own
+ * input, when that misses.  A cached final output therefore means nothing is
+ * read or decoded at all.  Unique assets are processed in parallel, & the
+ * final outputs replace the asset contents in the pack.
+ * Processors must be listed after the processor they consume. */
+static const KAssetProcessor ASSET_PROCESSORS[] =
+	{ { "png-rgba8", 1, KAssetType::PNG, nullptr
+	  , processPngEnabled, nullptr, processPngDecode
+	  , GEN_ASSET_TEXTURE_DIRECTORY, KASSET_TEXTURE_EXTENSION
+	  , applyTextureOutput }
+	, { "rgba8-mips", 1, KAssetType::PNG, "png-rgba8"
+	  , processMipsEnabled, nullptr, processTextureMips
+	  , GEN_ASSET_TEXTURE_DIRECTORY, KASSET_TEXTURE_EXTENSION
+	  , applyTextureOutput }
+};
+struct KAssetProcessStep
+{
+	const KAssetProcessor* processor;
+	/** index of the step whose output this step consumes, or SIZE_MAX for the
+	 * asset file */
+	size_t input;
+	uint64_t cacheKey;
+};
+/** @return the steps which produce the final output of assets of `type`,
+ *          ending with the final step; empty if `type` isn't processed */
+static vector<KAssetProcessStep> planAssetProcessing(
+	KAssetType type, const KassetOptions& options)
+{
+	vector<KAssetProcessStep> steps;
+	for(const KAssetProcessor& processor : ASSET_PROCESSORS)
+	{
+		if(processor.type != type || !processor.enabled(options))
+			continue;
+		size_t input = SIZE_MAX;
+		if(processor.input)
+		{
+			for(input = 0; input < steps.size(); input++)
+				if(strcmp(steps[input].processor->id, processor.input) == 0)
+					break;
+			// the processor this one consumes is disabled //
+			if(input == steps.size())
+				continue;
+		}
+		steps.push_back({&processor, input, 0});
+	}
+	// only the steps which lead to the final output are needed //
+	vector<KAssetProcessStep> chain;
+	for(size_t s = steps.empty() ? SIZE_MAX : steps.size() - 1; s != SIZE_MAX;
+		s = steps[s].input)
+	{
+		chain.insert(chain.begin(), steps[s]);
+	}
+	for(size_t c = 0; c < chain.size(); c++)
+		chain[c].input = c == 0 ? SIZE_MAX : c - 1;
+	return chain;
+}
+/** Obtain the output of `steps[s]`, from the cache if possible.
+ * @return an error message, or nullptr on success */
+static const char* runProcessStep(const fs::path& assetPath,
+                                  const KassetOptions& options,
+                                  KAssetCache& cache, const KAsset& asset,
+                                  const vector<KAssetProcessStep>& steps,
+                                  size_t s, KAssetProcessOutput& o_output)
+{
+	const KAssetProcessStep& step = steps[s];
+	if(cacheLoad(cache, step.cacheKey, o_output))
+		return nullptr;
+	KAssetProcessOutput input = {};
+	if(step.input == SIZE_MAX)
+	{
+		const fs::path sourcePath = assetFilePath(assetPath, asset);
+		std::error_code errorCode;
+		const uintmax_t fileSize = fs::file_size(sourcePath, errorCode);
+		if(errorCode || !readFileContents(sourcePath, fileSize, input.data))
+			return "failed to read the file";
+	}
+	else
+	{
+		const char*const error = runProcessStep(assetPath, options, cache,
+		                                        asset, steps, step.input,
+		                                        input);
+		if(error)
+			return error;
+	}
+	const char*const error = step.processor->process(input, options, o_output);
+	if(error)
+		return error;
+	cacheStore(cache, step.cacheKey, o_output);
+	return nullptr;
+}
+/** Run the processors of every unique asset, & write their final outputs to
+ * the output directory.  Identical assets share the output of their
+ * canonical asset. */
+static bool processAssets(const fs::path& assetPath,
+                          const fs::path& outputPath,
+                          const KassetOptions& options, KAssetCache& cache,
+                          vector<KAsset>& assets)
+{
+	vector<vector<KAssetProcessStep>> plans;
+	vector<size_t> processAssetIndices;
+	vector<size_t> planOfAsset(assets.size(), SIZE_MAX);
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		const KAsset& asset = assets[a];
+		if(asset.tombstone || asset.canonicalIndex != a)
+			continue;
+		size_t p = 0;
+		for(; p < plans.size(); p++)
+			if(plans[p].back().processor->type == asset.type)
+				break;
+		if(p == plans.size())
+		{
+			vector<KAssetProcessStep> plan =
+				planAssetProcessing(asset.type, options);
+			if(plan.empty())
+				continue;
+			plans.push_back(std::move(plan));
+		}
+		planOfAsset[a] = p;
+		processAssetIndices.push_back(a);
+	}
+	std::atomic<bool> success(true);
+	parallelFor(processAssetIndices.size(), [&](size_t i)
+		{
+			KAsset& asset = assets[processAssetIndices[i]];
+			vector<KAssetProcessStep> steps =
+				plans[planOfAsset[processAssetIndices[i]]];
+			if(!asset.contentHashed &&
+				!hashFile(assetFilePath(assetPath, asset), &asset.contentHash))
+			{
+				success = false;
+				return;
+			}
+			asset.contentHashed = true;
+			// each step's key covers its whole chain of inputs //
+			for(KAssetProcessStep& step : steps)
+				step.cacheKey = processorCacheKey(*step.processor, options,
+					step.input == SIZE_MAX
+						? asset.contentHash : steps[step.input].cacheKey);
+			KAssetProcessOutput output = {};
+			const char*const error = runProcessStep(
+				assetPath, options, cache, asset, steps, steps.size() - 1,
+				output);
+			if(error)
+			{
+				fprintf(g_stderr, "Failed to process '%s': %s!\n",
+				        asset.fileName.c_str(), error);
+				success = false;
+				return;
+			}
+			const KAssetProcessor& finalProcessor = *steps.back().processor;
+			const fs::path outputFilePath = outputPath /
+				fs::path(reinterpret_cast<const char8_t*>(
+					(string(finalProcessor.outputDirectory) + "/" +
+					 asset.fileName + finalProcessor.outputExtension).c_str()));
+			std::error_code errorCode;
+			fs::create_directories(outputFilePath.parent_path(), errorCode);
+			FILE*const file = openFile(outputFilePath, "wb");
+			bool written = file &&
+				fwrite(output.data.data(), 1, output.data.size(), file) ==
+					output.data.size();
+			if(file && fclose(file) != 0)
+				written = false;
+			if(!written)
+			{
+				fprintf(g_stderr, "Failed to write '%s'!\n",
+				        (char*)outputFilePath.u8string().c_str());
+				success = false;
+				return;
+			}
+			asset.processedPath = outputFilePath;
+			asset.processedSize = output.data.size();
+			finalProcessor.apply(asset, output);
+		});
+	// identical assets share the output of their canonical asset //
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		KAsset& asset = assets[a];
+		const KAsset& canonical = assets[asset.canonicalIndex];
+		if(asset.tombstone || asset.canonicalIndex == a)
+			continue;
+		asset.processedPath   = canonical.processedPath;
+		asset.processedSize   = canonical.processedSize;
+		asset.textureWidth    = canonical.textureWidth;
+		asset.textureHeight   = canonical.textureHeight;
+		asset.textureMipCount = canonical.textureMipCount;
+	}
+	if(g_verbose)
+		fprintf(g_stdout, "Processed %zu assets; %zu cache hits, %zu misses.\n",
+		        processAssetIndices.size(), cache.hits.load(),
+		        cache.misses.load());
+	return success;
+}
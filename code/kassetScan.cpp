@@ -0,0 +1,216 @@
+// Asset directory scanning.  Included by `main.cpp`. //
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#endif
+/** @param fileName path of the file relative to the asset directory, '/'
+ *                 separated; only valid for the duration of the call
+ * @param fileSize 0 unless the scan was asked to stat files */
+using KAssetScanCallback =
+	std::function<void(const char* fileName, size_t fileNameSize,
+	                   uintmax_t fileSize)>;
+struct KAssetScan
+{
+	/** files in the root of the asset directory which are never assets */
+	vector<string> rootFilesSkipped;
+	const vector<regex>* regexListIgnore;
+	/** fill in the `fileSize` of each file passed to `callback` */
+	bool statFiles;
+	KAssetScanCallback callback;
+};
+static bool assetIgnored(const KAssetScan& scan,
+                         const char* first, const char* last)
+{
+	for(const regex& regexIgnore : *scan.regexListIgnore)
+		if(std::regex_match(first, last, regexIgnore))
+			return true;
+	return false;
+}
+/** @param inRoot the file is directly inside of the asset directory
+ * @param relativePath is matched against the ignore list as-is
+ * @return true if the file is an asset */
+static bool scanAcceptsFile(const KAssetScan& scan, bool inRoot,
+                            const char* relativePath, size_t relativePathSize)
+{
+	if(inRoot)
+		for(const string& skipped : scan.rootFilesSkipped)
+			if(skipped.size() == relativePathSize &&
+				memcmp(skipped.data(), relativePath, relativePathSize) == 0)
+			{
+				return false;
+			}
+	if(assetIgnored(scan, relativePath, relativePath + relativePathSize))
+	{
+		if(g_verbose)
+			fprintf(g_stdout, "Ignoring asset '%.*s'...\n",
+			        static_cast<int>(relativePathSize), relativePath);
+		return false;
+	}
+	if(g_verbose)
+		fprintf(g_stdout, "Adding asset '%.*s'...\n",
+		        static_cast<int>(relativePathSize), relativePath);
+	return true;
+}
+#if defined(__linux__)
+/* glibc doesn't expose getdents64's record layout */
+struct KAssetLinuxDirent64
+{
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+/** Recursively scan the directory `fdDir`, whose path relative to the asset
+ * directory is held in `path`.  `path` is extended with the name of each
+ * entry & truncated back afterwards, so the whole scan shares one buffer.
+ * @param buffers one getdents64 buffer per directory depth, reused across
+ *                sibling directories */
+static bool scanDirectory(const KAssetScan& scan, int fdDir, string& path,
+                          vector<vector<char>>& buffers, size_t depth)
+{
+	if(buffers.size() <= depth)
+		buffers.emplace_back(32*1024);
+	const size_t pathSize = path.size();
+	for(;;)
+	{
+		// `buffers` may grow while recursing, so never hold onto a reference
+		//	to our buffer across a call to `scanDirectory` //
+		const long bytesRead = syscall(SYS_getdents64, fdDir,
+		                               buffers[depth].data(),
+		                               buffers[depth].size());
+		if(bytesRead < 0)
+		{
+			fprintf(g_stderr, "Failed to read directory '%s'!\n", path.c_str());
+			return false;
+		}
+		if(bytesRead == 0)
+			return true;
+		for(long b = 0; b < bytesRead; )
+		{
+			const KAssetLinuxDirent64*const entry =
+				reinterpret_cast<const KAssetLinuxDirent64*>(
+					buffers[depth].data() + b);
+			b += entry->d_reclen;
+			const char*const name = entry->d_name;
+			if(name[0] == '.' &&
+				(name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+			{
+				continue;
+			}
+			unsigned char type = entry->d_type;
+			struct stat entryStat;
+			bool entryStatValid = false;
+			if(type == DT_UNKNOWN)
+			// the file system doesn't report entry types //
+			{
+				if(fstatat(fdDir, name, &entryStat, AT_SYMLINK_NOFOLLOW) != 0)
+					continue;
+				entryStatValid = true;
+				type = S_ISREG(entryStat.st_mode) ? DT_REG
+					: S_ISDIR(entryStat.st_mode) ? DT_DIR
+					: S_ISLNK(entryStat.st_mode) ? DT_LNK
+					: DT_UNKNOWN;
+			}
+			if(type == DT_LNK)
+			// like `is_regular_file`, follow symbolic links to files, but
+			//	never recurse into linked directories //
+			{
+				if(fstatat(fdDir, name, &entryStat, 0) != 0 ||
+					!S_ISREG(entryStat.st_mode))
+				{
+					continue;
+				}
+				entryStatValid = true;
+				type = DT_REG;
+			}
+			if(pathSize > 0)
+				path.push_back('/');
+			path.append(name);
+			if(type == DT_DIR)
+			{
+				const int fdChild = openat(fdDir, name,
+				                           O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+				if(fdChild < 0)
+				{
+					fprintf(g_stderr, "Failed to open directory '%s'!\n",
+					        path.c_str());
+					return false;
+				}
+				const bool success =
+					scanDirectory(scan, fdChild, path, buffers, depth + 1);
+				close(fdChild);
+				if(!success)
+					return false;
+			}
+			else if(type == DT_REG &&
+				scanAcceptsFile(scan, depth == 0, path.data(), path.size()))
+			{
+				uintmax_t fileSize = 0;
+				if(scan.statFiles && (entryStatValid ||
+					fstatat(fdDir, name, &entryStat, 0) == 0))
+				{
+					fileSize = static_cast<uintmax_t>(entryStat.st_size);
+				}
+				scan.callback(path.data(), path.size(), fileSize);
+			}
+			path.resize(pathSize);
+		}
+	}
+}
+#endif// defined(__linux__)
+/** Find every asset file inside `assetPath`, in directory order.
+ * @return false if the asset directory could not be scanned */
+static bool scanAssetTree(const fs::path& assetPath, const KAssetScan& scan)
+{
+#if defined(__linux__)
+	const int fdRoot = open(assetPath.c_str(),
+	                        O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if(fdRoot < 0)
+	{
+		fprintf(g_stderr, "Failed to open asset directory '%s'!\n",
+		        assetPath.c_str());
+		return false;
+	}
+	string path;
+	path.reserve(4096);
+	vector<vector<char>> buffers;
+	const bool success = scanDirectory(scan, fdRoot, path, buffers, 0);
+	close(fdRoot);
+	return success;
+#else
+	// strip the asset directory off the front of each entry's path directly,
+	//	instead of rebuilding the relative path one component at a time //
+	const size_t rootSize = assetPath.native().size();
+	for(const fs::directory_entry& entry :
+		fs::recursive_directory_iterator(assetPath))
+	{
+		if(!entry.is_regular_file())
+			continue;
+		const fs::path::string_type& native = entry.path().native();
+		size_t relativeBegin = rootSize;
+		while(relativeBegin < native.size() &&
+			(native[relativeBegin] == '/' || native[relativeBegin] == '\\'))
+		{
+			relativeBegin++;
+		}
+		const fs::path relative(native.substr(relativeBegin));
+		// the ignore list has always been matched against native separators //
+		const std::u8string relativeNative = relative.u8string();
+		if(!scanAcceptsFile(scan, !relative.has_parent_path(),
+		                    reinterpret_cast<const char*>(relativeNative.data()),
+		                    relativeNative.size()))
+		{
+			continue;
+		}
+		const std::u8string fileName = relative.generic_u8string();
+		scan.callback(reinterpret_cast<const char*>(fileName.data()),
+		              fileName.size(),
+		              scan.statFiles ? entry.file_size() : 0);
+	}
+	return true;
+#endif// defined(__linux__)
+}
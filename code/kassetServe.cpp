@@ -0,0 +1,761 @@
+// Long-running kasset server.  Included by `main.cpp`. //
+/* `kasset --serve socket_path` listens on a Unix domain socket & performs the
+ * runs which `kasset ... --server socket_path` clients forward to it, so
+ * that the many parallel build steps which need the outputs of one asset
+ * directory don't each pay to start a process & scan the whole directory.
+ * For each asset directory it has been asked about, the server keeps the
+ * compiled ignore patterns, the scanned asset list & the content hashes of
+ * asset files in memory (see KAssetWarmTree), & keeps them current by
+ * watching every directory of the tree with inotify.
+ *
+ * Runs over one asset directory never overlap.  A request which arrives
+ * while another is running waits for it, and if the asset directory hasn't
+ * changed since a successful run with identical arguments (the usual case
+ * for concurrent requests), and every file that run left in the output
+ * directory still has the same size & modification time, it is answered
+ * without running again.  Runs over different asset directories proceed in
+ * parallel; each prints into files of its own (see g_stdout), which are sent
+ * back to its client.  Files in
+ * `assets.lock` are assumed to only be modified by kasset.  Symbolically
+ * linked asset files are only noticed changing if the link itself changes.
+ * Runs are as verbose as the server itself; a client's `--verbose` only
+ * affects the client.
+ *
+ * Protocol, little-endian:
+ *	request   "KSRV", u32 protocol version
+ *	          u32 argument count, then each argument as a u32 size followed
+ *	          by its bytes; the arguments are those of a one-shot run,
+ *	          starting with the asset & output directories, with every path
+ *	          made absolute
+ *	response  u32 exit status of the run
+ *	          u32 1 if the outputs were generated, 0 if already up to date
+ *	          what the run printed to stdout, then to stderr, each as a u32
+ *	          size followed by its bytes
+ * The server hangs up on requests of another protocol version.  A client
+ * which can't reach the server (or is hung up on) runs kasset locally
+ * instead. */
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <errno.h>
+#endif
+static const char KASSET_SERVE_MAGIC[4] = {'K', 'S', 'R', 'V'};
+static const uint32_t KASSET_SERVE_VERSION = 2;
+static const uint32_t KASSET_SERVE_MAX_ARGUMENTS = 256;
+static const uint32_t KASSET_SERVE_MAX_ARGUMENT_SIZE = 64*1024;
+/** captured output beyond this is dropped */
+static const uint32_t KASSET_SERVE_MAX_OUTPUT_SIZE = 1024*1024;
+/** @return the arguments of this one-shot run, minus `--server`, for the
+ *          server to perform */
+static vector<string> serveClientArguments(int argc, char** argv)
+{
+	vector<string> arguments;
+	std::error_code errorCode;
+	for(int a = 1; a < argc; a++)
+	{
+		if(strcmp(argv[a], "--server") == 0 && a + 1 < argc)
+		{
+			a++;
+			continue;
+		}
+		// the server doesn't share the client's working directory //
+		const bool isPath = a <= 2 ||
+			(a > 3 && (strcmp(argv[a - 1], "--layout-from-trace") == 0 ||
+			           strcmp(argv[a - 1], "--delta-from") == 0 ||
+			           strcmp(argv[a - 1], "--cache-dir") == 0));
+		if(isPath)
+			arguments.push_back(
+				(char*)fs::absolute(fs::path(argv[a]), errorCode)
+					.u8string().c_str());
+		else
+			arguments.push_back(argv[a]);
+	}
+	return arguments;
+}
+#if defined(__linux__)
+static bool serveWriteAll(int fd, const void* data, size_t size)
+{
+	const char* p = static_cast<const char*>(data);
+	while(size > 0)
+	{
+		// a client which hung up must not kill the server with SIGPIPE //
+		const ssize_t written = send(fd, p, size, MSG_NOSIGNAL);
+		if(written < 0 && errno == EINTR)
+			continue;
+		if(written <= 0)
+			return false;
+		p    += written;
+		size -= static_cast<size_t>(written);
+	}
+	return true;
+}
+static bool serveReadAll(int fd, void* data, size_t size)
+{
+	char* p = static_cast<char*>(data);
+	while(size > 0)
+	{
+		const ssize_t bytesRead = recv(fd, p, size, 0);
+		if(bytesRead < 0 && errno == EINTR)
+			continue;
+		if(bytesRead <= 0)
+			return false;
+		p    += bytesRead;
+		size -= static_cast<size_t>(bytesRead);
+	}
+	return true;
+}
+static bool serveRead32(int fd, uint32_t& o_value)
+{
+	uint8_t bytes[4];
+	if(!serveReadAll(fd, bytes, sizeof(bytes)))
+		return false;
+	o_value = cacheRead32(bytes);
+	return true;
+}
+/** @return false if the socket path doesn't fit in a socket address */
+static bool serveSocketAddress(const char* socketPath, sockaddr_un& o_address)
+{
+	o_address = {};
+	o_address.sun_family = AF_UNIX;
+	if(strlen(socketPath) >= sizeof(o_address.sun_path))
+	{
+		fprintf(stderr, "ERROR: socket path '%s' is too long!\n", socketPath);
+		return false;
+	}
+	strcpy(o_address.sun_path, socketPath);
+	return true;
+}
+/** Have the server at `socketPath` perform a run.
+ * @param o_status the exit status of the run
+ * @return false if the server could not be reached */
+static bool requestFromServer(const char* socketPath,
+                              const vector<string>& arguments, int& o_status)
+{
+	sockaddr_un address;
+	if(!serveSocketAddress(socketPath, address))
+		return false;
+	const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(fd < 0)
+		return false;
+	if(connect(fd, reinterpret_cast<const sockaddr*>(&address),
+	           sizeof(address)) != 0)
+	{
+		close(fd);
+		return false;
+	}
+	vector<uint8_t> request;
+	request.insert(request.end(), KASSET_SERVE_MAGIC, KASSET_SERVE_MAGIC + 4);
+	appendLe32(request, KASSET_SERVE_VERSION);
+	appendLe32(request, static_cast<uint32_t>(arguments.size()));
+	for(const string& argument : arguments)
+	{
+		appendLe32(request, static_cast<uint32_t>(argument.size()));
+		request.insert(request.end(), argument.begin(), argument.end());
+	}
+	uint32_t status;
+	uint32_t generated;
+	bool success = serveWriteAll(fd, request.data(), request.size()) &&
+		serveRead32(fd, status) && serveRead32(fd, generated);
+	string outputs[2];
+	for(string& output : outputs)
+	{
+		uint32_t size;
+		success = success && serveRead32(fd, size) &&
+			size <= KASSET_SERVE_MAX_OUTPUT_SIZE;
+		if(!success)
+			break;
+		output.resize(size);
+		success = serveReadAll(fd, output.data(), size);
+	}
+	close(fd);
+	if(!success)
+		return false;
+	fwrite(outputs[0].data(), 1, outputs[0].size(), stdout);
+	fwrite(outputs[1].data(), 1, outputs[1].size(), stderr);
+	if(g_verbose)
+		printf(generated ? "The kasset server generated the outputs.\n"
+		                 : "The outputs were already up to date.\n");
+	o_status = static_cast<int>(status);
+	return true;
+}
+/** a file in the output directory as a successful run left it */
+struct KAssetServedOutput
+{
+	fs::path path;
+	uintmax_t size;
+	fs::file_time_type writeTime;
+};
+struct KAssetServedRun
+{
+	/** the tree's `generation` when the run succeeded */
+	uint64_t generation;
+	vector<KAssetServedOutput> outputs;
+};
+struct KAssetServedTree
+{
+	fs::path assetPath;
+	/** every directory of the tree is watched, so `warm` can be trusted */
+	bool watched;
+	KAssetWarmTree warm;
+	/** incremented by every change to the asset directory */
+	uint64_t generation;
+	/** a run over this tree is in progress */
+	bool running;
+	/** the last successful run of each set of run arguments */
+	std::unordered_map<string, KAssetServedRun> upToDate;
+};
+struct KAssetServerWatch
+{
+	KAssetServedTree* tree;
+	/** path of the watched directory relative to the asset directory, '/'
+	 * terminated unless it is the asset directory itself */
+	string directory;
+};
+struct KAssetServer
+{
+	std::mutex mutex;
+	std::condition_variable runFinished;
+	/** non-blocking; only read with `mutex` locked, so that events are applied
+	 * in order (see serveReadEvents) */
+	int fdInotify;
+	/** trees by asset directory; elements never move */
+	std::unordered_map<string, KAssetServedTree> trees;
+	std::unordered_map<int, KAssetServerWatch> watches;
+};
+/** Temporary files which the calling thread's run prints into instead of
+ * stdout & stderr, so that everything the run prints (from any of its
+ * threads) can be sent back to its client without mixing in the output of
+ * other runs or of the server itself. */
+struct KAssetServeCapture
+{
+	/** nullptr if the stream could not be captured */
+	FILE* files[2];
+};
+static void serveCaptureBegin(KAssetServeCapture& o_capture)
+{
+	for(size_t s = 0; s < 2; s++)
+		o_capture.files[s] = tmpfile();
+	g_stdout = o_capture.files[0] ? o_capture.files[0] : stdout;
+	g_stderr = o_capture.files[1] ? o_capture.files[1] : stderr;
+}
+/** Point the calling thread's output back at stdout & stderr.
+ * @param o_outputs what was captured from each stream is appended to these */
+static void serveCaptureEnd(KAssetServeCapture& capture, string o_outputs[2])
+{
+	g_stdout = stdout;
+	g_stderr = stderr;
+	for(size_t s = 0; s < 2; s++)
+	{
+		FILE*const file = capture.files[s];
+		if(!file)
+			continue;
+		// the run only ever appended to the file, so this is its end //
+		const long size = ftell(file);
+		const size_t room = KASSET_SERVE_MAX_OUTPUT_SIZE - 
+			std::min<size_t>(o_outputs[s].size(), KASSET_SERVE_MAX_OUTPUT_SIZE);
+		const size_t captured = std::min(size > 0 ? size_t(size) : 0, room);
+		const size_t offset = o_outputs[s].size();
+		o_outputs[s].resize(offset + captured);
+		rewind(file);
+		o_outputs[s].resize(offset + 
+			fread(o_outputs[s].data() + offset, 1, captured, file));
+		fclose(file);
+		if(g_verbose)
+			fwrite(o_outputs[s].data() + offset, 1, o_outputs[s].size() - offset, 
+			       s == 0 ? stdout : stderr);
+	}
+}
+/** Forget everything known about `tree`'s contents. */
+static void serveInvalidateTree(KAssetServedTree& tree)
+{
+	tree.generation++;
+	tree.warm = {};
+}
+/** Watch `directory` of `tree` & every directory beneath it.  Must be called
+ * with the server's mutex locked.
+ * @return false if a directory could not be watched */
+static bool serveWatchDirectory(KAssetServer& server, KAssetServedTree& tree,
+                                const string& directory)
+{
+	const fs::path path = tree.assetPath /
+		fs::path(reinterpret_cast<const char8_t*>(directory.c_str()));
+	const int wd = inotify_add_watch(server.fdInotify, path.c_str(),
+		IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+		IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+		IN_ONLYDIR);
+	if(wd < 0)
+	{
+		fprintf(stderr, "Failed to watch '%s'!\n", path.c_str());
+		return false;
+	}
+	server.watches[wd] = {&tree, directory};
+	std::error_code errorCode;
+	for(const fs::directory_entry& entry :
+		fs::directory_iterator(path, errorCode))
+	{
+		// the scan never recurses into linked directories either //
+		if(!entry.is_directory(errorCode) || entry.is_symlink(errorCode))
+			continue;
+		const string child = directory +
+			(char*)entry.path().filename().u8string().c_str() + "/";
+		if(!serveWatchDirectory(server, tree, child))
+			return false;
+	}
+	return true;
+}
+/** Stop watching `directory` of `tree` & everything beneath it.  Must be
+ * called with the server's mutex locked. */
+static void serveUnwatchDirectory(KAssetServer& server, KAssetServedTree& tree,
+                                  const string& directory)
+{
+	for(auto itWatch = server.watches.begin(); itWatch != server.watches.end();)
+	{
+		if(itWatch->second.tree == &tree &&
+			itWatch->second.directory.compare(0, directory.size(), directory) == 0)
+		{
+			inotify_rm_watch(server.fdInotify, itWatch->first);
+			itWatch = server.watches.erase(itWatch);
+		}
+		else
+			itWatch++;
+	}
+}
+/** (Re)start watching all of `tree`.  Must be called with the server's mutex
+ * locked. */
+static void serveWatchTree(KAssetServer& server, KAssetServedTree& tree)
+{
+	serveUnwatchDirectory(server, tree, "");
+	serveInvalidateTree(tree);
+	tree.watched = serveWatchDirectory(server, tree, "");
+	if(!tree.watched)
+	{
+		printf("WARNING: '%s' can't be watched, so it will be scanned on every "
+		       "request.\n", tree.assetPath.c_str());
+		serveUnwatchDirectory(server, tree, "");
+	}
+}
+/** Update the tree watched by `watch` after `event`.  Must be called with the
+ * server's mutex locked. */
+static void serveApplyEvent(KAssetServer& server, KAssetServerWatch watch,
+                            const inotify_event& event)
+{
+	KAssetServedTree& tree = *watch.tree;
+	if(event.mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+	{
+		// only the asset directory itself needs handling; the events of its
+		//	subdirectories are also reported by their parents //
+		if(watch.directory.empty())
+		{
+			serveUnwatchDirectory(server, tree, "");
+			serveInvalidateTree(tree);
+			tree.watched = false;
+		}
+		return;
+	}
+	if(event.len == 0)
+		return;
+	const string name = event.name;
+	const string fileName = watch.directory + name;
+	if(watch.directory.empty() &&
+		name == (char*)fs::path(ASSET_LOCK_FILE_NAME).u8string().c_str())
+	{
+		return;
+	}
+	tree.generation++;
+	if(watch.directory.empty() &&
+		name == (char*)fs::path(ASSET_IGNORE_FILE_NAME).u8string().c_str())
+	{
+		tree.warm.ignoresLoaded = false;
+		tree.warm.scanned       = false;
+	}
+	if(event.mask & IN_ISDIR)
+	{
+		if(event.mask & (IN_CREATE | IN_MOVED_TO))
+		{
+			if(!serveWatchDirectory(server, tree, fileName + "/"))
+				tree.watched = false;
+		}
+		else if(event.mask & (IN_DELETE | IN_MOVED_FROM))
+			serveUnwatchDirectory(server, tree, fileName + "/");
+		// files can enter & leave with the directory without any events //
+		for(auto itHash = tree.warm.contentHashes.begin();
+			itHash != tree.warm.contentHashes.end();)
+		{
+			if(itHash->first.compare(0, fileName.size() + 1, fileName + "/") == 0)
+				itHash = tree.warm.contentHashes.erase(itHash);
+			else
+				itHash++;
+		}
+		tree.warm.scanned = false;
+		return;
+	}
+	tree.warm.contentHashes.erase(fileName);
+	if(event.mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO))
+		tree.warm.scanned = false;
+	else
+		tree.warm.modifiedFileNames.push_back(fileName);
+}
+/** Apply every inotify event which is queued, without waiting for more.
+ * Must be called with the server's mutex locked.
+ * @return false if the events could not be read */
+static bool serveReadEvents(KAssetServer& server)
+{
+	alignas(inotify_event) char buffer[64*1024];
+	for(;;)
+	{
+		const ssize_t size = read(server.fdInotify, buffer, sizeof(buffer));
+		if(size < 0 && errno == EINTR)
+			continue;
+		if(size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return true;
+		if(size <= 0)
+			return false;
+		for(const char* p = buffer; p < buffer + size;)
+		{
+			const inotify_event& event =
+				*reinterpret_cast<const inotify_event*>(p);
+			p += sizeof(inotify_event) + event.len;
+			if(event.mask & IN_Q_OVERFLOW)
+			// events were lost; nothing can be trusted anymore //
+			{
+				for(auto& tree : server.trees)
+					serveInvalidateTree(tree.second);
+				continue;
+			}
+			auto itWatch = server.watches.find(event.wd);
+			if(itWatch == server.watches.end())
+				continue;
+			if(event.mask & IN_IGNORED)
+			{
+				server.watches.erase(itWatch);
+				continue;
+			}
+			// the watch may be erased while the event is applied //
+			const KAssetServerWatch watch = itWatch->second;
+			serveApplyEvent(server, watch, event);
+		}
+	}
+}
+static void serveWatchEvents(KAssetServer& server)
+{
+	pollfd fdPoll = {server.fdInotify, POLLIN, 0};
+	for(;;)
+	{
+		if(poll(&fdPoll, 1, -1) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			fprintf(stderr, "Failed to wait for inotify events!\n");
+			return;
+		}
+		std::lock_guard<std::mutex> lock(server.mutex);
+		if(!serveReadEvents(server))
+		{
+			fprintf(stderr, "Failed to read inotify events!\n");
+			return;
+		}
+	}
+}
+/** @return every file in `outputPath` & its subdirectories, except for the
+ *          contents of the processing cache, whose entries come & go */
+static vector<KAssetServedOutput> serveOutputs(const fs::path& outputPath,
+                                               const KassetOptions& options)
+{
+	std::error_code errorCode;
+	const fs::path cachePath = fs::weakly_canonical(options.cacheDirectory
+		? fs::path(options.cacheDirectory)
+		: outputPath / GEN_ASSET_CACHE_DIRECTORY, errorCode);
+	vector<KAssetServedOutput> outputs;
+	fs::recursive_directory_iterator itEntry(outputPath, errorCode);
+	for(; !errorCode && itEntry != fs::recursive_directory_iterator();
+		itEntry.increment(errorCode))
+	{
+		if(itEntry->is_directory(errorCode))
+		{
+			if(fs::weakly_canonical(itEntry->path(), errorCode) == cachePath)
+				itEntry.disable_recursion_pending();
+			continue;
+		}
+		KAssetServedOutput output;
+		output.path      = itEntry->path();
+		output.size      = itEntry->file_size(errorCode);
+		output.writeTime = itEntry->last_write_time(errorCode);
+		outputs.push_back(std::move(output));
+	}
+	return outputs;
+}
+/** @return true if all of `outputs` are still exactly as they were */
+static bool serveOutputsUnchanged(const vector<KAssetServedOutput>& outputs)
+{
+	for(const KAssetServedOutput& output : outputs)
+	{
+		std::error_code errorCode;
+		const uintmax_t size = fs::file_size(output.path, errorCode);
+		if(errorCode || size != output.size ||
+			fs::last_write_time(output.path, errorCode) != output.writeTime ||
+			errorCode)
+			return false;
+	}
+	return true;
+}
+/** Append the modification time of `path` (and of each file in it, if it is
+ * a directory) to the key identifying a run which reads it. */
+static void serveAppendWriteTimes(string& key, const fs::path& path)
+{
+	std::error_code errorCode;
+	stringstream ss;
+	ss << fs::last_write_time(path, errorCode).time_since_epoch().count();
+	if(fs::is_directory(path, errorCode))
+		for(const fs::directory_entry& entry :
+			fs::directory_iterator(path, errorCode))
+		{
+			ss << '\0' << (char*)entry.path().filename().u8string().c_str()
+			   << '\0' << entry.last_write_time(errorCode)
+			                   .time_since_epoch().count();
+		}
+	key.append(ss.str());
+	key.push_back('\0');
+}
+/** Perform the run described by `arguments`, unless its outputs are already
+ * up to date.
+ * @param o_outputs receive what the run printed to stdout & stderr */
+static void serveRequest(KAssetServer& server, const vector<string>& arguments,
+                         uint32_t& o_status, uint32_t& o_generated, 
+                         string o_outputs[2])
+{
+	o_status    = EXIT_FAILURE;
+	o_generated = 0;
+	vector<char*> argv;
+	argv.push_back(const_cast<char*>("kasset"));
+	for(const string& argument : arguments)
+		argv.push_back(const_cast<char*>(argument.c_str()));
+	KassetOptions options;
+	bool validArguments = argv.size() >= 3;
+	if(validArguments)
+	{
+		KAssetServeCapture capture;
+		serveCaptureBegin(capture);
+		validArguments = parseKassetOptions(static_cast<int>(argv.size()), 
+		                                    argv.data(), options);
+		serveCaptureEnd(capture, o_outputs);
+	}
+	if(!validArguments)
+	{
+		fprintf(stderr, "Rejected a request with invalid arguments!\n");
+		o_outputs[1].append("ERROR: the kasset server rejected the "
+		                    "arguments!\n");
+		return;
+	}
+	const fs::path assetPath (argv[1]);
+	const fs::path outputPath(argv[2]);
+	o_generated = 1;
+	if(options.stream)
+	// streaming runs don't keep the asset list in memory to begin with //
+	{
+		KAssetServeCapture capture;
+		serveCaptureBegin(capture);
+		o_status = runKasset(assetPath, outputPath, options, nullptr);
+		serveCaptureEnd(capture, o_outputs);
+		return;
+	}
+	// runs are identical if their arguments & the files they read besides
+	//	the assets (the trace & the previous packs) are //
+	string key;
+	for(const string& argument : arguments)
+	{
+		key.append(argument);
+		key.push_back('\0');
+	}
+	std::error_code errorCode;
+	if(options.layoutTracePath)
+		serveAppendWriteTimes(key, options.layoutTracePath);
+	if(options.deltaFrom)
+		serveAppendWriteTimes(key, options.deltaFrom);
+	std::unique_lock<std::mutex> lock(server.mutex);
+	const string treeKey =
+		(char*)fs::weakly_canonical(assetPath, errorCode).u8string().c_str();
+	KAssetServedTree& tree = server.trees[treeKey];
+	server.runFinished.wait(lock, [&tree]() { return !tree.running; });
+	if(!tree.watched)
+	{
+		tree.assetPath = assetPath;
+		serveWatchTree(server, tree);
+	}
+	// changes made before the request was sent are queued by now, but the
+	//	watching thread may not have applied them yet //
+	if(!serveReadEvents(server))
+		for(auto& servedTree : server.trees)
+			serveInvalidateTree(servedTree.second);
+	auto itUpToDate = tree.upToDate.find(key);
+	if(tree.watched && itUpToDate != tree.upToDate.end() &&
+		itUpToDate->second.generation == tree.generation &&
+		serveOutputsUnchanged(itUpToDate->second.outputs))
+	{
+		o_status    = EXIT_SUCCESS;
+		o_generated = 0;
+		return;
+	}
+	tree.running = true;
+	const uint64_t generation = tree.generation;
+	const bool watched = tree.watched;
+	KAssetWarmTree warm;
+	if(watched)
+		warm = tree.warm;
+	lock.unlock();
+	if(warm.scanned && !warm.modifiedFileNames.empty())
+	{
+		std::sort(warm.modifiedFileNames.begin(), warm.modifiedFileNames.end());
+		for(KAsset& asset : warm.assets)
+			if(std::binary_search(warm.modifiedFileNames.begin(),
+			                      warm.modifiedFileNames.end(), asset.fileName))
+			{
+				asset.fileSize =
+					fs::file_size(assetFilePath(assetPath, asset), errorCode);
+			}
+	}
+	warm.modifiedFileNames.clear();
+	if(g_verbose)
+		printf("Generating '%s' => '%s'%s...\n", assetPath.c_str(),
+		       outputPath.c_str(), warm.scanned ? "" : " (scanning)");
+	{
+		KAssetServeCapture capture;
+		serveCaptureBegin(capture);
+		o_status = runKasset(assetPath, outputPath, options,
+		                     watched ? &warm : nullptr);
+		serveCaptureEnd(capture, o_outputs);
+	}
+	KAssetServedRun run;
+	run.generation = generation;
+	if(o_status == EXIT_SUCCESS)
+		run.outputs = serveOutputs(outputPath, options);
+	lock.lock();
+	// anything learned during the run is stale if the tree changed meanwhile //
+	if(watched && tree.watched && tree.generation == generation)
+	{
+		tree.warm = std::move(warm);
+		if(o_status == EXIT_SUCCESS)
+			tree.upToDate[key] = std::move(run);
+	}
+	tree.running = false;
+	server.runFinished.notify_all();
+}
+static void serveConnection(KAssetServer& server, int fd)
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t argumentCount;
+	vector<string> arguments;
+	bool valid = serveReadAll(fd, magic, sizeof(magic)) &&
+		memcmp(magic, KASSET_SERVE_MAGIC, sizeof(magic)) == 0 &&
+		serveRead32(fd, version) && version == KASSET_SERVE_VERSION &&
+		serveRead32(fd, argumentCount) &&
+		argumentCount <= KASSET_SERVE_MAX_ARGUMENTS;
+	for(uint32_t a = 0; valid && a < argumentCount; a++)
+	{
+		uint32_t size;
+		valid = serveRead32(fd, size) && size <= KASSET_SERVE_MAX_ARGUMENT_SIZE;
+		if(!valid)
+			break;
+		string argument(size, '\0');
+		valid = serveReadAll(fd, argument.data(), size);
+		arguments.push_back(std::move(argument));
+	}
+	if(valid)
+	{
+		uint32_t status;
+		uint32_t generated;
+		string outputs[2];
+		serveRequest(server, arguments, status, generated, outputs);
+		vector<uint8_t> response;
+		appendLe32(response, status);
+		appendLe32(response, generated);
+		for(const string& output : outputs)
+		{
+			appendLe32(response, static_cast<uint32_t>(output.size()));
+			response.insert(response.end(), output.begin(), output.end());
+		}
+		serveWriteAll(fd, response.data(), response.size());
+	}
+	close(fd);
+}
+/** `kasset --serve socket_path [--verbose]`; only returns on failure */
+static bool runServer(int argc, char** argv)
+{
+	if(argc < 3)
+	{
+		fprintf(stderr, "Incorrect # of arguments!\n");
+		return false;
+	}
+	const char*const socketPath = argv[2];
+	for(int a = 3; a < argc; a++)
+	{
+		if(strcmp(argv[a], "--verbose") == 0)
+			g_verbose = true;
+		else
+		{
+			fprintf(stderr, "ERROR: incorrect usage on param[%i]=='%s'\n",
+			        a, argv[a]);
+			return false;
+		}
+	}
+	sockaddr_un address;
+	if(!serveSocketAddress(socketPath, address))
+		return false;
+	static KAssetServer server;
+	server.fdInotify = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	const int fdListen = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(server.fdInotify < 0 || fdListen < 0)
+	{
+		fprintf(stderr, "Failed to create the server's descriptors!\n");
+		return false;
+	}
+	// a socket file is left behind by a server which didn't exit cleanly //
+	const int fdProbe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	const bool serverRunning = fdProbe >= 0 &&
+		connect(fdProbe, reinterpret_cast<const sockaddr*>(&address),
+		        sizeof(address)) == 0;
+	if(fdProbe >= 0)
+		close(fdProbe);
+	if(serverRunning)
+	{
+		fprintf(stderr, "ERROR: a server is already listening on '%s'!\n",
+		        socketPath);
+		return false;
+	}
+	unlink(socketPath);
+	if(bind(fdListen, reinterpret_cast<const sockaddr*>(&address),
+	        sizeof(address)) != 0 ||
+		listen(fdListen, SOMAXCONN) != 0)
+	{
+		fprintf(stderr, "Failed to listen on '%s'!\n", socketPath);
+		return false;
+	}
+	std::thread(serveWatchEvents, std::ref(server)).detach();
+	printf("Serving kasset requests on '%s'...\n", socketPath);
+	fflush(stdout);
+	for(;;)
+	{
+		const int fd = accept4(fdListen, nullptr, nullptr, SOCK_CLOEXEC);
+		if(fd < 0)
+		{
+			if(errno == EINTR || errno == ECONNABORTED)
+				continue;
+			fprintf(stderr, "Failed to accept a connection!\n");
+			return false;
+		}
+		std::thread(serveConnection, std::ref(server), fd).detach();
+	}
+}
+#else
+static bool requestFromServer(const char*, const vector<string>&, int&)
+{
+	return false;
+}
+static bool runServer(int, char**)
+{
+	fprintf(stderr, "ERROR: `--serve` is only supported on Linux for now!\n");
+	return false;
+}
+#endif// defined(__linux__)
@@ -0,0 +1,411 @@
+// Bounded-memory streaming mode for enormous asset trees.  Included by
+//	`main.cpp`. //
+/* Scanned assets accumulate in memory until they exceed the memory cap, at
+ * which point they are sorted by file name & spilled to a temporary run file.
+ * The runs are then k-way merged, and each asset is written out to the header
+ * & manifest as soon as it leaves the merge, so resident memory stays flat no
+ * matter how many assets there are.  KgtAssetIndex values are assigned in file
+ * name order, which keeps them deterministic regardless of directory order,
+ * but differs from the scan order used without `--stream`.
+ * Run file records are: u32 fileNameSize, char fileName[], u64 fileSize. */
+static const size_t KASSET_STREAM_DEFAULT_MEMORY_MB = 64;
+/** max # of runs merged at once; more runs than this are merged in passes */
+static const size_t KASSET_STREAM_MAX_FAN_IN = 64;
+/** # of assets whose contents are hashed in parallel at a time */
+static const size_t KASSET_STREAM_HASH_BATCH = 4096;
+static const size_t KASSET_STREAM_WRITE_BUFFER_SIZE = 64*1024;
+struct KAssetStream
+{
+	fs::path outputPath;
+	size_t memoryCap;
+	vector<KAsset> pending;
+	size_t pendingBytes;
+	vector<fs::path> runPaths;
+	size_t runsCreated;
+	uint64_t assetCount;
+	/** total size of all asset file names, including null-terminators */
+	uint64_t namesSize;
+	bool failed;
+};
+static bool writeRunRecord(FILE* file, const KAsset& asset)
+{
+	const uint32_t fileNameSize = static_cast<uint32_t>(asset.fileName.size());
+	const uint64_t fileSize = asset.fileSize;
+	return fwrite(&fileNameSize, sizeof(fileNameSize), 1, file) == 1 &&
+		fwrite(asset.fileName.data(), 1, fileNameSize, file) == fileNameSize &&
+		fwrite(&fileSize, sizeof(fileSize), 1, file) == 1;
+}
+/** @return false at the end of the run, or if the run is truncated */
+static bool readRunRecord(FILE* file, KAsset& o_asset)
+{
+	uint32_t fileNameSize;
+	uint64_t fileSize;
+	if(fread(&fileNameSize, sizeof(fileNameSize), 1, file) != 1)
+		return false;
+	o_asset.fileName.resize(fileNameSize);
+	if(fread(o_asset.fileName.data(), 1, fileNameSize, file) != fileNameSize ||
+		fread(&fileSize, sizeof(fileSize), 1, file) != 1)
+	{
+		return false;
+	}
+	o_asset.fileSize = fileSize;
+	return true;
+}
+static fs::path streamNewRunPath(KAssetStream& stream)
+{
+	stringstream ss;
+	ss << GEN_ASSET_HEADER_FILE_NAME << ".run" << stream.runsCreated++
+	   << ".tmp";
+	return stream.outputPath / ss.str();
+}
+/** Sort the pending assets & write them out as a new run. */
+static bool streamSpill(KAssetStream& stream)
+{
+	std::sort(stream.pending.begin(), stream.pending.end(),
+		[](const KAsset& lhs, const KAsset& rhs)
+		{
+			return lhs.fileName < rhs.fileName;
+		});
+	const fs::path runPath = streamNewRunPath(stream);
+	FILE*const file = openFile(runPath, "wb");
+	bool success = file != nullptr;
+	for(size_t a = 0; success && a < stream.pending.size(); a++)
+		success = writeRunRecord(file, stream.pending[a]);
+	if(file && fclose(file) != 0)
+		success = false;
+	if(!success)
+	{
+		fprintf(g_stderr, "Failed to write '%s'!\n",
+		        (char*)runPath.u8string().c_str());
+		return false;
+	}
+	if(g_verbose)
+		fprintf(g_stdout, "Spilled %zu assets to '%s'...\n",
+		        stream.pending.size(), (char*)runPath.u8string().c_str());
+	stream.runPaths.push_back(runPath);
+	// keep the capacity around for the next run //
+	stream.pending.clear();
+	stream.pendingBytes = 0;
+	return true;
+}
+static void streamAddAsset(KAssetStream& stream, const char* fileName,
+                           size_t fileNameSize, uintmax_t fileSize)
+{
+	if(stream.failed)
+		return;
+	KAsset asset = {};
+	asset.fileName.assign(fileName, fileNameSize);
+	asset.fileSize = fileSize;
+	stream.pendingBytes += sizeof(KAsset) + asset.fileName.capacity();
+	stream.pending.push_back(std::move(asset));
+	stream.assetCount++;
+	stream.namesSize += fileNameSize + 1;
+	if(stream.pendingBytes >= stream.memoryCap && !streamSpill(stream))
+		stream.failed = true;
+}
+/** Merge the sorted runs at `runPaths`, passing each asset to `sink` in file
+ * name order.  `sink` may take the contents of the asset it is given. */
+static bool mergeRuns(const vector<fs::path>& runPaths,
+                      const std::function<bool(KAsset&)>& sink)
+{
+	struct Run
+	{
+		FILE* file;
+		KAsset current;
+	};
+	vector<Run> runs(runPaths.size());
+	bool success = true;
+	for(size_t r = 0; r < runs.size(); r++)
+	{
+		runs[r].file = openFile(runPaths[r], "rb");
+		if(!runs[r].file)
+		{
+			fprintf(g_stderr, "Failed to open '%s'!\n",
+			        (char*)runPaths[r].u8string().c_str());
+			success = false;
+		}
+	}
+	// min-heap of the runs which still have assets, keyed on their current
+	//	asset's file name //
+	auto greater = [&runs](size_t lhs, size_t rhs)
+	{
+		return runs[lhs].current.fileName > runs[rhs].current.fileName;
+	};
+	vector<size_t> heap;
+	for(size_t r = 0; success && r < runs.size(); r++)
+		if(readRunRecord(runs[r].file, runs[r].current))
+			heap.push_back(r);
+	std::make_heap(heap.begin(), heap.end(), greater);
+	while(success && !heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end(), greater);
+		const size_t r = heap.back();
+		heap.pop_back();
+		if(!sink(runs[r].current))
+			success = false;
+		if(readRunRecord(runs[r].file, runs[r].current))
+		{
+			heap.push_back(r);
+			std::push_heap(heap.begin(), heap.end(), greater);
+		}
+	}
+	for(size_t r = 0; r < runs.size(); r++)
+		if(runs[r].file)
+		{
+			if(success && !feof(runs[r].file))
+			{
+				fprintf(g_stderr, "Failed to read '%s'!\n",
+				        (char*)runPaths[r].u8string().c_str());
+				success = false;
+			}
+			fclose(runs[r].file);
+		}
+	return success;
+}
+/** Merge runs together until few enough remain to be merged in one pass. */
+static bool streamReduceRuns(KAssetStream& stream)
+{
+	while(stream.runPaths.size() > KASSET_STREAM_MAX_FAN_IN)
+	{
+		const vector<fs::path> inputPaths(stream.runPaths.begin(),
+			stream.runPaths.begin() + KASSET_STREAM_MAX_FAN_IN);
+		const fs::path runPath = streamNewRunPath(stream);
+		FILE*const file = openFile(runPath, "wb");
+		bool success = file && mergeRuns(inputPaths,
+			[file](KAsset& asset) { return writeRunRecord(file, asset); });
+		if(file && fclose(file) != 0)
+			success = false;
+		if(!success)
+		{
+			fprintf(g_stderr, "Failed to write '%s'!\n",
+			        (char*)runPath.u8string().c_str());
+			return false;
+		}
+		for(const fs::path& inputPath : inputPaths)
+			fs::remove(inputPath);
+		stream.runPaths.erase(stream.runPaths.begin(),
+			stream.runPaths.begin() + KASSET_STREAM_MAX_FAN_IN);
+		stream.runPaths.push_back(runPath);
+	}
+	return true;
+}
+/** Receives assets in KgtAssetIndex order & writes them out.  The enum is
+ * written straight into the header, while the file name table goes to a
+ * temporary file which is appended to the header at the end. */
+struct KAssetStreamOutput
+{
+	fs::path assetPath;
+	const KassetOptions* options;
+	FILE* header;
+	fs::path fileNamesPath;
+	FILE* fileNames;
+	string headerBuffer;
+	string fileNamesBuffer;
+	KAssetManifestWriter manifest;
+	vector<KAsset> batch;
+	size_t assetIndex;
+};
+static bool streamFlushBuffer(FILE* file, string& buffer)
+{
+	const bool success =
+		fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size();
+	buffer.clear();
+	return success;
+}
+static bool streamOutputBatch(KAssetStreamOutput& output)
+{
+	if(output.options->manifest && !hashAssets(output.assetPath, output.batch))
+		return false;
+	for(KAsset& asset : output.batch)
+	{
+		asset.type = assetTypeFromFileName(asset.fileName);
+		appendAssetEnumEntry(output.headerBuffer, asset.fileName,
+		                     output.assetIndex, output.assetIndex == 0);
+		appendAssetFileNameEntry(output.fileNamesBuffer, asset.fileName,
+		                         output.assetIndex == 0);
+		output.assetIndex++;
+		if(output.options->manifest &&
+			!manifestWriterAppend(output.manifest, asset))
+		{
+			return false;
+		}
+	}
+	output.batch.clear();
+	bool success = true;
+	if(output.headerBuffer.size() >= KASSET_STREAM_WRITE_BUFFER_SIZE)
+		success = streamFlushBuffer(output.header, output.headerBuffer);
+	if(output.fileNamesBuffer.size() >= KASSET_STREAM_WRITE_BUFFER_SIZE)
+		success = streamFlushBuffer(output.fileNames, output.fileNamesBuffer) &&
+			success;
+	if(!success)
+		fprintf(g_stderr, "Failed to write the asset header!\n");
+	return success;
+}
+static bool streamOutputAsset(KAssetStreamOutput& output, KAsset& asset)
+{
+	output.batch.push_back(std::move(asset));
+	if(output.batch.size() < KASSET_STREAM_HASH_BATCH)
+		return true;
+	return streamOutputBatch(output);
+}
+/** Finish the header: close out the enum & append the file name table. */
+static bool streamOutputEnd(KAssetStreamOutput& output)
+{
+	string& result = output.headerBuffer;
+	result.append(output.assetIndex == 0
+		? "\t{ ENUM_SIZE"
+		: "\t, ENUM_SIZE");
+	result.append("\n};\n");
+	result.append("static const unsigned KGT_ASSET_COUNT = \n");
+	result.append("\tstatic_cast<unsigned>(KgtAssetIndex::ENUM_SIZE);\n");
+	result.append("static const char* kgtAssetFileNames[] = \n");
+	bool success = streamFlushBuffer(output.header, result) &&
+		streamFlushBuffer(output.fileNames, output.fileNamesBuffer) &&
+		fflush(output.fileNames) == 0 &&
+		seekFile(output.fileNames, 0);
+	vector<char> copyBuffer(KASSET_STREAM_WRITE_BUFFER_SIZE);
+	while(success)
+	{
+		const size_t bytesRead =
+			fread(copyBuffer.data(), 1, copyBuffer.size(), output.fileNames);
+		if(bytesRead == 0)
+		{
+			success = !ferror(output.fileNames);
+			break;
+		}
+		success =
+			fwrite(copyBuffer.data(), 1, bytesRead, output.header) == bytesRead;
+	}
+	if(output.assetIndex == 0)
+		result.append("{\"NO_KASSETS_FOUND\"};\n");
+	else
+		result.append("};\n");
+	result.append("static inline const char* kgtAssetFileName(KgtAssetIndex asset)\n"
+	              "{\n"
+	              "\treturn kgtAssetFileNames[static_cast<unsigned>(asset)];\n"
+	              "}\n");
+	if(output.assetIndex == 0)
+		result.append("#define KGT_ASSET_NONE_FOUND\n");
+	success = success && streamFlushBuffer(output.header, result);
+	if(!success)
+		fprintf(g_stderr, "Failed to write the asset header!\n");
+	return success;
+}
+/** Run kasset over `assetPath` in bounded memory.  Only the header & the
+ * manifest can be generated in this mode.
+ * @param scan its callback is replaced */
+static bool streamAssets(const fs::path& assetPath, const fs::path& outputPath,
+                         const KassetOptions& options, KAssetScan scan,
+                         size_t memoryCap)
+{
+	fs::create_directories(outputPath);
+	KAssetStream stream = {};
+	stream.outputPath = outputPath;
+	stream.memoryCap  = memoryCap;
+	scan.callback =
+		[&stream](const char* fileName, size_t fileNameSize, uintmax_t fileSize)
+		{
+			streamAddAsset(stream, fileName, fileNameSize, fileSize);
+		};
+	bool success = scanAssetTree(assetPath, scan) && !stream.failed;
+	// a tree which fits within the memory cap never needs to touch the disk //
+	if(success && !stream.runPaths.empty() && !stream.pending.empty())
+		success = streamSpill(stream);
+	success = success && streamReduceRuns(stream);
+	if(g_verbose)
+		fprintf(g_stdout, "Streaming %ju assets from %zu runs...\n",
+		        uintmax_t(stream.assetCount), stream.runPaths.size());
+	KAssetStreamOutput output = {};
+	output.assetPath     = assetPath;
+	output.options       = &options;
+	output.fileNamesPath =
+		outputPath / (string(GEN_ASSET_HEADER_FILE_NAME) + ".names.tmp");
+	// outputs are written next to their final paths & only replace the 
+	//	previous outputs once they are complete, so that a failed run can't 
+	//	leave a truncated header behind //
+	const fs::path headerPath = outputPath / GEN_ASSET_HEADER_FILE_NAME;
+	const fs::path manifestPath = outputPath / GEN_ASSET_MANIFEST_FILE_NAME;
+	fs::path headerTempPath = headerPath;
+	headerTempPath += ".tmp";
+	fs::path manifestTempPath = manifestPath;
+	manifestTempPath += ".tmp";
+	if(success)
+	{
+		output.header    = openFile(headerTempPath, "wb");
+		output.fileNames = openFile(output.fileNamesPath, "w+b");
+		if(!output.header || !output.fileNames)
+		{
+			fprintf(g_stderr, "Failed to open the asset header for writing!\n");
+			success = false;
+		}
+	}
+	if(success && options.manifest)
+		success = manifestWriterBegin(output.manifest, manifestTempPath, 
+			stream.assetCount, stream.namesSize);
+	if(success)
+	{
+		output.headerBuffer.append("#pragma once\n");
+		output.headerBuffer.append("enum class KgtAssetIndex : unsigned\n");
+		auto sink = [&output](KAsset& asset)
+		{
+			return streamOutputAsset(output, asset);
+		};
+		if(stream.runPaths.empty())
+		{
+			std::sort(stream.pending.begin(), stream.pending.end(),
+				[](const KAsset& lhs, const KAsset& rhs)
+				{
+					return lhs.fileName < rhs.fileName;
+				});
+			for(size_t a = 0; success && a < stream.pending.size(); a++)
+				success = sink(stream.pending[a]);
+		}
+		else
+			success = mergeRuns(stream.runPaths, sink);
+		success = success && streamOutputBatch(output) &&
+			streamOutputEnd(output);
+	}
+	if(output.manifest.file)
+	{
+		if(success)
+			success = manifestWriterEnd(output.manifest);
+		else
+			fclose(output.manifest.file);
+	}
+	if(success && options.manifest)
+	{
+		const fs::path readerPath =
+			outputPath / GEN_ASSET_MANIFEST_READER_FILE_NAME;
+		success = writeEntireFile(readerPath.c_str(), 
+		                          GEN_ASSET_MANIFEST_READER, false);
+	}
+	if(output.header && fclose(output.header) != 0)
+		success = false;
+	if(success)
+	{
+		std::error_code errorCode;
+		fs::rename(headerTempPath, headerPath, errorCode);
+		if(!errorCode && options.manifest)
+			fs::rename(manifestTempPath, manifestPath, errorCode);
+		if(errorCode)
+		{
+			fprintf(g_stderr, "Failed to replace the previous outputs in "
+			        "'%s'!\n", (char*)outputPath.u8string().c_str());
+			success = false;
+		}
+	}
+	if(!success)
+	{
+		std::error_code errorCode;
+		fs::remove(headerTempPath, errorCode);
+		fs::remove(manifestTempPath, errorCode);
+	}
+	if(output.fileNames)
+	{
+		fclose(output.fileNames);
+		fs::remove(output.fileNamesPath);
+	}
+	for(const fs::path& runPath : stream.runPaths)
+		fs::remove(runPath);
+	return success;
+}
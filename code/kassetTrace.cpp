@@ -0,0 +1,161 @@
+// Access-trace-guided pack layout.  Included by `main.cpp`. //
+/* A trace file records the order in which a game first touched each asset:
+ *	kasset-trace 1
+ *	<asset file name>        one per line, in first-touch order
+ *	<empty line>             the end of a phase (startup, a level load, ...)
+ * The assets touched in each phase form a layout group.  `--layout-from-trace`
+ * writes each group contiguously in the pack, starting on its own page, with
+ * the first (startup) group at the front & untraced assets at the end, so
+ * that each phase of the game reads the pack sequentially. */
+static const char* KASSET_TRACE_MAGIC = "kasset-trace 1";
+static const size_t KASSET_LAYOUT_GROUP_UNTRACED = SIZE_MAX;
+static const char GEN_ASSET_TRACE_HOOK[] = R"KASSET(#if defined(KGT_ASSET_TRACE)
+/* First-touch tracing for `kasset --layout-from-trace`.  Call `kgtAssetTouch`
+ * whenever an asset is loaded, `kgtAssetTraceMark` at the end of each phase
+ * (the first phase should end once startup completes), & `kgtAssetTraceWrite`
+ * once loading has quiesced. */
+#include <atomic>
+#include <cstdio>
+static const unsigned KGT_ASSET_TRACE_MAX_MARKS = 256;
+struct KgtAssetTrace
+{
+	std::atomic<bool> touched[KGT_ASSET_COUNT > 0 ? KGT_ASSET_COUNT : 1];
+	std::atomic<unsigned> markCount;
+	std::atomic<unsigned> eventCount;
+	/* KgtAssetIndex values in first-touch order; KGT_ASSET_COUNT marks the
+		end of a phase */
+	std::atomic<unsigned> events[KGT_ASSET_COUNT + KGT_ASSET_TRACE_MAX_MARKS];
+};
+/* one trace for the whole program, regardless of how many translation units
+	include this header */
+inline KgtAssetTrace& kgtAssetTraceGet()
+{
+	static KgtAssetTrace trace;
+	return trace;
+}
+static inline void kgtAssetTraceAppend(unsigned event)
+{
+	KgtAssetTrace& trace = kgtAssetTraceGet();
+	const unsigned e = trace.eventCount.fetch_add(1, std::memory_order_relaxed);
+	trace.events[e].store(event, std::memory_order_relaxed);
+}
+static inline void kgtAssetTouch(KgtAssetIndex asset)
+{
+	const unsigned a = static_cast<unsigned>(asset);
+	if(a >= KGT_ASSET_COUNT ||
+		kgtAssetTraceGet().touched[a].exchange(true, std::memory_order_relaxed))
+		return;
+	kgtAssetTraceAppend(a);
+}
+static inline void kgtAssetTraceMark()
+{
+	if(kgtAssetTraceGet().markCount.fetch_add(1, std::memory_order_relaxed) <
+			KGT_ASSET_TRACE_MAX_MARKS)
+		kgtAssetTraceAppend(KGT_ASSET_COUNT);
+}
+static inline bool kgtAssetTraceWrite(const char* path)
+{
+	FILE* file = nullptr;
+#if _MSC_VER
+	if(fopen_s(&file, path, "w") != 0)
+		file = nullptr;
+#else
+	file = fopen(path, "w");
+#endif
+	if(!file)
+		return false;
+	KgtAssetTrace& trace = kgtAssetTraceGet();
+	fputs("kasset-trace 1\n", file);
+	const unsigned eventCount = trace.eventCount.load(std::memory_order_acquire);
+	for(unsigned e = 0; e < eventCount; e++)
+	{
+		const unsigned event = trace.events[e].load(std::memory_order_relaxed);
+		if(event >= KGT_ASSET_COUNT)
+			fputs("\n", file);
+		else if(kgtAssetFileName(static_cast<KgtAssetIndex>(event)))
+			fprintf(file, "%s\n",
+			        kgtAssetFileName(static_cast<KgtAssetIndex>(event)));
+	}
+	return fclose(file) == 0;
+}
+#else
+static inline void kgtAssetTouch(KgtAssetIndex) {}
+static inline void kgtAssetTraceMark() {}
+#endif// defined(KGT_ASSET_TRACE)
+)KASSET";
+/** Assign the layout group of every asset from the trace at `tracePath`.
+ * Assets which are absent from the trace are placed in the last group.
+ * @return false if the trace can't be read or is malformed */
+static bool applyAssetTrace(const fs::path& tracePath, vector<KAsset>& assets)
+{
+	if(!fs::exists(tracePath))
+	{
+		fprintf(g_stderr, "Asset trace '%s' does not exist!\n",
+		        (char*)tracePath.u8string().c_str());
+		return false;
+	}
+	const uintmax_t fileSize = fs::file_size(tracePath);
+	char*const fileTrace = readEntireFile(tracePath.c_str(), fileSize);
+	if(!fileTrace)
+		return false;
+	istringstream iss(fileTrace);
+	free(fileTrace);
+	string line;
+	std::getline(iss, line);
+	rtrim(line);
+	if(line != KASSET_TRACE_MAGIC)
+	{
+		fprintf(g_stderr, "'%s' is not an asset trace!\n",
+		        (char*)tracePath.u8string().c_str());
+		return false;
+	}
+	std::unordered_map<string, size_t> assetOfFileName;
+	for(size_t a = 0; a < assets.size(); a++)
+	{
+		assets[a].layoutGroup = KASSET_LAYOUT_GROUP_UNTRACED;
+		if(!assets[a].tombstone)
+			assetOfFileName[assets[a].fileName] = a;
+	}
+	size_t group = 0;
+	size_t groupSize = 0;
+	size_t tracedCount = 0;
+	size_t unknownCount = 0;
+	while(std::getline(iss, line))
+	{
+		// file names can legitimately end in whitespace; only strip the
+		//	carriage return of files which were edited on Windows //
+		if(!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if(line.empty())
+		// an empty phase doesn't need a group of its own //
+		{
+			if(groupSize > 0)
+				group++;
+			groupSize = 0;
+			continue;
+		}
+		auto itAsset = assetOfFileName.find(line);
+		if(itAsset == assetOfFileName.end())
+		{
+			if(g_verbose)
+				fprintf(g_stdout, "Traced asset '%s' no longer exists.\n",
+				        line.c_str());
+			unknownCount++;
+			continue;
+		}
+		KAsset& asset = assets[itAsset->second];
+		if(asset.layoutGroup != KASSET_LAYOUT_GROUP_UNTRACED)
+			continue;
+		asset.layoutGroup = group;
+		groupSize++;
+		tracedCount++;
+	}
+	const size_t groupCount = group + (groupSize > 0 ? 1 : 0);
+	fprintf(g_stdout, "Laid out %zu traced assets in %zu groups; %zu assets "
+	        "untraced.\n", tracedCount, groupCount,
+	        assetOfFileName.size() - tracedCount);
+	if(unknownCount > 0)
+		fprintf(g_stdout, "WARNING: %zu traced assets no longer exist; "
+		        "consider recording a new trace.\n", unknownCount);
+	return true;
+}
@@ -0,0 +1,126 @@
+// Dense per-type index spaces.  Included by `main.cpp`. //
+/* With `--type-indices`, each category of asset gets its own enum
+ * (KgtTextureIndex, KgtSoundIndex, ...) which numbers only the assets of that
+ * category from 0, in KgtAssetIndex order, so that a subsystem can size its
+ * arrays to exactly its own assets.  Converting either way is one table
+ * lookup:
+ *	kgtAssetOf<Category>(index)  the KgtAssetIndex of a category's asset
+ *	kgt<Category>Of(asset)       the asset's index within the category, or
+ *	                             ENUM_SIZE if it belongs to another category
+ * Every asset belongs to at most one category, so `kgtAssetTypeIndices[]`
+ * holds each asset's index within its own category for all of them.  Dense
+ * indices are renumbered whenever assets are added or removed, even when
+ * KgtAssetIndex values are locked. */
+struct KAssetTypeCategory
+{
+	/** as it appears in generated names, such as "Texture" */
+	const char* name;
+	const char* nameUpper;
+};
+static const KAssetTypeCategory KASSET_TYPE_CATEGORIES[] =
+	{ {"Texture" , "TEXTURE" }
+	, {"Sound"   , "SOUND"   }
+	, {"Flipbook", "FLIPBOOK"}
+	, {"Material", "MATERIAL"}
+};
+/** @return index of the category of `type` in KASSET_TYPE_CATEGORIES, or
+ *          SIZE_MAX if it has none */
+static size_t assetTypeCategory(KAssetType type)
+{
+	switch(type)
+	{
+		case KAssetType::PNG:           return 0;
+		case KAssetType::WAV:
+		case KAssetType::OGG:           return 1;
+		case KAssetType::FLIPBOOK_META: return 2;
+		case KAssetType::MATERIAL:      return 3;
+		default:                        return SIZE_MAX;
+	}
+}
+static string generateTypeIndexTables(const vector<KAsset>& assets)
+{
+	string result;
+	result.append("/* Each category of asset has an enum (Kgt<Category>Index) "
+	              "which numbers only\n"
+	              "\tthe assets of that category from 0, in KgtAssetIndex "
+	              "order.\n"
+	              "\tkgtAssetOf<Category>(index) returns the KgtAssetIndex of "
+	              "a category's\n"
+	              "\tasset, & kgt<Category>Of(asset) the asset's index within "
+	              "the category, or\n"
+	              "\tENUM_SIZE if it belongs to another one.  These indices "
+	              "are renumbered\n"
+	              "\twhenever assets are added or removed, even when "
+	              "KgtAssetIndex values are\n"
+	              "\tlocked.  Below is each asset's index within its own "
+	              "category, or ~0u if\n"
+	              "\tit belongs to none. */\n");
+	vector<size_t> typeIndices(assets.size(), SIZE_MAX);
+	string categoryTables;
+	for(size_t c = 0; c < std::size(KASSET_TYPE_CATEGORIES); c++)
+	{
+		const string name      = KASSET_TYPE_CATEGORIES[c].name;
+		const string nameUpper = KASSET_TYPE_CATEGORIES[c].nameUpper;
+		string enumEntries;
+		string assetEntries;
+		size_t count = 0;
+		for(size_t a = 0; a < assets.size(); a++)
+		{
+			if(assets[a].tombstone || assetTypeCategory(assets[a].type) != c)
+				continue;
+			typeIndices[a] = count;
+			appendAssetEnumEntry(enumEntries, assets[a].fileName, count,
+			                     count == 0);
+			stringstream ss;
+			ss << (count == 0 ? "\t{ " : "\t, ") << a << "\n";
+			assetEntries.append(ss.str());
+			count++;
+		}
+		categoryTables.append("enum class Kgt" + name + "Index : unsigned\n");
+		categoryTables.append(enumEntries);
+		categoryTables.append(count == 0 ? "\t{ ENUM_SIZE\n};\n"
+		                                 : "\t, ENUM_SIZE\n};\n");
+		categoryTables.append("static constexpr unsigned KGT_" + nameUpper +
+		                      "_COUNT = \n");
+		categoryTables.append("\tstatic_cast<unsigned>(Kgt" + name +
+		                      "Index::ENUM_SIZE);\n");
+		categoryTables.append("static constexpr unsigned kgt" + name +
+		                      "Assets[] = \n");
+		categoryTables.append(count == 0 ? "{0};\n" : assetEntries + "};\n");
+		categoryTables.append(
+			"static constexpr KgtAssetIndex kgtAssetOf" + name + "(Kgt" + name +
+			"Index index)\n"
+			"{\n"
+			"\treturn static_cast<KgtAssetIndex>(\n"
+			"\t\tkgt" + name + "Assets[static_cast<unsigned>(index)]);\n"
+			"}\n"
+			"static constexpr Kgt" + name + "Index kgt" + name +
+			"Of(KgtAssetIndex asset)\n"
+			"{\n"
+			"\tconst unsigned index = "
+			"kgtAssetTypeIndices[static_cast<unsigned>(asset)];\n"
+			"\treturn index < KGT_" + nameUpper + "_COUNT && \n"
+			"\t       kgt" + name + "Assets[index] == "
+			"static_cast<unsigned>(asset)\n"
+			"\t\t? static_cast<Kgt" + name + "Index>(index)\n"
+			"\t\t: Kgt" + name + "Index::ENUM_SIZE;\n"
+			"}\n");
+	}
+	result.append("static constexpr unsigned kgtAssetTypeIndices[] = \n");
+	for(size_t a = 0; a < typeIndices.size(); a++)
+	{
+		stringstream ss;
+		ss << (a == 0 ? "\t{ " : "\t, ");
+		if(typeIndices[a] == SIZE_MAX)
+			ss << "~0u\n";
+		else
+			ss << typeIndices[a] << "\n";
+		result.append(ss.str());
+	}
+	if(typeIndices.empty())
+		result.append("{0};\n");
+	else
+		result.append("};\n");
+	result.append(categoryTables);
+	return result;
+}
@@ -1,5 +1,7 @@
 #include <filesystem>
 #include <cstdlib>
+#include <cstdint>
+#include <cstring>
 #include <string>
 using std::string;
 #include <sstream>
@@ -10,10 +12,235 @@ using std::vector;
 #include <regex>
 using std::regex;
 #include <cassert>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <unordered_map>
 namespace fs = std::filesystem;
 static const wchar_t* ASSET_IGNORE_FILE_NAME = L"assets.ignore";
 static const char* GEN_ASSET_HEADER_FILE_NAME = "gen_kgtAssets.h";
 static bool g_verbose;
+/* where the messages of a run go; a kasset server points these at files of
+ *	its own while it performs a client's run (see kassetServe.cpp), so each
+ *	thread which a run starts must adopt the values of the thread which
+ *	started it */
+static thread_local FILE* g_stdout = stdout;
+static thread_local FILE* g_stderr = stderr;
+/* how the asset index is laid out across the generated files; see
+ *	kassetLayout.cpp */
+enum class KAssetHeaderLayout : uint8_t
+{
+	MONOLITHIC,
+	SPLIT,
+	BLOB,
+	MODULE
+};
+struct KassetOptions
+{
+	/** print what the run is doing; the caller decides whether this sets 
+	 * `g_verbose`, since a kasset server parses options for its clients */
+	bool verbose;
+	/** detect assets with identical contents & emit `kgtAssetCanonical[]` */
+	bool dedup;
+	/** concatenate the unique asset contents into a single pack file */
+	bool pack;
+	/** compress pack contents in independently decodable chunks */
+	bool compress;
+	/** emit a runtime module which reports modified assets */
+	bool hotReload;
+	/** emit a binary manifest which can be loaded without recompiling */
+	bool manifest;
+	/** keep each asset's KgtAssetIndex stable using the asset lock file */
+	bool lock;
+	/** remove tombstones from the asset lock file */
+	bool lockCompact;
+	/** emit `kgtAssetIndexOf`, which resolves asset paths at compile-time */
+	bool pathLookup;
+	/** scan, sort & generate output in bounded memory; see kassetStream.cpp */
+	bool stream;
+	size_t streamMemoryMb;
+	/** order pack contents by the first-touch order recorded in this trace */
+	const char* layoutTracePath;
+	/** the previous pack, or the directory of the previous packs, to lay out
+	 * each pack over & write a delta from; see kassetDelta.cpp */
+	const char* deltaFrom;
+	/** decode PNGs into RGBA8 texture blobs; see kassetPng.cpp */
+	bool decodePng;
+	/** append a mip chain to each texture blob */
+	bool mips;
+	/** compile `.fbm` flipbook metadata; see kassetFlipbook.cpp */
+	bool flipbooks;
+	/** emit the asset dependency graph; see kassetDeps.cpp */
+	bool deps;
+	/** emit a dense index space per asset type; see kassetTypeIndex.cpp */
+	bool typeIndices;
+	/** emit a single-allocation load plan per directory or bundle; see 
+	 * kassetArena.cpp */
+	bool arena;
+	/** where processing outputs are cached; see kassetCache.cpp */
+	const char* cacheDirectory;
+	size_t cacheMaxMb;
+	KAssetHeaderLayout headerLayout;
+	/** have the kasset server listening on this socket do the run; see 
+	 * kassetServe.cpp */
+	const char* serverSocketPath;
+};
+/* These values are persisted in binary manifests, so only ever append! */
+enum class KAssetType : uint8_t
+{
+	UNKNOWN,
+	PNG,
+	WAV,
+	OGG,
+	FLIPBOOK_META,
+	MATERIAL
+};
+struct KAsset
+{
+	/** path of the asset relative to the asset directory, '/' separated */
+	string fileName;
+	/** this KgtAssetIndex belonged to an asset which has since been removed */
+	bool tombstone;
+	KAssetType type;
+	uintmax_t fileSize;
+	uint64_t contentHash;
+	bool contentHashed;
+	/** KgtAssetIndex of the first asset with contents identical to this one */
+	size_t canonicalIndex;
+	/** index of the bundle this asset belongs to, if there are bundles */
+	size_t bundle;
+	/** assets are packed in order of layout group; see kassetTrace.cpp */
+	size_t layoutGroup;
+	/** hash of the contents stored in the pack, which are the processed 
+	 * contents if there are any; `contentHash` always hashes the asset's own 
+	 * file */
+	uint64_t packContentHash;
+	uint64_t packOffset;
+	uint64_t packStoredSize;
+	uint32_t packFirstChunk;
+	uint32_t packChunkCount;
+	/** if not empty, the file which replaces this asset's contents in the
+	 * pack, such as a decoded texture */
+	fs::path processedPath;
+	uintmax_t processedSize;
+	uint32_t textureWidth;
+	uint32_t textureHeight;
+	/** 0 if the asset is not a decoded texture */
+	uint32_t textureMipCount;
+};
+static fs::path assetFilePath(const fs::path& assetPath, const KAsset& asset)
+{
+	return assetPath / 
+		fs::path(reinterpret_cast<const char8_t*>(asset.fileName.c_str()));
+}
+/** @return the file whose contents represent `asset` in the pack */
+static fs::path assetPackedPath(const fs::path& assetPath, const KAsset& asset)
+{
+	if(!asset.processedPath.empty())
+		return asset.processedPath;
+	return assetFilePath(assetPath, asset);
+}
+static uintmax_t assetPackedSize(const KAsset& asset)
+{
+	return asset.processedPath.empty() ? asset.fileSize : asset.processedSize;
+}
+static KAssetType assetTypeFromFileName(const string& fileName)
+{
+	static const struct
+	{
+		const char* extension;
+		KAssetType type;
+	} EXTENSION_TYPES[] = 
+		{ {".png", KAssetType::PNG}
+		, {".wav", KAssetType::WAV}
+		, {".ogg", KAssetType::OGG}
+		, {".fbm", KAssetType::FLIPBOOK_META}
+		, {".mat", KAssetType::MATERIAL}
+	};
+	for(const auto& extensionType : EXTENSION_TYPES)
+	{
+		const size_t extensionSize = strlen(extensionType.extension);
+		if(fileName.size() >= extensionSize && 
+			fileName.compare(fileName.size() - extensionSize, extensionSize, 
+			                 extensionType.extension) == 0)
+		{
+			return extensionType.type;
+		}
+	}
+	return KAssetType::UNKNOWN;
+}
+/** Call `function(i)` for each i in [0, count) from a pool of threads. */
+static void parallelFor(size_t count, const std::function<void(size_t)>& function)
+{
+	const unsigned threadCount = static_cast<unsigned>(std::min<size_t>(
+		std::max(1u, std::thread::hardware_concurrency()), count));
+	std::atomic<size_t> next(0);
+	FILE*const runStdout = g_stdout;
+	FILE*const runStderr = g_stderr;
+	auto worker = [&]()
+	{
+		g_stdout = runStdout;
+		g_stderr = runStderr;
+		for(size_t i = next++; i < count; i = next++)
+			function(i);
+	};
+	vector<std::thread> threads;
+	for(unsigned t = 1; t < threadCount; t++)
+		threads.emplace_back(worker);
+	worker();
+	for(std::thread& thread : threads)
+		thread.join();
+}
+static FILE* openFile(const fs::path& path, const char* mode)
+{
+#if _MSC_VER
+	wchar_t modeW[8] = {};
+	for(size_t c = 0; c < 7 && mode[c]; c++)
+		modeW[c] = mode[c];
+	return _wfopen(path.c_str(), modeW);
+#else
+	return fopen(path.c_str(), mode);
+#endif
+}
+static bool seekFile(FILE* file, uint64_t offset)
+{
+#if _MSC_VER
+	return _fseeki64(file, static_cast<long long>(offset), SEEK_SET) == 0;
+#else
+	return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+static inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+static void appendLe32(vector<uint8_t>& buffer, uint32_t value)
+{
+	for(int b = 0; b < 4; b++)
+		buffer.push_back(static_cast<uint8_t>(value >> (8*b)));
+}
+static void appendLe64(vector<uint8_t>& buffer, uint64_t value)
+{
+	for(int b = 0; b < 8; b++)
+		buffer.push_back(static_cast<uint8_t>(value >> (8*b)));
+}
+static bool readFileContents(const fs::path& path, uintmax_t fileSize,
+                             vector<uint8_t>& o_contents)
+{
+	FILE*const file = openFile(path, "rb");
+	if(!file)
+		return false;
+	o_contents.resize(static_cast<size_t>(fileSize));
+	const bool result =
+		fread(o_contents.data(), 1, o_contents.size(), file) == fileSize &&
+		fgetc(file) == EOF;
+	fclose(file);
+	return result;
+}
 /** @return null-ternimated c-string of the entire file's contents */
 static char* readEntireFile(const fs::path::value_type* fileName, 
                             uintmax_t fileSize)
@@ -28,7 +255,7 @@ static char* readEntireFile(const fs::path::value_type* fileName,
 		char* data = static_cast<char*>(malloc(fileSize + 1));
 		if(!data)
 		{
-			fprintf(stderr, "Failed to alloc %lli bytes for '%ws'!\n", 
+			fprintf(g_stderr, "Failed to alloc %lli bytes for '%ws'!\n", 
 			        fileSize + 1, fileName);
 			return nullptr;
 		}
@@ -36,19 +263,19 @@ static char* readEntireFile(const fs::path::value_type* fileName,
 		if(bytesRead != fileSize)
 		{
 			free(data);
-			fprintf(stderr, "Failed to completely read '%ws'!\n", fileName);
+			fprintf(g_stderr, "Failed to completely read '%ws'!\n", fileName);
 			return nullptr;
 		}
 		if(fclose(file) != 0)
 		{
-			fprintf(stderr, "Failed to close '%ws'!\n", fileName);
+			fprintf(g_stderr, "Failed to close '%ws'!\n", fileName);
 		}
 		data[fileSize] = '\0';
 		return data;
 	}
 	else
 	{
-		fprintf(stderr, "Failed to open '%ws'!\n", fileName);
+		fprintf(g_stderr, "Failed to open '%ws'!\n", fileName);
 		return nullptr;
 	}
 }
@@ -71,17 +298,17 @@ static bool writeEntireFile(const fs::path::value_type* fileName,
 			       fileDataElementCount, file);
 		if(fclose(file) != 0)
 		{
-			fprintf(stderr, "Failed to close '%ws'!\n", fileName);
+			fprintf(g_stderr, "Failed to close '%ws'!\n", fileName);
 		}
 		if(elementsWritten != fileDataElementCount)
 		{
-			fprintf(stderr, "Failed to write '%ws'!\n", fileName);
+			fprintf(g_stderr, "Failed to write '%ws'!\n", fileName);
 			return false;
 		}
 	}
 	else
 	{
-		fprintf(stderr, "Failed to open '%ws'!\n", fileName);
+		fprintf(g_stderr, "Failed to open '%ws'!\n", fileName);
 		return false;
 	}
 	return true;
@@ -99,59 +326,6 @@ static bool isNumeric(wchar_t c)
 	const bool result = (c >= '0' && c <= '9');
 	return result;
 }
-string generateKAssetsHeader(const vector<string>& assetFileNames)
-{
-	string result;
-	result.append("#pragma once\n");
-	result.append("enum class KgtAssetIndex : unsigned\n");
-	for(size_t afn = 0; afn < assetFileNames.size(); afn++)
-	{
-		const string& assetFileName = assetFileNames[afn];
-		result.append(afn == 0 
-			? "\t{ " 
-			: "\t, ");
-		for(wchar_t c : assetFileName)
-		{
-			if(isAlpha(c) || isNumeric(c))
-				result.push_back(c);
-			else
-				result.push_back('_');
-		}
-		stringstream wss;
-		wss << " = "<< afn << "\n";
-		result.append(wss.str());
-	}
-	if(assetFileNames.empty())
-		result.append("\t{ ENUM_SIZE\n");
-	else
-		result.append("\t, ENUM_SIZE\n");
-	result.append("};\n");
-	result.append("static const unsigned KGT_ASSET_COUNT = \n");
-	result.append("\tstatic_cast<unsigned>(KgtAssetIndex::ENUM_SIZE);\n");
-	result.append("static const char* kgtAssetFileNames[] = \n");
-	for(size_t afn = 0; afn < assetFileNames.size(); afn++)
-	{
-		const string& assetFileName = assetFileNames[afn];
-		result.append(afn == 0 
-			? "\t{ \"" 
-			: "\t, \"");
-		for(wchar_t c : assetFileName)
-		{
-			if(c == '\\')
-				result.push_back('/');
-			else
-				result.push_back(c);
-		}
-		result.append("\"\n");
-	}
-	if(assetFileNames.empty())
-		result.append("{\"NO_KASSETS_FOUND\"};\n");
-	else
-		result.append("};\n");
-	if(assetFileNames.empty())
-		result.append("#define KGT_ASSET_NONE_FOUND\n");
-	return result;
-}
 // string whitespace trimming functions //
 //	Source: https://stackoverflow.com/a/217605
 // trim from start (in place)
@@ -166,36 +340,392 @@ static inline void rtrim(std::string &s) {
         return !std::isspace(ch);
     }).base(), s.end());
 }
-int main(int argc, char** argv)
+static void appendAssetEnumEntry(string& result, const string& fileName, 
+                                 size_t index, bool first)
 {
-	if(argc <= 1)
+	result.append(first 
+		? "\t{ " 
+		: "\t, ");
+	for(wchar_t c : fileName)
 	{
-		printf("Usage: kasset asset_directory output_directory [--verbose]\n");
-		return EXIT_SUCCESS;
+		if(isAlpha(c) || isNumeric(c))
+			result.push_back(c);
+		else
+			result.push_back('_');
 	}
-	if(argc < 3)
+	stringstream wss;
+	wss << " = "<< index << "\n";
+	result.append(wss.str());
+}
+static void appendAssetFileNameEntry(string& result, const string& fileName, 
+                                     bool first)
+{
+	result.append(first 
+		? "\t{ \"" 
+		: "\t, \"");
+	for(wchar_t c : fileName)
 	{
-		fprintf(stderr, "Incorrect # of arguments!\n");
-		return EXIT_FAILURE;
+		if(c == '\\')
+			result.push_back('/');
+		else
+			result.push_back(c);
 	}
-	const fs::path assetPath (argv[1]);
-	const fs::path outputPath(argv[2]);
+	result.append("\"\n");
+}
+#include "kassetDedup.cpp"
+#include "kassetLz.cpp"
+#include "kassetCache.cpp"
+#include "kassetPack.cpp"
+#include "kassetDelta.cpp"
+#include "kassetPng.cpp"
+#include "kassetProcess.cpp"
+#include "kassetFlipbook.cpp"
+#include "kassetDeps.cpp"
+#include "kassetBundle.cpp"
+#include "kassetTypeIndex.cpp"
+#include "kassetArena.cpp"
+#include "kassetTrace.cpp"
+#include "kassetHotReload.cpp"
+#include "kassetManifest.cpp"
+#include "kassetLock.cpp"
+#include "kassetScan.cpp"
+#include "kassetStream.cpp"
+#include "kassetLayout.cpp"
+/** @return a table of asset file names sorted for binary search, and 
+ *          `kgtAssetIndexOf`, a compile-time file name => KgtAssetIndex 
+ *          lookup.  `kgtAssetFileName` must be constexpr. */
+static string generatePathLookup(const vector<KAsset>& assets)
+{
+	vector<size_t> order;
+	for(size_t a = 0; a < assets.size(); a++)
+		if(!assets[a].tombstone)
+			order.push_back(a);
+	std::sort(order.begin(), order.end(), 
+		[&assets](size_t lhs, size_t rhs)
+		{
+			return assets[lhs].fileName < assets[rhs].fileName;
+		});
+	string result;
+	result.append("/* KgtAssetIndex of each asset sorted by file name, so that "
+	              "`kgtAssetIndexOf` is\n"
+	              "\ta binary search which stays cheap to evaluate at "
+	              "compile-time. */\n");
+	stringstream ss;
+	ss << "static constexpr unsigned KGT_ASSET_PATH_ORDER_COUNT = " 
+	   << order.size() << ";\n";
+	result.append(ss.str());
+	result.append("static constexpr unsigned kgtAssetPathOrder[] = \n");
+	for(size_t o = 0; o < order.size(); o++)
+	{
+		stringstream ssOrder;
+		ssOrder << (o == 0 ? "\t{ " : "\t, ") << order[o] << "\n";
+		result.append(ssOrder.str());
+	}
+	if(order.empty())
+		result.append("{0};\n");
+	else
+		result.append("};\n");
+	result.append(
+		"static constexpr int kgtAssetPathCompare(const char* a, const char* b)\n"
+		"{\n"
+		"\tfor(; *a && *a == *b; a++, b++) {}\n"
+		"\treturn static_cast<unsigned char>(*a) - \n"
+		"\t       static_cast<unsigned char>(*b);\n"
+		"}\n"
+		"/** @return KGT_ASSET_COUNT if `path` is not an asset */\n"
+		"static constexpr unsigned kgtAssetFind(const char* path)\n"
+		"{\n"
+		"\tunsigned lo = 0;\n"
+		"\tunsigned hi = KGT_ASSET_PATH_ORDER_COUNT;\n"
+		"\twhile(lo < hi)\n"
+		"\t{\n"
+		"\t\tconst unsigned mid = lo + (hi - lo)/2;\n"
+		"\t\tconst int cmp = kgtAssetPathCompare(\n"
+		"\t\t\tkgtAssetFileName(static_cast<KgtAssetIndex>(kgtAssetPathOrder[mid])),\n"
+		"\t\t\tpath);\n"
+		"\t\tif(cmp == 0)\n"
+		"\t\t\treturn kgtAssetPathOrder[mid];\n"
+		"\t\tif(cmp < 0)\n"
+		"\t\t\tlo = mid + 1;\n"
+		"\t\telse\n"
+		"\t\t\thi = mid;\n"
+		"\t}\n"
+		"\treturn KGT_ASSET_COUNT;\n"
+		"}\n"
+		"/* Deliberately not constexpr; compilation fails at the call to this "
+		"function\n"
+		"\tif `kgtAssetIndexOf` is given a path which is not an asset. */\n"
+		"static inline void kgtAssetIndexOf_ERROR_asset_path_not_found() {}\n"
+		"/** Resolve an asset file name (relative to the asset directory, '/' "
+		"separated)\n"
+		" * to its KgtAssetIndex at compile-time. */\n"
+		"#if defined(__cpp_consteval)\n"
+		"static consteval\n"
+		"#else\n"
+		"static constexpr\n"
+		"#endif\n"
+		"KgtAssetIndex kgtAssetIndexOf(const char* path)\n"
+		"{\n"
+		"\tconst unsigned index = kgtAssetFind(path);\n"
+		"\tif(index >= KGT_ASSET_COUNT)\n"
+		"\t\tkgtAssetIndexOf_ERROR_asset_path_not_found();\n"
+		"\treturn static_cast<KgtAssetIndex>(index);\n"
+		"}\n");
+	return result;
+}
+/** @param o_source receives the file which accompanies the header in the 
+ *        chosen layout, if any */
+string generateKAssetsHeader(const vector<KAsset>& assets, 
+                             const KassetOptions& options, 
+                             const vector<KAssetPackChunk>& packChunks, 
+                             const vector<KAssetBundle>& bundles, 
+                             const vector<KFlipbook>& flipbooks, 
+                             const vector<KFlipbookFrame>& flipbookFrames, 
+                             const KAssetDepGraph& depGraph, 
+                             const fs::path& outputPath, 
+                             string& o_source)
+{
+	size_t liveAssetCount = 0;
+	string result = generateAssetIndex(assets, options, o_source, 
+	                                   liveAssetCount);
+	if(options.pathLookup)
+		result.append(generatePathLookup(assets));
+	if(options.lock)
+	{
+		result.append("/* KgtAssetIndex values are locked, so they can contain "
+		              "holes left behind by\n"
+		              "\tremoved assets; the names of these are nullptr.  Use "
+		              "this table to iterate\n"
+		              "\tover only the assets that exist. */\n");
+		stringstream ss;
+		ss << "static const unsigned KGT_ASSET_LIVE_COUNT = " << liveAssetCount 
+		   << ";\n";
+		result.append(ss.str());
+		result.append("static const unsigned kgtAssetLiveIndices[] = \n");
+		size_t live = 0;
+		for(size_t a = 0; a < assets.size(); a++)
+		{
+			if(assets[a].tombstone)
+				continue;
+			stringstream ssLive;
+			ssLive << (live++ == 0 ? "\t{ " : "\t, ") << a << "\n";
+			result.append(ssLive.str());
+		}
+		if(live == 0)
+			result.append("{0};\n");
+		else
+			result.append("};\n");
+	}
+	if(options.dedup)
+	{
+		result.append("/* The KgtAssetIndex of the first asset whose contents are "
+		              "identical to the\n"
+		              "\tasset at each index.  Caches of decoded assets can be "
+		              "keyed on this. */\n");
+		result.append("static const unsigned kgtAssetCanonical[] = \n");
+		for(size_t a = 0; a < assets.size(); a++)
+		{
+			stringstream ss;
+			ss << (a == 0 ? "\t{ " : "\t, ") << assets[a].canonicalIndex 
+			   << "\n";
+			result.append(ss.str());
+		}
+		if(assets.empty())
+			result.append("{0};\n");
+		else
+			result.append("};\n");
+	}
+	if(options.pack)
+	{
+		result.append(generatePackTables(assets, packChunks, 
+		                                 !bundles.empty()));
+		result.append(GEN_ASSET_TRACE_HOOK);
+	}
+	if(!bundles.empty())
+		result.append(generateBundleTables(bundles, options.pack, assets));
+	if(options.decodePng)
+		result.append(generateTextureTables(assets));
+	if(options.flipbooks)
+		result.append(generateFlipbookTables(flipbooks, flipbookFrames));
+	if(options.deps)
+		result.append(generateDepTables(depGraph));
+	if(options.typeIndices)
+		result.append(generateTypeIndexTables(assets));
+	if(options.arena)
+		result.append(generateArenaTables(assets, bundles, options, 
+		                                  outputPath));
+	if(liveAssetCount == 0)
+		result.append("#define KGT_ASSET_NONE_FOUND\n");
+	return result;
+}
+#include "kassetBench.cpp"
+/** Parse the options which follow the asset & output directories.
+ * @return false if the options are invalid */
+static bool parseKassetOptions(int argc, char** argv, KassetOptions& o_options)
+{
+	KassetOptions options = {};
 	for(int a = 3; a < argc; a++)
 	{
 		if(strcmp(argv[a], "--verbose") == 0)
 		{
-			g_verbose = true;
+			options.verbose = true;
+		}
+		else if(strcmp(argv[a], "--dedup") == 0)
+		{
+			options.dedup = true;
+		}
+		else if(strcmp(argv[a], "--pack") == 0)
+		{
+			// duplicate assets must be known in order to alias pack entries //
+			options.dedup = true;
+			options.pack  = true;
+		}
+		else if(strcmp(argv[a], "--compress") == 0)
+		{
+			options.dedup    = true;
+			options.pack     = true;
+			options.compress = true;
+		}
+		else if(strcmp(argv[a], "--hot-reload") == 0)
+		{
+			options.hotReload = true;
+		}
+		else if(strcmp(argv[a], "--manifest") == 0)
+		{
+			options.manifest = true;
+		}
+		else if(strcmp(argv[a], "--lock") == 0)
+		{
+			options.lock = true;
+		}
+		else if(strcmp(argv[a], "--lock-compact") == 0)
+		{
+			options.lock        = true;
+			options.lockCompact = true;
+		}
+		else if(strcmp(argv[a], "--path-lookup") == 0)
+		{
+			options.pathLookup = true;
+		}
+		else if(strcmp(argv[a], "--layout-from-trace") == 0 && a + 1 < argc)
+		{
+			options.dedup           = true;
+			options.pack            = true;
+			options.layoutTracePath = argv[++a];
+		}
+		else if(strcmp(argv[a], "--delta-from") == 0 && a + 1 < argc)
+		{
+			options.dedup     = true;
+			options.pack      = true;
+			options.deltaFrom = argv[++a];
+		}
+		else if(strcmp(argv[a], "--decode-png") == 0)
+		{
+			options.decodePng = true;
+		}
+		else if(strcmp(argv[a], "--mips") == 0)
+		{
+			options.decodePng = true;
+			options.mips      = true;
+		}
+		else if(strcmp(argv[a], "--flipbooks") == 0)
+		{
+			options.flipbooks = true;
+		}
+		else if(strcmp(argv[a], "--deps") == 0)
+		{
+			options.deps = true;
+		}
+		else if(strcmp(argv[a], "--type-indices") == 0)
+		{
+			options.typeIndices = true;
+		}
+		else if(strcmp(argv[a], "--arena") == 0)
+		{
+			options.arena = true;
+		}
+		else if(strcmp(argv[a], "--cache-dir") == 0 && a + 1 < argc)
+		{
+			options.cacheDirectory = argv[++a];
+		}
+		else if(strcmp(argv[a], "--cache-max-mb") == 0 && a + 1 < argc)
+		{
+			options.cacheMaxMb = strtoul(argv[++a], nullptr, 10);
+			if(options.cacheMaxMb == 0)
+			{
+				fprintf(g_stderr, "ERROR: invalid cache size '%s'\n", argv[a]);
+				return false;
+			}
+		}
+		else if(strcmp(argv[a], "--layout") == 0 && a + 1 < argc)
+		{
+			if(!parseHeaderLayout(argv[++a], options.headerLayout))
+			{
+				fprintf(g_stderr, "ERROR: unknown header layout '%s'\n",
+				        argv[a]);
+				return false;
+			}
+		}
+		else if(strcmp(argv[a], "--server") == 0 && a + 1 < argc)
+		{
+			options.serverSocketPath = argv[++a];
+		}
+		else if(strcmp(argv[a], "--stream") == 0)
+		{
+			options.stream = true;
+		}
+		else if(strcmp(argv[a], "--stream-memory-mb") == 0 && a + 1 < argc)
+		{
+			options.stream         = true;
+			options.streamMemoryMb = strtoul(argv[++a], nullptr, 10);
+			if(options.streamMemoryMb == 0)
+			{
+				fprintf(g_stderr, "ERROR: invalid memory cap '%s'\n", argv[a]);
+				return false;
+			}
 		}
 		else
 		{
-			fprintf(stderr, "ERROR: incorrect usage on param[%i]=='%s'\n",
+			fprintf(g_stderr, "ERROR: incorrect usage on param[%i]=='%s'\n",
 			        a, argv[a]);
-			return EXIT_FAILURE;
+			return false;
 		}
 	}
+	if(options.stream && 
+		(options.dedup || options.hotReload || options.lock || 
+		 options.pathLookup || options.decodePng || options.flipbooks || 
+		 options.deps || options.typeIndices || options.arena))
+	// these all need every asset in memory at once //
+	{
+		fprintf(g_stderr, "ERROR: `--stream` only supports `--manifest`!\n");
+		return false;
+	}
+	if(options.stream && options.headerLayout != KAssetHeaderLayout::MONOLITHIC)
+	{
+		fprintf(g_stderr, "ERROR: `--stream` only generates the monolithic "
+		                  "layout!\n");
+		return false;
+	}
+	if(options.pathLookup && options.headerLayout == KAssetHeaderLayout::SPLIT)
+	// the file names must be visible to the compiler to be searched //
+	{
+		fprintf(g_stderr, "ERROR: `--path-lookup` does not support the split "
+		                  "layout!\n");
+		return false;
+	}
+	if(options.streamMemoryMb == 0)
+		options.streamMemoryMb = KASSET_STREAM_DEFAULT_MEMORY_MB;
+	if(options.cacheMaxMb == 0)
+		options.cacheMaxMb = KASSET_CACHE_DEFAULT_MAX_MB;
+	o_options = options;
+	return true;
+}
+/** Compile the patterns of the asset ignore file, if there is one. */
+static void loadAssetIgnores(const fs::path& assetPath, 
+                             vector<regex>& o_regexListIgnore)
+{
 	const fs::directory_entry entryAssetIgnore(
 		assetPath/ASSET_IGNORE_FILE_NAME);
-	vector<regex> regexListIgnore;
 	if(entryAssetIgnore.exists())
 	// if the asset ignore file exists, load its contents so we can obey the 
 	//	ignored patterns contained within... //
@@ -213,65 +743,311 @@ int main(int argc, char** argv)
 			rtrim(line);
 			if(g_verbose)
 			{
-				printf("Adding ignore line '%s'...\n", line.c_str());
+				fprintf(g_stdout, "Adding ignore line '%s'...\n", line.c_str());
 			}
-			regexListIgnore.emplace_back(line);
+			o_regexListIgnore.emplace_back(line);
 		}
 	}
-	vector<string> assetFileNames;
-	for(const fs::directory_entry& entry : 
-		fs::recursive_directory_iterator(assetPath))
+}
+/** What a kasset server keeps in memory between runs over the same asset 
+ * directory.  The server discards whatever is invalidated by changes to the 
+ * directory. */
+struct KAssetWarmTree
+{
+	bool ignoresLoaded;
+	vector<regex> regexListIgnore;
+	/** `assets` holds the result of the last scan, including file sizes */
+	bool scanned;
+	vector<KAsset> assets;
+	/** files modified since the scan, whose sizes must be read again */
+	vector<string> modifiedFileNames;
+	/** content hash of each asset file which has been hashed */
+	std::unordered_map<string, uint64_t> contentHashes;
+};
+/** Remember the content hashes of the asset files for later runs. */
+static void warmContentHashes(KAssetWarmTree* warm, 
+                              const vector<KAsset>& assets)
+{
+	if(!warm)
+		return;
+	for(const KAsset& asset : assets)
+		if(asset.contentHashed && !asset.tombstone)
+			warm->contentHashes[asset.fileName] = asset.contentHash;
+}
+/** Generate every output for the assets in `assetPath`.
+ * @param warm if not nullptr, state kept by a kasset server from earlier runs 
+ *             over `assetPath`, which is reused & brought up to date; see 
+ *             kassetServe.cpp
+ * @return the exit status of the run */
+static int runKasset(const fs::path& assetPath, const fs::path& outputPath, 
+                     const KassetOptions& options, KAssetWarmTree* warm)
+{
+	vector<regex> regexListIgnore;
+	if(warm && warm->ignoresLoaded)
+		regexListIgnore = warm->regexListIgnore;
+	else
 	{
-		if(entry == entryAssetIgnore)
+		loadAssetIgnores(assetPath, regexListIgnore);
+		if(warm)
 		{
-			continue;
+			warm->regexListIgnore = regexListIgnore;
+			warm->ignoresLoaded   = true;
 		}
-		if(entry.is_regular_file())
+	}
+	const fs::path bundlesPath = assetPath/ASSET_BUNDLES_FILE_NAME;
+	vector<KAssetBundle> bundles;
+	vector<KAssetBundleRule> bundleRules;
+	if(fs::exists(bundlesPath))
+	{
+		if(options.stream)
 		{
-			// Create a path to the file excluding `assetPath` //
-			fs::path pathToFileRelativeAssetPath = entry.path().filename();
-			{
-				fs::path currPath = entry.path().parent_path();
-				while(currPath != assetPath)
-				{
-					pathToFileRelativeAssetPath = 
-						currPath.filename() / pathToFileRelativeAssetPath;
-					currPath = currPath.parent_path();
-				}
-			}
-			// check to see if the asset's filename matches an ignored regex //
-			bool isIgnored = false;
-			for(const regex& regexIgnore : regexListIgnore)
-			{
-				if(std::regex_match(
-				          (char*)pathToFileRelativeAssetPath.u8string().c_str(), 
-				          regexIgnore))
-				{
-					isIgnored = true;
-				}
-			}
-			if(isIgnored)
-			{
-				if(g_verbose)
-					printf("Ignoring asset '%ws'...\n", 
-					       pathToFileRelativeAssetPath.c_str());
+			fprintf(g_stderr, "ERROR: `--stream` does not support asset "
+			                  "bundles!\n");
+			return EXIT_FAILURE;
+		}
+		if(!readAssetBundles(bundlesPath, bundles, bundleRules))
+			return EXIT_FAILURE;
+		if(options.deltaFrom && !fs::is_directory(options.deltaFrom))
+		{
+			fprintf(g_stderr, "ERROR: with asset bundles, `--delta-from` must "
+			        "be the directory of the previous packs!\n");
+			return EXIT_FAILURE;
+		}
+	}
+	vector<KAsset> assets;
+	KAssetScan scan;
+	scan.rootFilesSkipped.push_back(
+		(char*)fs::path(ASSET_IGNORE_FILE_NAME).u8string().c_str());
+	scan.rootFilesSkipped.push_back(
+		(char*)fs::path(ASSET_LOCK_FILE_NAME).u8string().c_str());
+	scan.rootFilesSkipped.push_back(
+		(char*)fs::path(ASSET_BUNDLES_FILE_NAME).u8string().c_str());
+	scan.regexListIgnore = &regexListIgnore;
+	// a warm scan must be usable by runs with any options //
+	scan.statFiles = options.dedup || options.manifest || options.arena || 
+	                 warm;
+	if(options.stream)
+	{
+		return streamAssets(assetPath, outputPath, options, scan, 
+		                    options.streamMemoryMb*1024*1024) 
+			? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	scan.callback = 
+		[&assets](const char* fileName, size_t fileNameSize, uintmax_t fileSize)
+		{
+			KAsset asset = {};
+			asset.fileName.assign(fileName, fileNameSize);
+			asset.type     = assetTypeFromFileName(asset.fileName);
+			asset.fileSize = fileSize;
+			assets.push_back(std::move(asset));
+		};
+	if(warm && warm->scanned)
+		assets = warm->assets;
+	else
+	{
+		if(!scanAssetTree(assetPath, scan))
+			return EXIT_FAILURE;
+		if(warm)
+		{
+			warm->assets  = assets;
+			warm->scanned = true;
+		}
+	}
+	if(warm)
+		for(KAsset& asset : assets)
+		{
+			auto itHash = warm->contentHashes.find(asset.fileName);
+			if(itHash == warm->contentHashes.end())
 				continue;
-			}
-			// Add the asset! //
-			if(g_verbose)
-				printf("Adding asset '%ws'...\n", 
-				       pathToFileRelativeAssetPath.c_str());
-			assetFileNames.push_back(
-				(char*)pathToFileRelativeAssetPath.u8string().c_str());
+			asset.contentHash   = itHash->second;
+			asset.contentHashed = true;
+		}
+	// group bundles before the lock is applied, so that newly locked assets 
+	//	are contiguous within their bundle //
+	if(!bundles.empty())
+		assignAssetBundles(bundleRules, bundles, assets);
+	if(options.lock)
+	{
+		const fs::path lockPath = assetPath/ASSET_LOCK_FILE_NAME;
+		vector<string> lockSlots;
+		if(fs::exists(lockPath) && !readAssetLock(lockPath, lockSlots))
+		{
+			return EXIT_FAILURE;
 		}
+		applyAssetLock(lockSlots, options.lockCompact, assets);
+		if(!writeAssetLock(lockPath, assets))
+			return EXIT_FAILURE;
+	}
+	if(!bundles.empty() && !computeAssetBundleRanges(bundles, assets))
+		fprintf(g_stdout, "WARNING: locked asset indices prevent some bundles "
+		        "from occupying a contiguous\n\trange; see "
+		        "`kgtAssetBundleOf`.\n");
+	if(options.dedup)
+	{
+		const uintmax_t bytesSaved = dedupAssets(assetPath, assets);
+		size_t duplicateCount = 0;
+		for(size_t a = 0; a < assets.size(); a++)
+			if(assets[a].canonicalIndex != a)
+				duplicateCount++;
+		if(duplicateCount > 0 || g_verbose)
+			fprintf(g_stdout, "Found %zu duplicate assets; %ju redundant "
+			        "bytes.\n", duplicateCount, bytesSaved);
 	}
-	// output the generated asset manifest header file //
 	fs::create_directories(outputPath);
-	const string genKAssetHeader = generateKAssetsHeader(assetFileNames);
-	const fs::path outPath = outputPath / GEN_ASSET_HEADER_FILE_NAME;
-	writeEntireFile(outPath.c_str(), genKAssetHeader.c_str(), false);
+	KAssetCache cache;
+	cache.maxBytes = uint64_t(options.cacheMaxMb)*1024*1024;
+	if(options.decodePng || options.compress)
+	{
+		cache.directory = options.cacheDirectory 
+			? fs::path(options.cacheDirectory) 
+			: outputPath / GEN_ASSET_CACHE_DIRECTORY;
+		std::error_code errorCode;
+		if(!fs::create_directories(cache.directory, errorCode) && errorCode)
+		{
+			fprintf(g_stdout, "WARNING: failed to create cache directory '%s'; "
+			        "processing without a cache.\n", 
+			        (char*)cache.directory.u8string().c_str());
+			cache.directory.clear();
+		}
+	}
+	if(options.decodePng)
+	{
+		// without dedup, every asset is its own canonical asset //
+		if(!options.dedup)
+			for(size_t a = 0; a < assets.size(); a++)
+				assets[a].canonicalIndex = a;
+		if(!processAssets(assetPath, outputPath, options, cache, assets))
+			return EXIT_FAILURE;
+	}
+	if(options.layoutTracePath && 
+		!applyAssetTrace(fs::path(options.layoutTracePath), assets))
+		return EXIT_FAILURE;
+	vector<KFlipbook> flipbooks;
+	vector<KFlipbookFrame> flipbookFrames;
+	if(options.flipbooks && 
+		!compileFlipbooks(assetPath, assets, flipbooks, flipbookFrames))
+		return EXIT_FAILURE;
+	KAssetDepGraph depGraph;
+	if(options.deps && !buildAssetDepGraph(assetPath, assets, depGraph))
+		return EXIT_FAILURE;
+	warmContentHashes(warm, assets);
+	vector<KAssetPackChunk> packChunks;
+	if(options.pack)
+	{
+		const fs::path packPath = outputPath / GEN_ASSET_PACK_FILE_NAME;
+		if(bundles.empty())
+		{
+			vector<size_t> members(assets.size());
+			for(size_t a = 0; a < assets.size(); a++)
+				members[a] = a;
+			orderPackMembers(assets, members);
+			if(!writeAssetPackVersion(assetPath, packPath, options, cache, 
+			                          assets, members, packChunks))
+				return EXIT_FAILURE;
+		}
+		else if(!writeAssetBundlePacks(assetPath, outputPath, options, cache, 
+		                               bundles, assets, packChunks))
+			return EXIT_FAILURE;
+		const fs::path runtimePath = 
+			outputPath / GEN_ASSET_PACK_RUNTIME_FILE_NAME;
+		if(!writeEntireFile(runtimePath.c_str(), GEN_ASSET_PACK_RUNTIME, 
+		                    false))
+			return EXIT_FAILURE;
+	}
+	if(options.arena)
+	{
+		const fs::path runtimePath = 
+			outputPath / GEN_ASSET_ARENA_RUNTIME_FILE_NAME;
+		if(!writeEntireFile(runtimePath.c_str(), GEN_ASSET_ARENA_RUNTIME, 
+		                    false))
+			return EXIT_FAILURE;
+	}
+	if(options.hotReload)
+	{
+		const fs::path hotReloadPath = 
+			outputPath / GEN_ASSET_HOT_RELOAD_FILE_NAME;
+		const string genHotReload = generateHotReloadModule(assets);
+		if(!writeEntireFile(hotReloadPath.c_str(), genHotReload.c_str(), 
+		                    false))
+			return EXIT_FAILURE;
+	}
+	if(options.manifest)
+	{
+		if(!hashAssets(assetPath, assets))
+			return EXIT_FAILURE;
+		const fs::path manifestPath = outputPath / GEN_ASSET_MANIFEST_FILE_NAME;
+		if(!writeAssetManifest(manifestPath, assets))
+			return EXIT_FAILURE;
+		const fs::path readerPath = 
+			outputPath / GEN_ASSET_MANIFEST_READER_FILE_NAME;
+		if(!writeEntireFile(readerPath.c_str(), GEN_ASSET_MANIFEST_READER, 
+		                    false))
+			return EXIT_FAILURE;
+	}
+	// output the generated asset manifest header file //
+	string genKAssetSource;
+	const string genKAssetHeader = 
+		generateKAssetsHeader(assets, options, packChunks, bundles, flipbooks, 
+		                      flipbookFrames, depGraph, outputPath, 
+		                      genKAssetSource);
+	if(!writeKAssetsHeader(outputPath, options.headerLayout, genKAssetHeader, 
+	                       genKAssetSource))
+		return EXIT_FAILURE;
+	cacheEvict(cache);
+	warmContentHashes(warm, assets);
 	return EXIT_SUCCESS;
 }
+#include "kassetServe.cpp"
+int main(int argc, char** argv)
+{
+	if(argc >= 2 && strcmp(argv[1], "--bench") == 0)
+		return runLayoutBench(argc, argv) ? EXIT_SUCCESS : EXIT_FAILURE;
+	if(argc >= 2 && strcmp(argv[1], "--serve") == 0)
+		return runServer(argc, argv) ? EXIT_SUCCESS : EXIT_FAILURE;
+	if(argc >= 2 && strcmp(argv[1], "--apply-delta") == 0)
+		return runApplyDelta(argc, argv) ? EXIT_SUCCESS : EXIT_FAILURE;
+	if(argc <= 1)
+	{
+		printf("Usage: kasset asset_directory output_directory [--verbose] "
+		       "[--dedup] [--pack] [--compress] [--hot-reload] "
+		       "[--manifest] [--lock] [--lock-compact] [--path-lookup] "
+		       "[--stream] [--stream-memory-mb megabytes] "
+		       "[--layout-from-trace trace_file] "
+		       "[--delta-from previous_pack_or_directory] "
+		       "[--decode-png] [--mips] "
+		       "[--flipbooks] [--deps] [--type-indices] [--arena] "
+		       "[--cache-dir directory] "
+		       "[--cache-max-mb megabytes] "
+		       "[--layout monolithic|split|blob|module] "
+		       "[--server socket_path]\n"
+		       "       kasset --bench output_directory [--verbose] "
+		       "[--scales count,...] [--consumers count] [--cxx command]\n"
+		       "       kasset --serve socket_path [--verbose]\n"
+		       "       kasset --apply-delta pack_file delta_file [--verbose]\n");
+		return EXIT_SUCCESS;
+	}
+	if(argc < 3)
+	{
+		fprintf(stderr, "Incorrect # of arguments!\n");
+		return EXIT_FAILURE;
+	}
+	const fs::path assetPath (argv[1]);
+	const fs::path outputPath(argv[2]);
+	KassetOptions options;
+	if(!parseKassetOptions(argc, argv, options))
+		return EXIT_FAILURE;
+	g_verbose = options.verbose;
+	if(options.serverSocketPath)
+	{
+		int status;
+		if(requestFromServer(options.serverSocketPath, 
+		                     serveClientArguments(argc, argv), status))
+			return status;
+		printf("WARNING: the kasset server at '%s' is unavailable; running "
+		       "locally.\n", options.serverSocketPath);
+	}
+	return runKasset(assetPath, outputPath, options, nullptr);
+}
 #if 0
 #include <cstdio>
 #include <chrono>